@@ -0,0 +1,301 @@
+// End-to-end load driver: renders the synthetic corpus, submits pages to a
+// running service's /api/v1/ocr/text with a fixed number of concurrent
+// clients, and reports throughput, latency percentiles and accuracy.
+//
+//   ocr-load --url=http://localhost:8002 --concurrency=8 --requests=400
+//
+// Fails (exit 1) on request errors or when --max-p99-ms / --max-cer /
+// --min-field-accuracy are exceeded, so CI can hold the numbers.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include "synthetic_corpus.h"
+#include "field_extractor.h"
+#include "ocr_engine.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+struct DriverOptions {
+    std::string url = "http://localhost:8002";
+    std::string corpus = defaultCorpusPath();
+    std::string fields = "config/fields.json";
+    size_t concurrency = 4;
+    size_t requests = 200;
+    size_t warmup = 8;
+    double max_p99_ms = 0.0;          // 0 = no limit
+    double max_cer = 1.0;
+    double min_field_accuracy = 0.0;
+    bool json_output = false;
+};
+
+struct Sample {
+    double latency_ms = 0.0;
+    bool ok = false;
+    bool cached = false;
+    size_t document = 0;
+    std::string text;
+};
+
+struct PreparedPage {
+    size_t document;
+    std::vector<uchar> png;
+};
+
+bool parseArguments(int argc, char** argv, DriverOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string key = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        try {
+            if (key == "--url") {
+                options.url = value;
+            } else if (key == "--corpus") {
+                options.corpus = value;
+            } else if (key == "--fields") {
+                options.fields = value;
+            } else if (key == "--concurrency") {
+                options.concurrency = std::max<size_t>(1, std::stoul(value));
+            } else if (key == "--requests") {
+                options.requests = std::stoul(value);
+            } else if (key == "--warmup") {
+                options.warmup = std::stoul(value);
+            } else if (key == "--max-p99-ms") {
+                options.max_p99_ms = std::stod(value);
+            } else if (key == "--max-cer") {
+                options.max_cer = std::stod(value);
+            } else if (key == "--min-field-accuracy") {
+                options.min_field_accuracy = std::stod(value);
+            } else if (key == "--json") {
+                options.json_output = true;
+            } else {
+                std::cerr << "Unknown argument " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << key << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t appendBody(char* data, size_t size, size_t count, void* user) {
+    static_cast<std::string*>(user)->append(data, size * count);
+    return size * count;
+}
+
+// One multipart upload; false on transport errors and non-2xx responses
+bool submitPage(CURL* curl, const std::string& endpoint, const PreparedPage& page, std::string& body) {
+    body.clear();
+    curl_mime* mime = curl_mime_init(curl);
+    curl_mimepart* part = curl_mime_addpart(mime);
+    curl_mime_name(part, "file");
+    curl_mime_filename(part, "page.png");
+    curl_mime_type(part, "image/png");
+    curl_mime_data(part, reinterpret_cast<const char*>(page.png.data()), page.png.size());
+
+    curl_easy_setopt(curl, CURLOPT_URL, endpoint.c_str());
+    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendBody);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    CURLcode code = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_mime_free(mime);
+    if (code != CURLE_OK) {
+        body = curl_easy_strerror(code);
+        return false;
+    }
+    return status >= 200 && status < 300;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+}
+
+int main(int argc, char** argv) {
+    DriverOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        return 2;
+    }
+
+    std::vector<CorpusDocument> documents;
+    std::string error;
+    if (!loadCorpus(options.corpus, documents, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+
+    FieldExtractorConfig field_config;
+    if (!FieldExtractorConfig::loadFromFile(options.fields, field_config)) {
+        field_config = FieldExtractorConfig::defaults();
+    }
+    FieldExtractor extractor(std::move(field_config));
+
+    // Render and encode every page up front so the clients only measure the
+    // service. Each request gets its own variant, so none is a cache hit.
+    size_t total = options.warmup + options.requests;
+    std::vector<PreparedPage> pages(total);
+    for (size_t i = 0; i < total; i++) {
+        pages[i].document = i % documents.size();
+        pages[i].png = encodePage(renderPage(documents[pages[i].document], static_cast<uint32_t>(i + 1)));
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    const std::string endpoint = options.url + "/api/v1/ocr/text";
+    std::vector<Sample> samples(total);
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    std::string first_error;
+
+    auto started = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point measured_start = started;
+    std::once_flag measured_once;
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < options.concurrency; c++) {
+        clients.emplace_back([&]() {
+            CURL* curl = curl_easy_init();
+            std::string body;
+            for (size_t i = next++; i < total; i = next++) {
+                if (i == options.warmup) {
+                    std::call_once(measured_once, [&]() { measured_start = std::chrono::steady_clock::now(); });
+                }
+                Sample& sample = samples[i];
+                sample.document = pages[i].document;
+                auto request_start = std::chrono::steady_clock::now();
+                sample.ok = submitPage(curl, endpoint, pages[i], body);
+                sample.latency_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - request_start).count();
+                if (sample.ok) {
+                    try {
+                        json response = json::parse(body);
+                        sample.text = response.at("data").at("text").get<std::string>();
+                        sample.cached = response.at("data").value("cached", false);
+                    } catch (const json::exception& e) {
+                        sample.ok = false;
+                        body = e.what();
+                    }
+                }
+                if (!sample.ok) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (first_error.empty()) {
+                        first_error = body.substr(0, 200);
+                    }
+                }
+            }
+            curl_easy_cleanup(curl);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    auto finished = std::chrono::steady_clock::now();
+    curl_global_cleanup();
+
+    // Only the measured requests count; warm-up requests are discarded
+    std::vector<double> latencies;
+    size_t failed = 0;
+    size_t cached = 0;
+    double cer_sum = 0.0;
+    size_t type_matches = 0;
+    size_t fields_expected = 0;
+    size_t fields_matched = 0;
+    for (size_t i = options.warmup; i < total; i++) {
+        const Sample& sample = samples[i];
+        if (!sample.ok) {
+            failed++;
+            continue;
+        }
+        latencies.push_back(sample.latency_ms);
+        cached += sample.cached ? 1 : 0;
+
+        // Accuracy against the ground truth, and for fields against what the
+        // extractor finds in the ground truth, so only OCR errors count
+        std::string truth = documents[sample.document].text();
+        cer_sum += characterErrorRate(truth, sample.text);
+        DocumentInfo expected;
+        DocumentInfo actual;
+        extractor.analyze(truth, expected);
+        extractor.analyze(sample.text, actual);
+        type_matches += expected.document_type == actual.document_type ? 1 : 0;
+        for (const auto& [name, value] : expected.extracted_data) {
+            fields_expected++;
+            auto found = actual.extracted_data.find(name);
+            fields_matched += found != actual.extracted_data.end() && found->second == value ? 1 : 0;
+        }
+    }
+
+    size_t succeeded = latencies.size();
+    double seconds = std::chrono::duration<double>(finished - measured_start).count();
+    double pages_per_second = seconds > 0.0 ? static_cast<double>(succeeded) / seconds : 0.0;
+    double mean_cer = succeeded ? cer_sum / static_cast<double>(succeeded) : 1.0;
+    double type_accuracy = succeeded ? static_cast<double>(type_matches) / static_cast<double>(succeeded) : 0.0;
+    double field_accuracy = fields_expected ? static_cast<double>(fields_matched) / static_cast<double>(fields_expected)
+                                            : 1.0;
+    double p50 = percentile(latencies, 0.50);
+    double p95 = percentile(latencies, 0.95);
+    double p99 = percentile(latencies, 0.99);
+
+    if (options.json_output) {
+        json report = {
+            {"requests", options.requests},
+            {"concurrency", options.concurrency},
+            {"succeeded", succeeded},
+            {"failed", failed},
+            {"cached", cached},
+            {"pages_per_second", pages_per_second},
+            {"latency_ms", {{"p50", p50}, {"p95", p95}, {"p99", p99}}},
+            {"character_error_rate", mean_cer},
+            {"document_type_accuracy", type_accuracy},
+            {"field_accuracy", field_accuracy}
+        };
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::cout << "requests:        " << succeeded << " ok, " << failed << " failed, "
+                  << cached << " cached (" << options.concurrency << " clients)\n"
+                  << "throughput:      " << pages_per_second << " pages/s\n"
+                  << "latency ms:      p50 " << p50 << "  p95 " << p95 << "  p99 " << p99 << "\n"
+                  << "char error rate: " << mean_cer << "\n"
+                  << "document type:   " << type_accuracy << "\n"
+                  << "field accuracy:  " << field_accuracy << std::endl;
+    }
+
+    bool passed = true;
+    if (failed > 0) {
+        std::cerr << failed << " requests failed, first error: " << first_error << std::endl;
+        passed = false;
+    }
+    if (options.max_p99_ms > 0.0 && p99 > options.max_p99_ms) {
+        std::cerr << "p99 " << p99 << " ms exceeds " << options.max_p99_ms << " ms" << std::endl;
+        passed = false;
+    }
+    if (mean_cer > options.max_cer) {
+        std::cerr << "character error rate " << mean_cer << " exceeds " << options.max_cer << std::endl;
+        passed = false;
+    }
+    if (field_accuracy < options.min_field_accuracy) {
+        std::cerr << "field accuracy " << field_accuracy << " below " << options.min_field_accuracy << std::endl;
+        passed = false;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+// Per-stage microbenchmarks over the synthetic corpus:
+//   ocr-bench --benchmark_filter=Preprocess
+// Stages that need Tesseract are skipped when no eng traineddata is found.
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include "synthetic_corpus.h"
+#include "api_handler.h"
+#include "field_extractor.h"
+#include "ocr_engine.h"
+#include "preprocessing_pipeline.h"
+
+namespace {
+
+const std::vector<CorpusDocument>& corpus() {
+    static const std::vector<CorpusDocument> documents = [] {
+        std::vector<CorpusDocument> loaded;
+        std::string error;
+        if (!loadCorpus(defaultCorpusPath(), loaded, error)) {
+            std::cerr << "ocr-bench: " << error << std::endl;
+            std::exit(1);
+        }
+        return loaded;
+    }();
+    return documents;
+}
+
+// A skewed, noisy page, the case every stage has to handle
+const cv::Mat& samplePage() {
+    static const cv::Mat page = renderPage(corpus().front(), 1);
+    return page;
+}
+
+// One engine shared by the recognition benchmarks; null without tessdata
+OCREngine* sharedEngine() {
+    static std::unique_ptr<OCREngine> engine = [] {
+        auto created = std::make_unique<OCREngine>();
+        if (!created->initialize()) {
+            return std::unique_ptr<OCREngine>();
+        }
+        created->setFieldExtractor(FieldExtractor::builtin());
+        return created;
+    }();
+    return engine.get();
+}
+
+PreprocessingOptions singleStage(int stage) {
+    PreprocessingOptions options = PreprocessingOptions::none();
+    switch (stage) {
+        case 0: options.enhance = true; break;
+        case 1: options.denoise = true; break;
+        case 2: options.deskew = true; break;
+        default: options = PreprocessingOptions(); break;
+    }
+    return options;
+}
+
+const char* stageName(int stage) {
+    switch (stage) {
+        case 0: return "enhance";
+        case 1: return "denoise";
+        case 2: return "deskew";
+        default: return "all";
+    }
+}
+
+}
+
+// Handing the decoded frame to Tesseract (formerly a Mat-to-Pix copy)
+static void BM_SetImage(benchmark::State& state) {
+    tesseract::TessBaseAPI api;
+    if (api.Init(nullptr, "eng") != 0) {
+        state.SkipWithError("eng traineddata not found");
+        return;
+    }
+    const cv::Mat& page = samplePage();
+    for (auto _ : state) {
+        api.SetImage(page.data, page.cols, page.rows, 1, static_cast<int>(page.step));
+        benchmark::ClobberMemory();
+    }
+    api.End();
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(page.total()));
+}
+BENCHMARK(BM_SetImage);
+
+// Args: stage (0 enhance, 1 denoise, 2 deskew, 3 all), backend
+static void BM_Preprocess(benchmark::State& state) {
+    int stage = static_cast<int>(state.range(0));
+    auto backend = static_cast<PreprocessingBackend>(state.range(1));
+    if (backend == PreprocessingBackend::OpenCL && PreprocessingPipeline::backend() != backend) {
+        state.SkipWithError("OpenCL backend not available");
+        return;
+    }
+    state.SetLabel(std::string(stageName(stage)) + "/" + preprocessingBackendName(backend));
+
+    PreprocessingPipeline pipeline(backend);
+    PreprocessingOptions options = singleStage(stage);
+    // Denoise and deskew normally see the binarized page
+    cv::Mat input = samplePage();
+    if (stage == 1 || stage == 2) {
+        PreprocessingPipeline enhance(PreprocessingBackend::OpenCV);
+        input = enhance.run(samplePage(), singleStage(0)).clone();
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pipeline.run(input, options).data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Preprocess)
+    ->ArgsProduct({{0, 1, 2, 3},
+                   {static_cast<int64_t>(PreprocessingBackend::OpenCV),
+                    static_cast<int64_t>(PreprocessingBackend::FusedCPU),
+                    static_cast<int64_t>(PreprocessingBackend::OpenCL)}})
+    ->Unit(benchmark::kMillisecond);
+
+// Field extraction alone, over the ground-truth text of every document
+static void BM_FieldExtraction(benchmark::State& state) {
+    auto extractor = FieldExtractor::builtin();
+    std::vector<std::string> texts;
+    size_t bytes = 0;
+    for (const auto& document : corpus()) {
+        texts.push_back(document.text());
+        bytes += texts.back().size();
+    }
+    for (auto _ : state) {
+        for (const auto& text : texts) {
+            DocumentInfo info;
+            extractor->analyze(text, info);
+            benchmark::DoNotOptimize(info.extracted_data.size());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(BM_FieldExtraction);
+
+// Recognition plus field extraction, as /analyze does
+static void BM_AnalyzeDocumentFromMat(benchmark::State& state) {
+    OCREngine* engine = sharedEngine();
+    if (!engine) {
+        state.SkipWithError("eng traineddata not found");
+        return;
+    }
+    OCROptions options;
+    options.detail = ResultDetail::Text;
+    for (auto _ : state) {
+        DocumentInfo info = engine->analyzeDocumentFromMat(samplePage(), options);
+        benchmark::DoNotOptimize(info.overall_confidence);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AnalyzeDocumentFromMat)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Arg: adaptive (0 runs the full preprocessing path directly)
+static void BM_ExtractTextFromMat(benchmark::State& state) {
+    OCREngine* engine = sharedEngine();
+    if (!engine) {
+        state.SkipWithError("eng traineddata not found");
+        return;
+    }
+    OCROptions options;
+    options.adaptive = state.range(0) != 0;
+    for (auto _ : state) {
+        OCRResult result = engine->extractTextFromMat(samplePage(), options);
+        benchmark::DoNotOptimize(result.word_count);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractTextFromMat)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Response serialization; Arg: ResultDetail. The result comes from one real
+// recognition when an engine is available, otherwise from the ground truth.
+static void BM_SerializeResult(benchmark::State& state) {
+    static const OCRResult result = [] {
+        OCREngine* engine = sharedEngine();
+        OCROptions options;
+        options.detail = ResultDetail::Layout;
+        if (engine) {
+            return engine->extractTextFromMat(samplePage(), options);
+        }
+        // Text built from the words, as the engine does, so spans index it
+        OCRResult synthetic{};
+        synthetic.confidence = 90.0;
+        int line = 0;
+        for (const auto& text_line : corpus().front().lines) {
+            int x = 0;
+            size_t start = 0;
+            while (start < text_line.size()) {
+                size_t end = text_line.find(' ', start);
+                end = end == std::string::npos ? text_line.size() : end;
+                if (end > start) {
+                    if (x > 0) {
+                        synthetic.text += ' ';
+                    }
+                    synthetic.appendWord(std::string_view(text_line).substr(start, end - start), 90.0f);
+                    synthetic.bounding_boxes.emplace_back(x, line * 64, static_cast<int>(end - start) * 28, 40);
+                    synthetic.word_line_ids.push_back(line);
+                    x += static_cast<int>(end - start + 1) * 28;
+                }
+                start = end + 1;
+            }
+            synthetic.text += '\n';
+            synthetic.line_boxes.emplace_back(0, line * 64, x, 40);
+            synthetic.line_block_ids.push_back(0);
+            synthetic.line_paragraph_ids.push_back(0);
+            line++;
+        }
+        synthetic.word_count = synthetic.storedWords();
+        return synthetic;
+    }();
+
+    auto detail = static_cast<ResultDetail>(state.range(0));
+    for (auto _ : state) {
+        std::string body = APIHandler::serializeResult(result, detail).dump();
+        benchmark::DoNotOptimize(body.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SerializeResult)
+    ->Arg(static_cast<int64_t>(ResultDetail::Text))
+    ->Arg(static_cast<int64_t>(ResultDetail::Words))
+    ->Arg(static_cast<int64_t>(ResultDetail::WordBoxes))
+    ->Arg(static_cast<int64_t>(ResultDetail::Layout));
+
+BENCHMARK_MAIN();
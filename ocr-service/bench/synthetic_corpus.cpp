@@ -0,0 +1,145 @@
+#include "synthetic_corpus.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr int kPageWidth = 1700;   // 8.5 in at 200 dpi
+constexpr int kPageHeight = 2200;  // 11 in at 200 dpi
+constexpr int kMargin = 120;
+constexpr int kLineHeight = 64;
+
+std::string collapseWhitespace(const std::string& text) {
+    std::string collapsed;
+    collapsed.reserve(text.size());
+    bool pending_space = false;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = !collapsed.empty();
+            continue;
+        }
+        if (pending_space) {
+            collapsed.push_back(' ');
+            pending_space = false;
+        }
+        collapsed.push_back(c);
+    }
+    return collapsed;
+}
+
+}
+
+std::string CorpusDocument::text() const {
+    std::string joined;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0) {
+            joined.push_back('\n');
+        }
+        joined += lines[i];
+    }
+    return joined;
+}
+
+bool loadCorpus(const std::string& path, std::vector<CorpusDocument>& documents, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    try {
+        json data = json::parse(file);
+        documents.clear();
+        for (const auto& entry : data.at("documents")) {
+            CorpusDocument document;
+            document.name = entry.at("name").get<std::string>();
+            document.lines = entry.at("lines").get<std::vector<std::string>>();
+            documents.push_back(std::move(document));
+        }
+    } catch (const json::exception& e) {
+        error = path + ": " + e.what();
+        return false;
+    }
+
+    if (documents.empty()) {
+        error = path + " has no documents";
+        return false;
+    }
+    return true;
+}
+
+std::string defaultCorpusPath() {
+    const char* path = std::getenv("OCR_BENCH_CORPUS");
+    return path ? path : OCR_BENCH_CORPUS_DIR "/documents.json";
+}
+
+cv::Mat renderPage(const CorpusDocument& document, uint32_t variant) {
+    cv::Mat page(kPageHeight, kPageWidth, CV_8UC1, cv::Scalar(245));
+
+    int baseline = kMargin + kLineHeight;
+    for (const std::string& line : document.lines) {
+        if (!line.empty()) {
+            cv::putText(page, line, cv::Point(kMargin, baseline), cv::FONT_HERSHEY_SIMPLEX, 1.3,
+                        cv::Scalar(25), 2, cv::LINE_AA);
+        }
+        baseline += kLineHeight;
+    }
+
+    if (variant == 0) {
+        return page;
+    }
+
+    // Skew cycles through -1.2 .. +1.2 degrees
+    double angle = (static_cast<int>(variant % 5) - 2) * 0.6;
+    if (angle != 0.0) {
+        cv::Point2f center(page.cols / 2.0f, page.rows / 2.0f);
+        cv::Mat rotation = cv::getRotationMatrix2D(center, angle, 1.0);
+        cv::Mat rotated;
+        cv::warpAffine(page, rotated, rotation, page.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        page = rotated;
+    }
+
+    cv::RNG rng(variant);
+    for (int y = 0; y < page.rows; y++) {
+        uchar* row = page.ptr(y);
+        for (int x = 0; x < page.cols; x++) {
+            row[x] = cv::saturate_cast<uchar>(row[x] + rng.uniform(-12, 13));
+        }
+    }
+    return page;
+}
+
+std::vector<uchar> encodePage(const cv::Mat& page) {
+    std::vector<uchar> png;
+    cv::imencode(".png", page, png);
+    return png;
+}
+
+double characterErrorRate(const std::string& expected, const std::string& actual) {
+    std::string a = collapseWhitespace(expected);
+    std::string b = collapseWhitespace(actual);
+    if (a.empty()) {
+        return b.empty() ? 0.0 : 1.0;
+    }
+
+    // Two-row dynamic programming table
+    std::vector<size_t> previous(b.size() + 1);
+    std::vector<size_t> current(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); i++) {
+        current[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution});
+        }
+        std::swap(previous, current);
+    }
+    return static_cast<double>(previous[b.size()]) / static_cast<double>(a.size());
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// One page of the synthetic invoice/receipt corpus. Pages are stored as their
+// text and rendered on demand, so the ground truth is exact and nothing binary
+// is checked in.
+struct CorpusDocument {
+    std::string name;
+    std::vector<std::string> lines;
+
+    // Ground truth: the lines joined with newlines
+    std::string text() const;
+};
+
+// Reads bench/corpus/documents.json (or another file of the same shape)
+bool loadCorpus(const std::string& path, std::vector<CorpusDocument>& documents, std::string& error);
+
+// The corpus file to use: $OCR_BENCH_CORPUS, else the copy in the source tree
+std::string defaultCorpusPath();
+
+// Renders a document as a 200 dpi letter-size grayscale scan. Variant 0 is a
+// clean, level page; other variants add deterministic sensor noise and up to
+// 1.2 degrees of skew, and every variant yields a distinct image so repeated
+// submissions are not served from the result cache.
+cv::Mat renderPage(const CorpusDocument& document, uint32_t variant);
+
+// PNG of renderPage, for submitting over HTTP
+std::vector<uchar> encodePage(const cv::Mat& page);
+
+// Levenshtein distance over whitespace-collapsed text, divided by the length
+// of the expected text
+double characterErrorRate(const std::string& expected, const std::string& actual);
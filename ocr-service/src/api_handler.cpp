@@ -1,16 +1,41 @@
 #include "api_handler.h"
+#include "metrics.h"
+#include "content_hash.h"
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+#include <iterator>
+#include <cmath>
 
-APIHandler::APIHandler(OCREngine& engine) : ocr_engine_(engine) {
+APIHandler::APIHandler(EnginePool& engine_pool, WorkStealingScheduler& scheduler, ResultCache& result_cache,
+                       PageTiler& page_tiler, DocumentPipeline& document_pipeline, JobManager& job_manager,
+                       RasterSource& raster_source, size_t upload_spill_bytes)
+    : engine_pool_(engine_pool), scheduler_(scheduler), result_cache_(result_cache), page_tiler_(page_tiler),
+      document_pipeline_(document_pipeline), job_manager_(job_manager), raster_source_(raster_source),
+      upload_spill_bytes_(upload_spill_bytes),
+      extract_latency_(requestHistogram("extract")),
+      text_latency_(requestHistogram("text")),
+      analyze_latency_(requestHistogram("analyze")),
+      batch_latency_(requestHistogram("batch")),
+      extract_memory_(FrameMemoryHistograms::forEndpoint("extract")),
+      text_memory_(FrameMemoryHistograms::forEndpoint("text")),
+      analyze_memory_(FrameMemoryHistograms::forEndpoint("analyze")),
+      batch_memory_(FrameMemoryHistograms::forEndpoint("batch")) {
     // Create upload directory if it doesn't exist
     std::filesystem::create_directories("/tmp/ocr_uploads");
 }
 
 crow::response APIHandler::handleExtractRequest(const crow::request& req) {
     try {
+        RequestTrace trace("POST /api/v1/ocr/extract", req.get_header_value("traceparent"));
+        StageTimer request_timer(extract_latency_);
+        FrameMemoryScope request_memory(extract_memory_);
+        TenantScope tenant(requestTenant(req, RequestClass::Interactive));
         auto start_time = std::chrono::high_resolution_clock::now();
         
         // Parse request
@@ -26,25 +51,80 @@ crow::response APIHandler::handleExtractRequest(const crow::request& req) {
             return crow::response(400, createErrorResponse("Missing required fields").dump());
         }
         
+        OCROptions options;
+        std::string options_error;
+        if (!parseOCROptions(request_data, ResultDetail::Words, options, options_error)) {
+            return crow::response(400, createErrorResponse(options_error).dump());
+        }
+        
+        // Co-located callers hand over a decoded raster: no read, no decode
+        ExecutionInfo execution;
+        if (request_data.contains("raster")) {
+            RasterHandle raster;
+            std::string raster_error;
+            if (!openRaster(request_data["raster"], raster, raster_error)) {
+                return crow::response(400, createErrorResponse(raster_error).dump());
+            }
+            auto cached = extractRaster(raster, options, execution);
+            if (!cached) {
+                return createPoolBusyResponse();
+            }
+            json response_data = serializeResult(*cached, options.detail);
+            response_data["processing_time"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - start_time).count();
+            response_data["queue_time"] = execution.queue_time_ms;
+            response_data["cached"] = execution.cache_hit;
+            return createSuccessHttpResponse(req, std::move(response_data));
+        }
+        
+        // Map the encoded bytes once: they key the cache and are decoded from memory
         std::string file_path = request_data["file_path"];
+        std::shared_ptr<const MappedRegion> mapped = mapImageFile(file_path);
+        std::string_view image_data = mapped ? mapped->bytes() : std::string_view();
+        
+        if (isPagedDocument(image_data)) {
+            std::vector<std::shared_ptr<const OCRResult>> pages;
+            std::string error;
+            DocumentStatus status = extractDocument(image_data, options, pages, error, execution);
+            if (status != DocumentStatus::Ok) {
+                return createDocumentErrorResponse(status, error);
+            }
+            
+            auto end_time = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+            
+            // Document-level text up front, per-page detail underneath
+            json response_data = serializeResult(combinePages(pages), ResultDetail::Text);
+            response_data["processing_time"] = duration.count();
+            response_data["queue_time"] = execution.queue_time_ms;
+            response_data["cached"] = execution.cache_hit;
+            response_data["page_count"] = pages.size();
+            response_data["pages"] = json::array();
+            for (size_t i = 0; i < pages.size(); i++) {
+                json page = serializeResult(*pages[i], options.detail);
+                page["page"] = i + 1;
+                response_data["pages"].push_back(std::move(page));
+            }
+            
+            return createSuccessHttpResponse(req, std::move(response_data));
+        }
         
         // Perform OCR
-        OCRResult result = ocr_engine_.extractText(file_path);
+        auto cached = extractCached(image_data, options, execution);
+        if (!cached) {
+            return createPoolBusyResponse();
+        }
         
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
         
         // Prepare response
-        json response_data = {
-            {"text", result.text},
-            {"confidence", result.confidence},
-            {"processing_time", duration.count()},
-            {"word_count", result.words.size()},
-            {"words", result.words},
-            {"word_confidences", result.word_confidences}
-        };
+        json response_data = serializeResult(*cached, options.detail);
+        response_data["processing_time"] = duration.count();
+        response_data["queue_time"] = execution.queue_time_ms;
+        response_data["cached"] = execution.cache_hit;
         
-        return crow::response(200, createSuccessResponse(response_data).dump());
+        return createSuccessHttpResponse(req, std::move(response_data));
         
     } catch (const std::exception& e) {
         return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
@@ -53,31 +133,70 @@ crow::response APIHandler::handleExtractRequest(const crow::request& req) {
 
 crow::response APIHandler::handleTextExtraction(const crow::request& req) {
     try {
+        RequestTrace trace("POST /api/v1/ocr/text", req.get_header_value("traceparent"));
+        StageTimer request_timer(text_latency_);
+        FrameMemoryScope request_memory(text_memory_);
+        TenantScope tenant(requestTenant(req, RequestClass::Interactive));
         auto start_time = std::chrono::high_resolution_clock::now();
         
         // Handle multipart form data for file upload
         crow::multipart::message msg(req);
         
-        std::string file_path;
-        for (const auto& part : msg.parts) {
-            if (part.headers.find("Content-Disposition") != part.headers.end()) {
-                auto content_disposition = part.headers.at("Content-Disposition");
-                if (content_disposition.find("filename=") != std::string::npos) {
-                    file_path = saveUploadedFile(msg);
-                    break;
-                }
-            }
+        const crow::multipart::part* upload = findUploadedFile(msg);
+        if (!upload) {
+            return crow::response(400, createErrorResponse("No file uploaded").dump());
         }
         
-        if (file_path.empty()) {
-            return crow::response(400, createErrorResponse("No file uploaded").dump());
+        OCROptions options;
+        std::string options_error;
+        if (!parseOCROptions(req.url_params, ResultDetail::Text, options, options_error)) {
+            return crow::response(400, createErrorResponse(options_error).dump());
         }
         
-        // Perform OCR
-        OCRResult result = ocr_engine_.extractText(file_path);
+        // Documents are read page by page from the request buffer, which Crow
+        // already holds in full. Small and medium images are decoded straight
+        // from it too; only oversized images take the detour through disk.
+        ExecutionInfo execution;
+        std::shared_ptr<const OCRResult> cached;
+        size_t page_count = 1;
+        if (isPagedDocument(upload->body)) {
+            std::vector<std::shared_ptr<const OCRResult>> pages;
+            std::string error;
+            DocumentStatus status = extractDocument(upload->body, options, pages, error, execution);
+            if (status != DocumentStatus::Ok) {
+                return createDocumentErrorResponse(status, error);
+            }
+            cached = std::make_shared<const OCRResult>(combinePages(pages));
+            page_count = pages.size();
+        } else if (upload->body.size() <= upload_spill_bytes_) {
+            cached = extractCached(upload->body, options, execution);
+        } else {
+            std::string file_path = saveUploadedFile(*upload);
+            if (file_path.empty()) {
+                return crow::response(500, createErrorResponse("Failed to store uploaded file", 500).dump());
+            }
+            
+            // Oversized uploads are the large scans tiling is for, so they
+            // take the same decode-then-recognize route as in-memory ones
+            cv::Mat image = decodeImageFile(file_path, options.decode);
+            if (image.empty()) {
+                std::cerr << "Failed to load image: " << file_path << std::endl;
+                cached = std::make_shared<const OCRResult>();
+            } else {
+                auto result = std::make_shared<OCRResult>();
+                if (recognize(image, options, *result, execution)) {
+                    cached = result;
+                }
+            }
+            
+            // Clean up uploaded file
+            std::filesystem::remove(file_path);
+        }
         
-        // Clean up uploaded file
-        std::filesystem::remove(file_path);
+        if (!cached) {
+            return createPoolBusyResponse();
+        }
+        const OCRResult& result = *cached;
         
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
@@ -87,10 +206,13 @@ crow::response APIHandler::handleTextExtraction(const crow::request& req) {
             {"text", result.text},
             {"confidence", result.confidence},
             {"processing_time", duration.count()},
-            {"word_count", result.words.size()}
+            {"queue_time", execution.queue_time_ms},
+            {"cached", execution.cache_hit},
+            {"word_count", result.word_count},
+            {"page_count", page_count}
         };
         
-        return crow::response(200, createSuccessResponse(response_data).dump());
+        return createSuccessHttpResponse(req, std::move(response_data));
         
     } catch (const std::exception& e) {
         return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
@@ -99,6 +221,10 @@ crow::response APIHandler::handleTextExtraction(const crow::request& req) {
 
 crow::response APIHandler::handleDocumentAnalysis(const crow::request& req) {
     try {
+        RequestTrace trace("POST /api/v1/ocr/analyze", req.get_header_value("traceparent"));
+        StageTimer request_timer(analyze_latency_);
+        FrameMemoryScope request_memory(analyze_memory_);
+        TenantScope tenant(requestTenant(req, RequestClass::Interactive));
         auto start_time = std::chrono::high_resolution_clock::now();
         
         // Parse request
@@ -109,14 +235,50 @@ crow::response APIHandler::handleDocumentAnalysis(const crow::request& req) {
             return crow::response(400, createErrorResponse("Invalid JSON format").dump());
         }
         
-        if (!request_data.contains("file_path")) {
+        if (!validateRequest(request_data)) {
             return crow::response(400, createErrorResponse("Missing file_path field").dump());
         }
         
-        std::string file_path = request_data["file_path"];
+        OCROptions options;
+        std::string options_error;
+        if (!parseOCROptions(request_data, ResultDetail::Text, options, options_error)) {
+            return crow::response(400, createErrorResponse(options_error).dump());
+        }
+        if (request_data.contains("tables") && !request_data["tables"].is_boolean()) {
+            return crow::response(400, createErrorResponse("tables must be a boolean").dump());
+        }
+        // Field extraction only reads the text, table extraction the word
+        // boxes, and pages are never tiled
+        options.tables = request_data.value("tables", false);
+        options.detail = options.tables ? ResultDetail::WordBoxes : ResultDetail::Text;
+        options.tiling = TilingMode::Off;
         
         // Perform document analysis
-        DocumentInfo info = ocr_engine_.analyzeDocument(file_path);
+        ExecutionInfo execution;
+        std::shared_ptr<const DocumentInfo> cached;
+        if (request_data.contains("raster")) {
+            RasterHandle raster;
+            std::string raster_error;
+            if (!openRaster(request_data["raster"], raster, raster_error)) {
+                return crow::response(400, createErrorResponse(raster_error).dump());
+            }
+            cached = analyzeRaster(raster, options, execution);
+            if (!cached) {
+                return createPoolBusyResponse();
+            }
+        } else {
+            std::string file_path = request_data["file_path"];
+            std::shared_ptr<const MappedRegion> mapped = mapImageFile(file_path);
+            std::string_view image_data = mapped ? mapped->bytes() : std::string_view();
+            
+            DocumentStatus status = DocumentStatus::Ok;
+            std::string error;
+            cached = analyzeData(image_data, options, status, error, execution);
+            if (!cached) {
+                return createDocumentErrorResponse(status, error);
+            }
+        }
+        const DocumentInfo& info = *cached;
         
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
@@ -127,10 +289,15 @@ crow::response APIHandler::handleDocumentAnalysis(const crow::request& req) {
             {"detected_fields", info.detected_fields},
             {"extracted_data", info.extracted_data},
             {"overall_confidence", info.overall_confidence},
-            {"processing_time", duration.count()}
+            {"processing_time", duration.count()},
+            {"queue_time", execution.queue_time_ms},
+            {"cached", execution.cache_hit}
         };
+        if (options.tables) {
+            response_data["tables"] = serializeTables(info.tables);
+        }
         
-        return crow::response(200, createSuccessResponse(response_data).dump());
+        return createSuccessHttpResponse(req, std::move(response_data));
         
     } catch (const std::exception& e) {
         return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
@@ -138,64 +305,558 @@ crow::response APIHandler::handleDocumentAnalysis(const crow::request& req) {
 }
 
 crow::response APIHandler::handleBatchProcessing(const crow::request& req) {
+    json request_data;
+    try {
+        request_data = json::parse(req.body);
+    } catch (const json::exception& e) {
+        return crow::response(400, createErrorResponse("Invalid JSON format").dump());
+    }
+    
+    return processBatch(req, request_data, nullptr);
+}
+
+crow::response APIHandler::processBatch(const crow::request& req, const json& request_data,
+                                        const ResultEmitter* emit) {
     try {
+        RequestTrace trace("POST /api/v1/ocr/batch", req.get_header_value("traceparent"));
+        StageTimer request_timer(batch_latency_);
+        FrameMemoryScope request_memory(batch_memory_);
+        TenantScope tenant(requestTenant(req, RequestClass::Bulk));
         auto start_time = std::chrono::high_resolution_clock::now();
         
-        // Parse request
-        json request_data;
-        try {
-            request_data = json::parse(req.body);
-        } catch (const json::exception& e) {
-            return crow::response(400, createErrorResponse("Invalid JSON format").dump());
-        }
-        
         if (!request_data.contains("file_paths") || !request_data["file_paths"].is_array()) {
             return crow::response(400, createErrorResponse("Missing or invalid file_paths array").dump());
         }
         
         std::vector<std::string> file_paths = request_data["file_paths"];
+        OCROptions options;
+        std::string options_error;
+        if (!parseOCROptions(request_data, ResultDetail::Text, options, options_error)) {
+            return crow::response(400, createErrorResponse(options_error).dump());
+        }
+        // Batch items only ever report text
+        options.detail = ResultDetail::Text;
         
         if (file_paths.empty()) {
             return crow::response(400, createErrorResponse("Empty file_paths array").dump());
         }
         
-        // Process batch
-        std::vector<OCRResult> results = ocr_engine_.processBatch(file_paths);
+        // Spread the pages across the engine pool; each item checks out its own
+        // engine so idle workers keep pulling pages until the batch is drained.
+        // When streaming, every item is emitted the moment it finishes and
+        // nothing but the running totals is kept.
+        std::vector<std::shared_ptr<const OCRResult>> results(emit ? 0 : file_paths.size());
+        std::vector<std::string> errors(emit ? 0 : file_paths.size());
+        std::mutex totals_mutex;
+        double streamed_confidence_sum = 0.0;
+        const TenantContext& batch_tenant = TenantScope::current();
+        TraceLink batch_trace = TraceScope::current();
+        scheduler_.parallelFor(file_paths.size(), [&](size_t i) {
+            TenantScope item_tenant(batch_tenant);
+            TraceScope item_trace(batch_trace);
+            std::string error;
+            auto result = extractBatchItem(file_paths[i], options, error);
+            if (!emit) {
+                results[i] = std::move(result);
+                errors[i] = std::move(error);
+                return;
+            }
+            
+            json item = serializeBatchItem(result.get(), error);
+            item["index"] = i;
+            if (result) {
+                std::lock_guard<std::mutex> lock(totals_mutex);
+                streamed_confidence_sum += result->confidence;
+            }
+            (*emit)(item.dump());
+        });
         
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
         
         // Prepare response
+        json response_data = {
+            {"total_files", file_paths.size()},
+            {"processing_time", duration.count()}
+        };
+        if (emit) {
+            response_data["streamed"] = true;
+            response_data["average_confidence"] = streamed_confidence_sum / file_paths.size();
+            return createSuccessHttpResponse(req, std::move(response_data));
+        }
+        
         json batch_results = json::array();
-        for (const auto& result : results) {
-            batch_results.push_back({
-                {"text", result.text},
-                {"confidence", result.confidence},
-                {"word_count", result.words.size()}
-            });
+        double confidence_sum = 0.0;
+        for (size_t i = 0; i < results.size(); i++) {
+            batch_results.push_back(serializeBatchItem(results[i].get(), errors[i]));
+            if (results[i]) {
+                confidence_sum += results[i]->confidence;
+            }
+        }
+        response_data["results"] = std::move(batch_results);
+        response_data["average_confidence"] = confidence_sum / results.size();
+        
+        return createSuccessHttpResponse(req, std::move(response_data));
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
+    }
+}
+
+std::shared_ptr<const OCRResult> APIHandler::extractBatchItem(const std::string& file_path,
+                                                              const OCROptions& options,
+                                                              std::string& error) {
+    std::shared_ptr<const MappedRegion> mapped = mapImageFile(file_path);
+    std::string_view image_data = mapped ? mapped->bytes() : std::string_view();
+    
+    ExecutionInfo execution;
+    if (isPagedDocument(image_data)) {
+        std::vector<std::shared_ptr<const OCRResult>> pages;
+        if (extractDocument(image_data, options, pages, error, execution) != DocumentStatus::Ok) {
+            return nullptr;
+        }
+        return std::make_shared<const OCRResult>(combinePages(pages));
+    }
+    return extractCached(image_data, options, execution);
+}
+
+json APIHandler::serializeBatchItem(const OCRResult* result, const std::string& error) {
+    if (!result) {
+        return {
+            {"text", ""},
+            {"confidence", 0.0},
+            {"word_count", 0},
+            {"error", error.empty() ? "No OCR engine became available" : error}
+        };
+    }
+    return {
+        {"text", result->text},
+        {"confidence", result->confidence},
+        {"word_count", result->word_count}
+    };
+}
+
+MetricHistogram& APIHandler::requestHistogram(const std::string& endpoint) {
+    return MetricsRegistry::global().histogram("ocr_request_duration_seconds",
+                                               "End-to-end request handling time by endpoint",
+                                               std::string("endpoint=\"") + endpoint + "\"");
+}
+
+std::string APIHandler::cacheConfig(const OCROptions& options) const {
+    return engine_pool_.configKey(options.language) + "|" + options.cacheKey();
+}
+
+std::shared_ptr<const OCRResult> APIHandler::extractCached(std::string_view image_data,
+                                                           const OCROptions& options,
+                                                           ExecutionInfo& execution) {
+    // Nothing to decode; answer like the engine would without tying one up
+    if (image_data.empty()) {
+        return std::make_shared<const OCRResult>();
+    }
+    
+    ResultCache::Key key = ResultCache::makeKey(image_data, cacheConfig(options));
+    if (auto hit = result_cache_.findText(key)) {
+        execution.cache_hit = true;
+        return hit;
+    }
+    
+    // Decode before checking out an engine: the page size decides whether it
+    // is tiled, and the decode itself doesn't need Tesseract
+    cv::Mat image = decodeImageBuffer(image_data, options.decode);
+    if (image.empty()) {
+        std::cerr << "Failed to decode image buffer of " << image_data.size() << " bytes" << std::endl;
+        return std::make_shared<const OCRResult>();
+    }
+    
+    auto result = std::make_shared<OCRResult>();
+    if (!recognize(image, options, *result, execution)) {
+        return nullptr;
+    }
+    
+    // Failed decodes and blank pages are cheap to redo and not worth a slot
+    if (!result->text.empty()) {
+        result_cache_.insert(key, result);
+    }
+    return result;
+}
+
+std::string APIHandler::rasterCacheConfig(const RasterHandle& raster, const OCROptions& options) const {
+    // Equal bytes only mean the same page at the same geometry
+    return cacheConfig(options) + "|raster=" + std::to_string(raster.image.cols) + "x" +
+           std::to_string(raster.image.rows) + "x" + std::to_string(raster.image.channels()) + "/" +
+           std::to_string(raster.image.step);
+}
+
+std::shared_ptr<const OCRResult> APIHandler::extractRaster(const RasterHandle& raster, const OCROptions& options,
+                                                           ExecutionInfo& execution) {
+    ResultCache::Key key = ResultCache::makeKey(raster.bytes(), rasterCacheConfig(raster, options));
+    if (auto hit = result_cache_.findText(key)) {
+        execution.cache_hit = true;
+        return hit;
+    }
+    
+    auto result = std::make_shared<OCRResult>();
+    if (!recognize(raster.image, options, *result, execution)) {
+        return nullptr;
+    }
+    if (!result->text.empty()) {
+        result_cache_.insert(key, result);
+    }
+    return result;
+}
+
+std::shared_ptr<const DocumentInfo> APIHandler::analyzeRaster(const RasterHandle& raster, const OCROptions& options,
+                                                              ExecutionInfo& execution) {
+    ResultCache::Key key = ResultCache::makeKey(raster.bytes(), rasterCacheConfig(raster, options));
+    if (auto hit = result_cache_.findDocument(key)) {
+        execution.cache_hit = true;
+        return hit;
+    }
+    
+    EnginePool::Lease engine = engine_pool_.acquire(options.language, raster.image.total());
+    if (!engine) {
+        return nullptr;
+    }
+    execution.queue_time_ms = engine.waitTimeMs();
+    
+    auto info = std::make_shared<DocumentInfo>(engine->analyzeDocumentFromMat(raster.image, options));
+    if (!info->document_type.empty()) {
+        result_cache_.insert(key, info);
+    }
+    return info;
+}
+
+std::shared_ptr<const DocumentInfo> APIHandler::analyzeData(std::string_view data, const OCROptions& options,
+                                                        DocumentStatus& status, std::string& error,
+                                                        ExecutionInfo& execution) {
+    if (!isPagedDocument(data)) {
+        auto info = analyzeCached(data, options, execution);
+        status = info ? DocumentStatus::Ok : DocumentStatus::EngineUnavailable;
+        return info;
+    }
+    
+    // Multi-page documents are read in full and analyzed as one text
+    std::vector<std::shared_ptr<const OCRResult>> pages;
+    status = extractDocument(data, options, pages, error, execution);
+    if (status != DocumentStatus::Ok) {
+        return nullptr;
+    }
+    
+    OCRResult combined = combinePages(pages);
+    auto info = std::make_shared<DocumentInfo>();
+    info->overall_confidence = combined.confidence;
+    if (!combined.text.empty()) {
+        engine_pool_.fieldExtractor()->analyze(combined.text, *info);
+    }
+    if (options.tables) {
+        // Word boxes are page coordinates, so tables come page by page
+        for (size_t i = 0; i < pages.size(); i++) {
+            std::vector<ExtractedTable> tables = extractTables(*pages[i], static_cast<int>(i));
+            std::move(tables.begin(), tables.end(), std::back_inserter(info->tables));
+        }
+    }
+    return info;
+}
+
+crow::response APIHandler::handleJobSubmission(const crow::request& req) {
+    try {
+        json request_data;
+        try {
+            request_data = json::parse(req.body);
+        } catch (const json::exception& e) {
+            return crow::response(400, createErrorResponse("Invalid JSON format").dump());
+        }
+        
+        if (!request_data.is_object()) {
+            return crow::response(400, createErrorResponse("Request body must be a JSON object").dump());
+        }
+        
+        std::string type;
+        std::string callback_url;
+        bool stream;
+        try {
+            type = request_data.value("type", std::string());
+            callback_url = request_data.value("callback_url", std::string());
+            stream = request_data.value("stream", false);
+        } catch (const json::exception&) {
+            return crow::response(400, createErrorResponse("Job fields have the wrong type").dump());
+        }
+        if (type != "extract" && type != "analyze" && type != "batch") {
+            return crow::response(400, createErrorResponse("type must be one of extract, analyze, batch").dump());
+        }
+        if (!callback_url.empty() && !job_manager_.acceptsCallback(callback_url)) {
+            return crow::response(400, createErrorResponse(
+                "callback_url must be an http(s) URL on an allowed host").dump());
+        }
+        
+        // The job runs long after this request's headers are gone, so its
+        // tenant travels in the body, overwriting anything the client put there
+        request_data["tenant"] = requestTenant(req, RequestClass::Bulk).tenant;
+        // Likewise the caller's trace, which the job's own trace continues
+        request_data["traceparent"] = req.get_header_value("traceparent");
+        
+        // Only batches produce more than one result worth streaming
+        bool streaming = type == "batch" && stream;
+        int priority = parseJobPriority(request_data);
+        std::string job_id;
+        if (!job_manager_.submit(type, std::move(request_data), priority, streaming, std::move(callback_url),
+                                 job_id)) {
+            return createQueueFullResponse();
         }
         
         json response_data = {
-            {"results", batch_results},
-            {"total_files", results.size()},
-            {"processing_time", duration.count()},
-            {"average_confidence", [&results]() {
-                if (results.empty()) return 0.0;
-                double sum = 0.0;
-                for (const auto& result : results) {
-                    sum += result.confidence;
-                }
-                return sum / results.size();
-            }()}
+            {"job_id", job_id},
+            {"status", jobStatusName(JobStatus::Queued)},
+            {"priority", priority},
+            {"status_url", "/api/v1/ocr/jobs/" + job_id}
+        };
+        if (streaming) {
+            response_data["results_url"] = "/api/v1/ocr/jobs/" + job_id + "/results";
+        }
+        
+        crow::response res = createSuccessHttpResponse(req, std::move(response_data), 202);
+        res.add_header("Location", "/api/v1/ocr/jobs/" + job_id);
+        return res;
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
+    }
+}
+
+crow::response APIHandler::handleJobStatus(const std::string& job_id, const crow::request& req) {
+    try {
+        JobSnapshot snapshot;
+        if (!job_manager_.find(job_id, snapshot)) {
+            return crow::response(404, createErrorResponse("Unknown or expired job", 404).dump());
+        }
+        
+        return createSuccessHttpResponse(req, snapshot.toJson());
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
+    }
+}
+
+crow::response APIHandler::handleJobResults(const std::string& job_id, const crow::request& req) {
+    try {
+        auto number = [&req](const char* name, uint64_t default_value) {
+            const char* value = req.url_params.get(name);
+            if (!value) {
+                return default_value;
+            }
+            try {
+                return static_cast<uint64_t>(std::stoull(value));
+            } catch (const std::exception&) {
+                return default_value;
+            }
         };
         
-        return crow::response(200, createSuccessResponse(response_data).dump());
+        // Long polls hold an HTTP worker, so the wait is capped
+        uint64_t cursor = number("cursor", 0);
+        auto wait = std::chrono::milliseconds(std::min<uint64_t>(number("wait_ms", 0), 30000));
+        
+        std::vector<std::string> lines;
+        uint64_t next_cursor = cursor;
+        JobStatus status = JobStatus::Queued;
+        if (!job_manager_.readResults(job_id, cursor, wait, lines, next_cursor, status)) {
+            return crow::response(404, createErrorResponse("Unknown or expired job", 404).dump());
+        }
+        
+        std::string body;
+        for (const auto& line : lines) {
+            body += line;
+            body += '\n';
+        }
+        
+        // NDJSON compresses as well as the JSON bodies do
+        std::string compressed;
+        bool gzipped = body.size() >= kGzipMinBytes && negotiateEncoding(req).gzip && gzipCompress(body, compressed);
+        
+        // Results arrive in completion order; each line carries its batch index
+        crow::response res(200, gzipped ? std::move(compressed) : std::move(body));
+        res.set_header("Content-Type", "application/x-ndjson");
+        if (gzipped) {
+            res.set_header("Content-Encoding", "gzip");
+        }
+        // Set whether or not this body was compressed, as the next one may be
+        res.set_header("Vary", "Accept-Encoding");
+        res.add_header("X-Next-Cursor", std::to_string(next_cursor));
+        res.add_header("X-Job-Status", jobStatusName(status));
+        return res;
         
     } catch (const std::exception& e) {
         return crow::response(500, createErrorResponse("Internal server error: " + std::string(e.what())).dump());
     }
 }
 
+JobOutcome APIHandler::runJob(const std::string& type, const json& request_data, const ResultEmitter& emit) {
+    // Jobs reuse the synchronous handlers so validation and response shapes
+    // are identical; the extra job fields in the body are ignored by them
+    crow::request req;
+    req.body = request_data.dump();
+    // The handlers see no tenant headers on req and inherit this scope
+    TenantScope tenant(TenantContext{request_data.value("tenant", std::string("anonymous")), RequestClass::Bulk});
+    // The handler's own trace nests into this one
+    const char* trace_name = type == "extract" ? "job extract"
+                           : type == "analyze" ? "job analyze"
+                           : type == "batch"   ? "job batch"
+                                               : "job";
+    RequestTrace trace(trace_name, request_data.value("traceparent", std::string()));
+    
+    // A job has already waited its turn in the queue; when every engine is
+    // still busy it backs off and tries again instead of failing outright
+    crow::response res;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::seconds(attempt));
+        }
+        if (type == "extract") {
+            res = handleExtractRequest(req);
+        } else if (type == "analyze") {
+            res = handleDocumentAnalysis(req);
+        } else {
+            // Streaming batches publish each item to the job's result stream
+            // as it finishes instead of collecting them into the final body
+            bool stream = request_data.value("stream", false);
+            res = processBatch(req, request_data, stream ? &emit : nullptr);
+        }
+        if (res.code != 503) {
+            break;
+        }
+    }
+    
+    JobOutcome outcome;
+    outcome.status_code = res.code;
+    outcome.body = json::parse(res.body, nullptr, false);
+    if (outcome.body.is_discarded()) {
+        outcome.body = res.body;
+    }
+    return outcome;
+}
+
+bool APIHandler::isPagedDocument(std::string_view data) {
+    return DocumentReader::isPaged(
+        detectImageFormat(reinterpret_cast<const unsigned char*>(data.data()), data.size()));
+}
+
+DocumentStatus APIHandler::extractDocument(std::string_view document_data,
+                                           const OCROptions& options,
+                                           std::vector<std::shared_ptr<const OCRResult>>& pages,
+                                           std::string& error,
+                                           ExecutionInfo& execution,
+                                           const PageListener& on_page) {
+    std::unique_ptr<DocumentReader> reader = DocumentReader::open(document_data, options.decode);
+    
+    // Hash the document once; every page shares it and differs by index
+    uint64_t content_hash = xxhash64(document_data);
+    std::string config = cacheConfig(options);
+    
+    std::mutex execution_mutex;
+    bool all_cached = true;
+    double max_queue_time_ms = 0.0;
+    
+    // Pages are recognized on the pipeline's own threads
+    const TenantContext& document_tenant = TenantScope::current();
+    TraceLink document_trace = TraceScope::current();
+    auto recognizePage = [&](const cv::Mat& page, size_t page_index, std::shared_ptr<const OCRResult>& result) {
+        TenantScope page_tenant(document_tenant);
+        TraceScope page_trace(document_trace);
+        TraceSpan span("document.page");
+        span.annotate("document.page_index", static_cast<double>(page_index));
+        ResultCache::Key key{content_hash, xxhash64(config + "|page=" + std::to_string(page_index))};
+        ExecutionInfo page_execution;
+        if (auto hit = result_cache_.findText(key)) {
+            page_execution.cache_hit = true;
+            result = hit;
+        } else {
+            auto fresh = std::make_shared<OCRResult>();
+            if (!recognize(page, options, *fresh, page_execution)) {
+                return false;
+            }
+            if (!fresh->text.empty()) {
+                result_cache_.insert(key, fresh);
+            }
+            result = fresh;
+        }
+        if (on_page) {
+            on_page(page_index, result, page_execution.cache_hit);
+        }
+        
+        std::lock_guard<std::mutex> lock(execution_mutex);
+        all_cached = all_cached && page_execution.cache_hit;
+        max_queue_time_ms = std::max(max_queue_time_ms, page_execution.queue_time_ms);
+        return true;
+    };
+    
+    DocumentStatus status = document_pipeline_.run(*reader, recognizePage, pages, error);
+    execution.cache_hit = all_cached && !pages.empty();
+    execution.queue_time_ms = max_queue_time_ms;
+    return status;
+}
+
+OCRResult APIHandler::combinePages(const std::vector<std::shared_ptr<const OCRResult>>& pages) {
+    OCRResult combined{};
+    double confidence_sum = 0.0;
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (i > 0) {
+            combined.text += '\f';
+        }
+        combined.text += pages[i]->text;
+        combined.word_count += pages[i]->word_count;
+        confidence_sum += pages[i]->confidence * pages[i]->word_count;
+    }
+    combined.confidence = combined.word_count > 0 ? confidence_sum / combined.word_count : 0.0;
+    return combined;
+}
+
+bool APIHandler::recognize(const cv::Mat& image, const OCROptions& options, OCRResult& result,
+                           ExecutionInfo& execution) {
+    if (page_tiler_.shouldTile(image, options.tiling)) {
+        return page_tiler_.extract(image, options, result, execution.queue_time_ms);
+    }
+    
+    EnginePool::Lease engine = engine_pool_.acquire(options.language, image.total());
+    if (!engine) {
+        return false;
+    }
+    execution.queue_time_ms = engine.waitTimeMs();
+    result = engine->extractTextFromMat(image, options);
+    return true;
+}
+
+std::shared_ptr<const DocumentInfo> APIHandler::analyzeCached(std::string_view image_data,
+                                                              const OCROptions& options,
+                                                              ExecutionInfo& execution) {
+    if (image_data.empty()) {
+        return std::make_shared<const DocumentInfo>();
+    }
+    
+    ResultCache::Key key = ResultCache::makeKey(image_data, cacheConfig(options));
+    if (auto hit = result_cache_.findDocument(key)) {
+        execution.cache_hit = true;
+        return hit;
+    }
+    
+    // Decoded inside the engine, so the cost comes from the header
+    EnginePool::Lease engine = engine_pool_.acquire(options.language, probeImagePixels(image_data));
+    if (!engine) {
+        return nullptr;
+    }
+    execution.queue_time_ms = engine.waitTimeMs();
+    
+    auto info = std::make_shared<DocumentInfo>(engine->analyzeDocumentFromBuffer(image_data, options));
+    
+    if (!info->document_type.empty()) {
+        result_cache_.insert(key, info);
+    }
+    return info;
+}
+
+TenantContext APIHandler::requestTenant(const crow::request& req, RequestClass default_class) {
+    return TenantContext::identify(req.get_header_value("X-Tenant-ID"), req.get_header_value("X-API-Key"),
+                                   req.get_header_value("X-Request-Class"), default_class);
+}
+
 json APIHandler::createErrorResponse(const std::string& error, int status_code) {
     return {
         {"success", false},
@@ -206,48 +867,387 @@ json APIHandler::createErrorResponse(const std::string& error, int status_code)
     };
 }
 
-json APIHandler::createSuccessResponse(const json& data) {
-    return {
-        {"success", true},
-        {"data", data},
-        {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count()}
-    };
+json APIHandler::createSuccessResponse(json&& data) {
+    // Built member by member so data is moved into the envelope, not copied
+    json envelope = json::object();
+    envelope["success"] = true;
+    envelope["data"] = std::move(data);
+    envelope["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return envelope;
+}
+
+crow::response APIHandler::createSuccessHttpResponse(const crow::request& req, json&& data, int status_code) {
+    StageTimer timer(Stage::Serialize);
+    return encodeResponse(status_code, createSuccessResponse(std::move(data)), negotiateEncoding(req));
+}
+
+crow::response APIHandler::createPoolBusyResponse() {
+    crow::response res(503, createErrorResponse("All OCR engines are busy, retry later", 503).dump());
+    res.add_header("Retry-After", "1");
+    return res;
+}
+
+crow::response APIHandler::createQueueFullResponse() {
+    crow::response res(429, createErrorResponse("Job queue is full, retry later", 429).dump());
+    res.add_header("Retry-After", "5");
+    return res;
+}
+
+crow::response APIHandler::createDocumentErrorResponse(DocumentStatus status, const std::string& error) {
+    switch (status) {
+        case DocumentStatus::EngineUnavailable:
+            return createPoolBusyResponse();
+        case DocumentStatus::TooManyPages:
+            return crow::response(413, createErrorResponse(error, 413).dump());
+        default:
+            return crow::response(400, createErrorResponse(error).dump());
+    }
 }
 
 bool APIHandler::validateRequest(const json& request_data) {
-    return request_data.contains("file_path") && !request_data["file_path"].empty();
+    return request_data.contains("raster") ||
+           (request_data.contains("file_path") && !request_data["file_path"].empty());
+}
+
+std::shared_ptr<const MappedRegion> APIHandler::mapImageFile(const std::string& file_path) {
+    std::string error;
+    std::shared_ptr<const MappedRegion> mapped = MappedRegion::mapFile(file_path, error);
+    if (!mapped) {
+        std::cerr << "Failed to load image: " << error << std::endl;
+    }
+    return mapped;
+}
+
+bool APIHandler::openRaster(const json& descriptor, RasterHandle& raster, std::string& error) {
+    if (!descriptor.is_object()) {
+        error = "raster must be an object";
+        return false;
+    }
+    RasterDescriptor parsed;
+    try {
+        parsed.shm = descriptor.value("shm", std::string());
+        parsed.file = descriptor.value("file", std::string());
+        parsed.offset = descriptor.value("offset", parsed.offset);
+        parsed.width = descriptor.value("width", parsed.width);
+        parsed.height = descriptor.value("height", parsed.height);
+        parsed.stride = descriptor.value("stride", parsed.stride);
+        parsed.channels = descriptor.value("channels", parsed.channels);
+    } catch (const json::exception&) {
+        error = "raster fields have the wrong type";
+        return false;
+    }
+    return raster_source_.open(parsed, raster, error);
+}
+
+PreprocessingOptions APIHandler::parsePreprocessingOptions(const json& request_data) {
+    PreprocessingOptions options;
+    if (!request_data.contains("preprocessing")) {
+        return options;
+    }
+    
+    // "preprocessing": false skips every stage, e.g. for born-digital PDFs;
+    // an object toggles the stages individually
+    const json& preprocessing = request_data["preprocessing"];
+    if (preprocessing.is_boolean()) {
+        return preprocessing.get<bool>() ? options : PreprocessingOptions::none();
+    }
+    if (preprocessing.is_object()) {
+        options.enhance = preprocessing.value("enhance", options.enhance);
+        options.denoise = preprocessing.value("denoise", options.denoise);
+        options.deskew = preprocessing.value("deskew", options.deskew);
+    }
+    return options;
 }
 
-std::string APIHandler::saveUploadedFile(const crow::multipart::message& msg) {
+PreprocessingOptions APIHandler::parsePreprocessingOptions(const crow::query_string& params) {
+    auto flag = [&params](const char* name, bool default_value) {
+        const char* value = params.get(name);
+        if (!value) {
+            return default_value;
+        }
+        std::string text(value);
+        return !(text == "false" || text == "0" || text == "off");
+    };
+    
+    PreprocessingOptions options;
+    if (!flag("preprocessing", true)) {
+        return PreprocessingOptions::none();
+    }
+    options.enhance = flag("enhance", options.enhance);
+    options.denoise = flag("denoise", options.denoise);
+    options.deskew = flag("deskew", options.deskew);
+    return options;
+}
+
+DecodeOptions APIHandler::parseDecodeOptions(const json& request_data) {
+    DecodeOptions options;
+    options.source_dpi = request_data.value("source_dpi", options.source_dpi);
+    options.target_dpi = request_data.value("target_dpi", options.target_dpi);
+    return options;
+}
+
+const crow::multipart::part* APIHandler::findUploadedFile(const crow::multipart::message& msg) {
     for (const auto& part : msg.parts) {
-        if (part.headers.find("Content-Disposition") != part.headers.end()) {
-            auto content_disposition = part.headers.at("Content-Disposition");
-            
-            // Extract filename
-            size_t filename_pos = content_disposition.find("filename=");
-            if (filename_pos != std::string::npos) {
-                std::string filename = content_disposition.substr(filename_pos + 10);
-                filename = filename.substr(0, filename.find('"', 1));
-                
-                // Generate unique filename
-                auto now = std::chrono::system_clock::now();
-                auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    now.time_since_epoch()).count();
-                
-                std::string unique_filename = std::to_string(timestamp) + "_" + filename;
-                std::string file_path = "/tmp/ocr_uploads/" + unique_filename;
-                
-                // Save file
-                std::ofstream file(file_path, std::ios::binary);
-                if (file.is_open()) {
-                    file.write(part.body.c_str(), part.body.length());
-                    file.close();
-                    return file_path;
-                }
+        auto disposition = part.headers.find("Content-Disposition");
+        if (disposition != part.headers.end() &&
+            disposition->second.params.find("filename") != disposition->second.params.end()) {
+            return &part;
+        }
+    }
+    
+    return nullptr;
+}
+
+ResultDetail APIHandler::parseResultDetail(const json& request_data, ResultDetail default_detail) {
+    std::string detail = request_data.value("detail", std::string());
+    if (detail == "text") {
+        return ResultDetail::Text;
+    }
+    if (detail == "words") {
+        return ResultDetail::Words;
+    }
+    if (detail == "boxes") {
+        return ResultDetail::WordBoxes;
+    }
+    if (detail == "layout") {
+        return ResultDetail::Layout;
+    }
+    return default_detail;
+}
+
+int APIHandler::parseJobPriority(const json& request_data) {
+    if (!request_data.contains("priority")) {
+        return 5;
+    }
+    const json& priority = request_data["priority"];
+    if (priority.is_number_integer()) {
+        return priority.get<int>();
+    }
+    std::string name = priority.is_string() ? priority.get<std::string>() : std::string();
+    if (name == "high") {
+        return 10;
+    }
+    if (name == "low") {
+        return 0;
+    }
+    return 5;
+}
+
+TilingMode APIHandler::parseTilingMode(const json& request_data) {
+    if (!request_data.contains("tiling")) {
+        return TilingMode::Auto;
+    }
+    const json& tiling = request_data["tiling"];
+    if (tiling.is_boolean()) {
+        return tiling.get<bool>() ? TilingMode::On : TilingMode::Off;
+    }
+    return TilingMode::Auto;
+}
+
+TilingMode APIHandler::parseTilingMode(const crow::query_string& params) {
+    const char* value = params.get("tiling");
+    if (!value) {
+        return TilingMode::Auto;
+    }
+    std::string text(value);
+    if (text == "true" || text == "1" || text == "on") {
+        return TilingMode::On;
+    }
+    if (text == "false" || text == "0" || text == "off") {
+        return TilingMode::Off;
+    }
+    return TilingMode::Auto;
+}
+
+bool APIHandler::parseOCROptions(const json& request_data, ResultDetail default_detail, OCROptions& options,
+                                 std::string& error) {
+    int page_seg_mode;
+    try {
+        options.language = request_data.value("language", std::string());
+        options.char_whitelist = request_data.value("char_whitelist", options.char_whitelist);
+        options.dpi = request_data.value("dpi", options.dpi);
+        options.preprocessing = parsePreprocessingOptions(request_data);
+        options.decode = parseDecodeOptions(request_data);
+        options.detail = parseResultDetail(request_data, default_detail);
+        options.tiling = parseTilingMode(request_data);
+        options.adaptive = request_data.value("adaptive", options.adaptive);
+        options.confidence_threshold = request_data.value("confidence_threshold", options.confidence_threshold);
+        page_seg_mode = request_data.value("psm", static_cast<int>(options.page_seg_mode));
+    } catch (const json::exception&) {
+        error = "OCR options have the wrong type";
+        return false;
+    }
+    return checkOCROptions(page_seg_mode, options, error);
+}
+
+bool APIHandler::parseOCROptions(const crow::query_string& params, ResultDetail default_detail, OCROptions& options,
+                                 std::string& error) {
+    // Out-of-range -1 when the value is not a number in full, so "12abc"
+    // is refused like any other bad value instead of read as 12
+    auto number = [&params](const char* name, int default_value) {
+        const char* value = params.get(name);
+        if (!value) {
+            return default_value;
+        }
+        try {
+            size_t used = 0;
+            int parsed = std::stoi(value, &used);
+            return value[used] == '\0' ? parsed : -1;
+        } catch (const std::exception&) {
+            return -1;
+        }
+    };
+    auto decimal = [&params](const char* name, double default_value) {
+        const char* value = params.get(name);
+        if (!value) {
+            return default_value;
+        }
+        try {
+            size_t used = 0;
+            double parsed = std::stod(value, &used);
+            return value[used] == '\0' && std::isfinite(parsed) ? parsed : -1.0;
+        } catch (const std::exception&) {
+            return -1.0;
+        }
+    };
+    
+    const char* language = params.get("language");
+    const char* whitelist = params.get("char_whitelist");
+    options.language = language ? language : "";
+    if (whitelist) {
+        options.char_whitelist = whitelist;
+    }
+    options.dpi = number("dpi", options.dpi);
+    options.preprocessing = parsePreprocessingOptions(params);
+    options.detail = default_detail;
+    options.tiling = parseTilingMode(params);
+    const char* adaptive = params.get("adaptive");
+    if (adaptive) {
+        std::string text(adaptive);
+        options.adaptive = !(text == "false" || text == "0" || text == "off");
+    }
+    options.confidence_threshold = decimal("confidence_threshold", options.confidence_threshold);
+    return checkOCROptions(number("psm", static_cast<int>(options.page_seg_mode)), options, error);
+}
+
+bool APIHandler::checkOCROptions(int page_seg_mode, OCROptions& options, std::string& error) {
+    if (!engine_pool_.hasLanguage(options.language)) {
+        error = "Unsupported language: " + options.language;
+        return false;
+    }
+    
+    // OSD-only and layout-only modes produce no text to return
+    if (page_seg_mode < tesseract::PSM_AUTO_OSD || page_seg_mode == tesseract::PSM_AUTO_ONLY ||
+        page_seg_mode >= tesseract::PSM_COUNT) {
+        error = "psm must be 1 or between 3 and 13";
+        return false;
+    }
+    options.page_seg_mode = static_cast<tesseract::PageSegMode>(page_seg_mode);
+    
+    // Tesseract's own accepted range for a source resolution
+    if (options.dpi != 0 && (options.dpi < 70 || options.dpi > 2400)) {
+        error = "dpi must be between 70 and 2400";
+        return false;
+    }
+    if (options.confidence_threshold < 0.0 || options.confidence_threshold > 100.0) {
+        error = "confidence_threshold must be between 0 and 100";
+        return false;
+    }
+    if (options.char_whitelist.size() > 1024) {
+        error = "char_whitelist is limited to 1024 characters";
+        return false;
+    }
+    return true;
+}
+
+json APIHandler::serializeResult(const OCRResult& result, ResultDetail detail) {
+    json serialized = {
+        {"text", result.text},
+        {"confidence", result.confidence},
+        {"word_count", result.word_count}
+    };
+    if (detail != ResultDetail::Text) {
+        // One pass down the word table; each string is copied once, into the JSON
+        json words = json::array();
+        words.get_ref<json::array_t&>().reserve(result.storedWords());
+        for (size_t i = 0; i < result.storedWords(); i++) {
+            words.push_back(std::string(result.word(i)));
+        }
+        serialized["words"] = std::move(words);
+        serialized["word_confidences"] = result.word_confidences;
+    }
+    if (detail == ResultDetail::WordBoxes || detail == ResultDetail::Layout) {
+        serialized["bounding_boxes"] = serializeBoxes(result.bounding_boxes);
+    }
+    if (detail == ResultDetail::Layout) {
+        serialized["word_line_ids"] = result.word_line_ids;
+        serialized["line_boxes"] = serializeBoxes(result.line_boxes);
+        serialized["line_block_ids"] = result.line_block_ids;
+        serialized["line_paragraph_ids"] = result.line_paragraph_ids;
+    }
+    return serialized;
+}
+
+json APIHandler::serializeTables(const std::vector<ExtractedTable>& tables) {
+    json serialized = json::array();
+    for (const auto& table : tables) {
+        json cells = json::array();
+        for (const auto& cell : table.cells) {
+            json item = {
+                {"row", cell.row},
+                {"column", cell.column},
+                {"text", cell.text},
+                {"box", {cell.box.x, cell.box.y, cell.box.width, cell.box.height}},
+                {"type", cellTypeName(cell.type)}
+            };
+            if (cell.type != CellType::Text) {
+                item["value"] = cell.value;
+            }
+            if (cell.type == CellType::Currency) {
+                item["currency"] = cell.currency;
             }
+            cells.push_back(std::move(item));
         }
+        serialized.push_back({
+            {"page", table.page},
+            {"box", {table.box.x, table.box.y, table.box.width, table.box.height}},
+            {"rows", table.rows},
+            {"columns", table.columns},
+            {"cells", std::move(cells)}
+        });
+    }
+    return serialized;
+}
+
+json APIHandler::serializeBoxes(const std::vector<cv::Rect>& boxes) {
+    json serialized = json::array();
+    for (const auto& box : boxes) {
+        serialized.push_back({box.x, box.y, box.width, box.height});
+    }
+    return serialized;
+}
+
+std::string APIHandler::saveUploadedFile(const crow::multipart::part& part) {
+    // Strip any directory components the client put in the filename
+    const auto& params = part.headers.find("Content-Disposition")->second.params;
+    std::string filename = std::filesystem::path(params.at("filename")).filename().string();
+    
+    // Generate unique filename
+    auto now = std::chrono::system_clock::now();
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count();
+    
+    std::string unique_filename = std::to_string(timestamp) + "_" + filename;
+    std::string file_path = "/tmp/ocr_uploads/" + unique_filename;
+    
+    // Save file
+    std::ofstream file(file_path, std::ios::binary);
+    if (file.is_open()) {
+        file.write(part.body.c_str(), part.body.length());
+        file.close();
+        return file_path;
     }
     
     return "";
-} 
\ No newline at end of file
+}
@@ -1,14 +1,33 @@
 #pragma once
 
+#include <functional>
 #include <crow.h>
 #include <nlohmann/json.hpp>
-#include "ocr_engine.h"
+#include "engine_pool.h"
+#include "work_stealing_scheduler.h"
+#include "result_cache.h"
+#include "page_tiler.h"
+#include "document_pipeline.h"
+#include "job_manager.h"
+#include "metrics.h"
+#include "response_encoding.h"
+#include "raster_source.h"
+#include "frame_allocator.h"
+#include "tracing.h"
 
 using json = nlohmann::json;
 
+// How a result was produced, for the processing metadata in responses
+struct ExecutionInfo {
+    bool cache_hit = false;
+    double queue_time_ms = 0.0;
+};
+
 class APIHandler {
 public:
-    explicit APIHandler(OCREngine& engine);
+    APIHandler(EnginePool& engine_pool, WorkStealingScheduler& scheduler, ResultCache& result_cache,
+               PageTiler& page_tiler, DocumentPipeline& document_pipeline, JobManager& job_manager,
+               RasterSource& raster_source, size_t upload_spill_bytes);
     
     // Request handlers
     crow::response handleExtractRequest(const crow::request& req);
@@ -16,12 +35,135 @@ public:
     crow::response handleDocumentAnalysis(const crow::request& req);
     crow::response handleBatchProcessing(const crow::request& req);
     
+    // Asynchronous jobs: the body of a JSON endpoint plus "type"
+    crow::response handleJobSubmission(const crow::request& req);
+    crow::response handleJobStatus(const std::string& job_id, const crow::request& req);
+    
+    // NDJSON of a streaming job's results from ?cursor= onward, long-polling
+    // up to ?wait_ms= for new lines
+    crow::response handleJobResults(const std::string& job_id, const crow::request& req);
+    
+    // Executes a queued job through the matching synchronous handler
+    JobOutcome runJob(const std::string& type, const json& request_data, const ResultEmitter& emit);
+    
+    // Response body of one result at the given detail level
+    static json serializeResult(const OCRResult& result, ResultDetail detail);
+    static json serializeBoxes(const std::vector<cv::Rect>& boxes);
+    static json serializeTables(const std::vector<ExtractedTable>& tables);
+
+    // A series of ocr_request_duration_seconds, shared with the gRPC server so
+    // both register the family with one HELP text; the registry groups the
+    // series at scrape time, however late the gRPC ones arrive
+    static MetricHistogram& requestHistogram(const std::string& endpoint);
+    
+    // Transport-independent core, shared by the REST routes and the gRPC
+    // service so both go through the same pool, cache and document pipeline
+    
+    // Serve from the result cache, falling back to a pool engine on a miss.
+    // Return nullptr when no engine became available.
+    std::shared_ptr<const OCRResult> extractCached(std::string_view image_data, const OCROptions& options,
+                                                   ExecutionInfo& execution);
+    std::shared_ptr<const DocumentInfo> analyzeCached(std::string_view image_data, const OCROptions& options,
+                                                      ExecutionInfo& execution);
+    
+    // A raster a co-located caller already decoded into shared memory or a
+    // file; cached under its pixels plus geometry, recognized in place
+    std::shared_ptr<const OCRResult> extractRaster(const RasterHandle& raster, const OCROptions& options,
+                                                   ExecutionInfo& execution);
+    std::shared_ptr<const DocumentInfo> analyzeRaster(const RasterHandle& raster, const OCROptions& options,
+                                                      ExecutionInfo& execution);
+    // Maps the {"shm" | "file", "offset", "width", "height", "stride",
+    // "channels"} descriptor of a "raster" field; false with error set
+    bool openRaster(const json& descriptor, RasterHandle& raster, std::string& error);
+    
+    // Analysis of an image or a whole multi-page document, analyzed as one
+    // text. Null with status and error set when the document fails.
+    std::shared_ptr<const DocumentInfo> analyzeData(std::string_view data, const OCROptions& options,
+                                                    DocumentStatus& status, std::string& error,
+                                                    ExecutionInfo& execution);
+    
+    // Multi-page TIFF and PDF: pages are streamed through the pool and each
+    // page is cached under the document hash plus its index. on_page, when
+    // set, sees each page as soon as it is recognized, from pool threads and
+    // in completion order.
+    using PageListener = std::function<void(size_t page_index, const std::shared_ptr<const OCRResult>& page,
+                                            bool cache_hit)>;
+    DocumentStatus extractDocument(std::string_view document_data,
+                                   const OCROptions& options,
+                                   std::vector<std::shared_ptr<const OCRResult>>& pages,
+                                   std::string& error,
+                                   ExecutionInfo& execution,
+                                   const PageListener& on_page = nullptr);
+    static bool isPagedDocument(std::string_view data);
+    
+    // Text joined with form feeds, word-weighted confidence, summed word count
+    static OCRResult combinePages(const std::vector<std::shared_ptr<const OCRResult>>& pages);
+    
+    // Validates options built outside the REST parsers; false with error set
+    bool checkOCROptions(int page_seg_mode, OCROptions& options, std::string& error);
+    
 private:
-    OCREngine& ocr_engine_;
+    EnginePool& engine_pool_;
+    WorkStealingScheduler& scheduler_;
+    ResultCache& result_cache_;
+    PageTiler& page_tiler_;
+    DocumentPipeline& document_pipeline_;
+    JobManager& job_manager_;
+    RasterSource& raster_source_;
+    size_t upload_spill_bytes_;
+    
+    MetricHistogram& extract_latency_;
+    MetricHistogram& text_latency_;
+    MetricHistogram& analyze_latency_;
+    MetricHistogram& batch_latency_;
+    FrameMemoryHistograms extract_memory_;
+    FrameMemoryHistograms text_memory_;
+    FrameMemoryHistograms analyze_memory_;
+    FrameMemoryHistograms batch_memory_;
+    
+    // Batch core shared by /batch and batch jobs; with an emitter, each item
+    // is published as one JSON line when it finishes and not retained
+    crow::response processBatch(const crow::request& req, const json& request_data, const ResultEmitter* emit);
+    std::shared_ptr<const OCRResult> extractBatchItem(const std::string& file_path, const OCROptions& options,
+                                                      std::string& error);
+    static json serializeBatchItem(const OCRResult* result, const std::string& error);
+    
+    std::string cacheConfig(const OCROptions& options) const;
+    std::string rasterCacheConfig(const RasterHandle& raster, const OCROptions& options) const;
+    
+    // Read-only mapping of a file_path; null, logged, when it cannot be mapped
+    static std::shared_ptr<const MappedRegion> mapImageFile(const std::string& file_path);
+    
+    // OCR a decoded page, split into blocks across the pool when it is large
+    // enough. Returns false when no engine became available.
+    bool recognize(const cv::Mat& image, const OCROptions& options, OCRResult& result, ExecutionInfo& execution);
+    
+    // Tenant and class the request's engine checkouts are charged to
+    static TenantContext requestTenant(const crow::request& req, RequestClass default_class);
     
     // Helper methods
     json createErrorResponse(const std::string& error, int status_code = 400);
-    json createSuccessResponse(const json& data);
+    json createSuccessResponse(json&& data);
+    // Success envelope in the format and encoding the request negotiated
+    crow::response createSuccessHttpResponse(const crow::request& req, json&& data, int status_code = 200);
+    crow::response createPoolBusyResponse();
+    crow::response createQueueFullResponse();
+    crow::response createDocumentErrorResponse(DocumentStatus status, const std::string& error);
     bool validateRequest(const json& request_data);
-    std::string saveUploadedFile(const crow::multipart::message& msg);
+    PreprocessingOptions parsePreprocessingOptions(const json& request_data);
+    PreprocessingOptions parsePreprocessingOptions(const crow::query_string& params);
+    DecodeOptions parseDecodeOptions(const json& request_data);
+    ResultDetail parseResultDetail(const json& request_data, ResultDetail default_detail);
+    int parseJobPriority(const json& request_data);
+    TilingMode parseTilingMode(const json& request_data);
+    TilingMode parseTilingMode(const crow::query_string& params);
+    
+    // Build the per-request options once; false with error set when they are
+    // invalid or name a language the pool has no engines for
+    bool parseOCROptions(const json& request_data, ResultDetail default_detail, OCROptions& options,
+                         std::string& error);
+    bool parseOCROptions(const crow::query_string& params, ResultDetail default_detail, OCROptions& options,
+                         std::string& error);
+    const crow::multipart::part* findUploadedFile(const crow::multipart::message& msg);
+    std::string saveUploadedFile(const crow::multipart::part& part);
 }; 
\ No newline at end of file
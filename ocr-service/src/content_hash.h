@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// XXH64 (xxHash, 64-bit variant). Runs at memory bandwidth, which keeps
+// fingerprinting a multi-megabyte scan well below the cost of decoding it.
+uint64_t xxhash64(const void* data, size_t length, uint64_t seed = 0);
+
+inline uint64_t xxhash64(std::string_view data, uint64_t seed = 0) {
+    return xxhash64(data.data(), data.size(), seed);
+}
@@ -0,0 +1,77 @@
+#include "document_pipeline.h"
+#include <deque>
+#include <future>
+
+DocumentPipeline::DocumentPipeline(size_t max_pages_in_flight, size_t max_pages)
+    : max_pages_in_flight_(max_pages_in_flight > 0 ? max_pages_in_flight : 1), max_pages_(max_pages) {
+}
+
+DocumentStatus DocumentPipeline::run(DocumentReader& reader, const PageRecognizer& recognize,
+                                     std::vector<std::shared_ptr<const OCRResult>>& pages,
+                                     std::string& error) const {
+    pages.clear();
+    DocumentStatus status = DocumentStatus::Ok;
+
+    // Page tasks write into their slot by reference; deque appends and
+    // front pops leave the other slots in place. Declared before the futures
+    // so that, should a task throw, the remaining tasks are joined while
+    // their slots still exist.
+    std::deque<std::shared_ptr<const OCRResult>> results;
+    std::deque<std::future<bool>> in_flight;
+
+    auto completeOldest = [&]() {
+        bool recognized = in_flight.front().get();
+        in_flight.pop_front();
+        if (!recognized && status == DocumentStatus::Ok) {
+            status = DocumentStatus::EngineUnavailable;
+            error = "No OCR engine became available for page " + std::to_string(pages.size() + 1);
+        }
+        if (status == DocumentStatus::Ok) {
+            pages.push_back(results.front());
+        }
+        results.pop_front();
+    };
+
+    cv::Mat page;
+    size_t page_index = 0;
+    while (status == DocumentStatus::Ok) {
+        // Wait for the oldest page before decoding another, so at most
+        // max_pages_in_flight decoded frames exist at any time
+        if (in_flight.size() >= max_pages_in_flight_) {
+            completeOldest();
+            continue;
+        }
+
+        // Refuse the page past the limit before paying for its decode
+        if (max_pages_ > 0 && page_index >= max_pages_) {
+            if (reader.hasMorePages()) {
+                status = DocumentStatus::TooManyPages;
+                error = "Document has more than " + std::to_string(max_pages_) + " pages";
+            }
+            break;
+        }
+        if (!reader.nextPage(page)) {
+            if (!reader.error().empty()) {
+                status = DocumentStatus::DecodeFailed;
+                error = reader.error();
+            }
+            break;
+        }
+
+        // One short-lived thread per page in flight; it spends nearly all of
+        // its life inside Tesseract, so the spawn cost is noise
+        results.emplace_back();
+        std::shared_ptr<const OCRResult>& slot = results.back();
+        in_flight.push_back(std::async(std::launch::async,
+            [&recognize, &slot, page_index, image = std::move(page)]() {
+                return recognize(image, page_index, slot);
+            }));
+        page = cv::Mat();
+        page_index++;
+    }
+
+    while (!in_flight.empty()) {
+        completeOldest();
+    }
+    return status;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "document_reader.h"
+#include "ocr_engine.h"
+
+enum class DocumentStatus {
+    Ok,
+    DecodeFailed,
+    TooManyPages,
+    EngineUnavailable
+};
+
+// Recognizes one decoded page into result; returns false when no engine
+// became available
+using PageRecognizer = std::function<bool(const cv::Mat& page, size_t page_index,
+                                          std::shared_ptr<const OCRResult>& result)>;
+
+// Streams a multi-page document through the engine pool. The calling thread
+// decodes page k+1 while earlier pages are being recognized, and decoding
+// pauses whenever max_pages_in_flight pages are waiting on or inside an
+// engine, so memory stays at a few decoded pages whatever the page count.
+class DocumentPipeline {
+public:
+    DocumentPipeline(size_t max_pages_in_flight, size_t max_pages);
+
+    // Pages are returned in document order. On failure, pages holds whatever
+    // was recognized before the first failing page and error describes it.
+    DocumentStatus run(DocumentReader& reader, const PageRecognizer& recognize,
+                       std::vector<std::shared_ptr<const OCRResult>>& pages, std::string& error) const;
+
+private:
+    size_t max_pages_in_flight_;
+    size_t max_pages_;
+};
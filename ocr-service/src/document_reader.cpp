@@ -0,0 +1,204 @@
+#include "document_reader.h"
+#include "metrics.h"
+#include <leptonica/allheaders.h>
+
+#ifdef OCR_WITH_POPPLER
+#include <poppler-document.h>
+#include <poppler-image.h>
+#include <poppler-page.h>
+#include <poppler-page-renderer.h>
+#endif
+
+namespace {
+
+// Leptonica keeps 8 bpp pixels packed big-endian in 32-bit words, so rows are
+// unpacked with GET_DATA_BYTE rather than copied as-is
+cv::Mat pixToGray(PIX* pix) {
+    PIX* gray = pixConvertTo8(pix, 0);
+    if (!gray) {
+        return cv::Mat();
+    }
+
+    int width = pixGetWidth(gray);
+    int height = pixGetHeight(gray);
+    int words_per_line = pixGetWpl(gray);
+    l_uint32* data = pixGetData(gray);
+
+    cv::Mat page(height, width, CV_8UC1);
+    for (int y = 0; y < height; y++) {
+        l_uint32* line = data + static_cast<size_t>(y) * words_per_line;
+        unsigned char* row = page.ptr<unsigned char>(y);
+        for (int x = 0; x < width; x++) {
+            row[x] = static_cast<unsigned char>(GET_DATA_BYTE(line, x));
+        }
+    }
+
+    pixDestroy(&gray);
+    return page;
+}
+
+class SingleImageReader : public DocumentReader {
+public:
+    SingleImageReader(std::string_view buffer, const DecodeOptions& options)
+        : buffer_(buffer), options_(options) {
+    }
+
+    bool nextPage(cv::Mat& page) override {
+        if (done_) {
+            return false;
+        }
+        done_ = true;
+
+        page = decodeImageBuffer(buffer_, options_);
+        if (page.empty()) {
+            error_ = "Failed to decode image of " + std::to_string(buffer_.size()) + " bytes";
+            return false;
+        }
+        return true;
+    }
+
+    bool hasMorePages() const override {
+        return !done_;
+    }
+
+private:
+    std::string_view buffer_;
+    DecodeOptions options_;
+    bool done_ = false;
+};
+
+class TiffReader : public DocumentReader {
+public:
+    explicit TiffReader(std::string_view buffer) : buffer_(buffer) {
+    }
+
+    bool nextPage(cv::Mat& page) override {
+        if (done_) {
+            return false;
+        }
+
+        StageTimer timer(Stage::Decode);
+
+        // Leptonica advances offset_ to the next IFD and resets it to 0 after
+        // the last page
+        PIX* pix = pixReadMemFromMultipageTiff(reinterpret_cast<const l_uint8*>(buffer_.data()),
+                                               buffer_.size(), &offset_);
+        if (offset_ == 0) {
+            done_ = true;
+        }
+        if (!pix) {
+            done_ = true;
+            error_ = "Failed to decode TIFF page " + std::to_string(pages_read_ + 1);
+            return false;
+        }
+
+        page = pixToGray(pix);
+        pixDestroy(&pix);
+        if (page.empty()) {
+            done_ = true;
+            error_ = "Failed to convert TIFF page " + std::to_string(pages_read_ + 1) + " to grayscale";
+            return false;
+        }
+
+        pages_read_++;
+        return true;
+    }
+
+    bool hasMorePages() const override {
+        // Leptonica has already moved offset_ past the last IFD
+        return !done_;
+    }
+
+private:
+    std::string_view buffer_;
+    size_t offset_ = 0;
+    size_t pages_read_ = 0;
+    bool done_ = false;
+};
+
+#ifdef OCR_WITH_POPPLER
+class PdfReader : public DocumentReader {
+public:
+    PdfReader(std::string_view buffer, int dpi) : dpi_(dpi > 0 ? dpi : 300) {
+        // poppler reads from the caller's bytes without copying them
+        document_.reset(poppler::document::load_from_raw_data(buffer.data(), static_cast<int>(buffer.size())));
+        if (!document_ || document_->is_locked()) {
+            error_ = "Failed to open PDF document";
+            document_.reset();
+        }
+
+        renderer_.set_image_format(poppler::image::format_gray8);
+        renderer_.set_render_hint(poppler::page_renderer::antialiasing, true);
+        renderer_.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+    }
+
+    bool nextPage(cv::Mat& page) override {
+        if (!document_ || next_page_ >= document_->pages()) {
+            return false;
+        }
+
+        StageTimer timer(Stage::Decode);
+
+        int index = next_page_++;
+        std::unique_ptr<poppler::page> pdf_page(document_->create_page(index));
+        if (!pdf_page) {
+            error_ = "Failed to load PDF page " + std::to_string(index + 1);
+            return false;
+        }
+
+        poppler::image image = renderer_.render_page(pdf_page.get(), dpi_, dpi_);
+        if (!image.is_valid()) {
+            error_ = "Failed to render PDF page " + std::to_string(index + 1);
+            return false;
+        }
+
+        cv::Mat view(image.height(), image.width(), CV_8UC1, image.data(), image.bytes_per_row());
+        view.copyTo(page);
+        return true;
+    }
+
+    bool hasMorePages() const override {
+        return document_ && next_page_ < document_->pages();
+    }
+
+private:
+    std::unique_ptr<poppler::document> document_;
+    poppler::page_renderer renderer_;
+    int dpi_;
+    int next_page_ = 0;
+};
+#endif
+
+class UnsupportedReader : public DocumentReader {
+public:
+    explicit UnsupportedReader(std::string message) {
+        error_ = std::move(message);
+    }
+
+    bool nextPage(cv::Mat&) override {
+        return false;
+    }
+
+    bool hasMorePages() const override {
+        return false;
+    }
+};
+
+}
+
+std::unique_ptr<DocumentReader> DocumentReader::open(std::string_view buffer, const DecodeOptions& options) {
+    ImageFormat format = detectImageFormat(reinterpret_cast<const unsigned char*>(buffer.data()), buffer.size());
+
+    switch (format) {
+        case ImageFormat::TIFF:
+            return std::make_unique<TiffReader>(buffer);
+        case ImageFormat::PDF:
+#ifdef OCR_WITH_POPPLER
+            return std::make_unique<PdfReader>(buffer, options.target_dpi);
+#else
+            return std::make_unique<UnsupportedReader>("PDF input requires a build with poppler-cpp");
+#endif
+        default:
+            return std::make_unique<SingleImageReader>(buffer, options);
+    }
+}
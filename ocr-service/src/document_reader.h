@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <opencv2/opencv.hpp>
+#include "image_decoder.h"
+
+// Sequential page source over an encoded document held in memory. Pages are
+// decoded one at a time on demand, so a reader never holds more than the
+// page it is producing regardless of document length. The encoded buffer
+// must outlive the reader.
+class DocumentReader {
+public:
+    virtual ~DocumentReader() = default;
+
+    // Decodes the next page to 8-bit grayscale. Returns false once the
+    // document is exhausted or a page failed to decode; error() tells which.
+    virtual bool nextPage(cv::Mat& page) = 0;
+    // Whether nextPage has another page to try, without decoding it
+    virtual bool hasMorePages() const = 0;
+
+    const std::string& error() const { return error_; }
+
+    // Multi-page TIFF goes through Leptonica; PDF is rasterized at
+    // options.target_dpi when the service is built with poppler-cpp.
+    // Any other format yields a single page via decodeImageBuffer.
+    static std::unique_ptr<DocumentReader> open(std::string_view buffer, const DecodeOptions& options);
+
+    // Formats that may hold more than one page
+    static bool isPaged(ImageFormat format) { return format == ImageFormat::TIFF || format == ImageFormat::PDF; }
+
+protected:
+    std::string error_;
+};
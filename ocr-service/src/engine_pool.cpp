@@ -0,0 +1,376 @@
+#include "engine_pool.h"
+#include "tracing.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+EnginePool::Lease::Lease(EnginePool* pool, SubPool* sub_pool, OCREngine* engine, double wait_ms,
+                         const TenantScheduler::Ticket& ticket)
+    : pool_(pool), sub_pool_(sub_pool), engine_(engine), wait_ms_(wait_ms), ticket_(ticket) {
+}
+
+EnginePool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), sub_pool_(other.sub_pool_), engine_(other.engine_), wait_ms_(other.wait_ms_),
+      ticket_(other.ticket_) {
+    other.pool_ = nullptr;
+    other.sub_pool_ = nullptr;
+    other.engine_ = nullptr;
+}
+
+EnginePool::Lease& EnginePool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        sub_pool_ = other.sub_pool_;
+        engine_ = other.engine_;
+        wait_ms_ = other.wait_ms_;
+        ticket_ = other.ticket_;
+        other.pool_ = nullptr;
+        other.sub_pool_ = nullptr;
+        other.engine_ = nullptr;
+    }
+    return *this;
+}
+
+EnginePool::Lease::~Lease() {
+    release();
+}
+
+void EnginePool::Lease::release() {
+    if (pool_ && engine_) {
+        pool_->release(sub_pool_, engine_, ticket_);
+    }
+    pool_ = nullptr;
+    sub_pool_ = nullptr;
+    engine_ = nullptr;
+}
+
+EnginePool::EnginePool(std::vector<LanguageSpec> languages, size_t max_waiters,
+                       std::chrono::milliseconds wait_timeout,
+                       std::shared_ptr<const FieldExtractor> field_extractor, TenantSchedulerConfig tenants)
+    : size_(0), max_waiters_(max_waiters), wait_timeout_(wait_timeout),
+      field_extractor_(std::move(field_extractor)), ready_(false),
+      waiting_(0), total_checkouts_(0), rejected_checkouts_(0), total_wait_ms_(0.0), max_wait_ms_(0.0),
+      tenants_(std::move(tenants)) {
+    for (RequestClass request_class : {RequestClass::Interactive, RequestClass::Bulk}) {
+        class_wait_[static_cast<size_t>(request_class)] = &MetricsRegistry::global().histogram(
+            "ocr_engine_wait_seconds", "Time a checkout waited for an OCR engine",
+            std::string("class=\"") + requestClassName(request_class) + "\"");
+    }
+    if (languages.empty()) {
+        languages.push_back({"eng", 0});
+    }
+    for (const auto& spec : languages) {
+        auto sub_pool = std::make_unique<SubPool>();
+        sub_pool->language = spec.language;
+        sub_pool->target_size = spec.engines > 0 ? spec.engines : defaultSize();
+
+        // Known up front so cache keys never depend on engines that are
+        // still being initialized
+        sub_pool->config_key = OCREngine::configKey(spec.language, *fieldExtractor());
+
+        size_ += sub_pool->target_size;
+        sub_pools_.push_back(std::move(sub_pool));
+    }
+}
+
+EnginePool::~EnginePool() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sub_pools_.clear();
+}
+
+size_t EnginePool::defaultSize() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+std::vector<LanguageSpec> EnginePool::parseLanguages(const std::string& spec, size_t default_engines) {
+    std::vector<LanguageSpec> languages;
+    std::stringstream stream(spec);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), ::isspace), entry.end());
+        if (entry.empty()) {
+            continue;
+        }
+
+        LanguageSpec language{entry, default_engines};
+        size_t colon = entry.find(':');
+        if (colon != std::string::npos) {
+            language.language = entry.substr(0, colon);
+            try {
+                language.engines = std::stoul(entry.substr(colon + 1));
+            } catch (const std::exception&) {
+                std::cerr << "Ignoring invalid engine count in " << entry << std::endl;
+            }
+        }
+        if (!language.language.empty()) {
+            languages.push_back(std::move(language));
+        }
+    }
+    return languages;
+}
+
+namespace {
+
+std::string tessdataDir() {
+    const char* override_dir = std::getenv("OCR_TESSDATA_DIR");
+    if (override_dir && *override_dir) {
+        return override_dir;
+    }
+    const char* prefix = std::getenv("TESSDATA_PREFIX");
+    if (prefix && *prefix) {
+        return prefix;
+    }
+    return "/usr/share/tesseract-ocr/4.00/tessdata";
+}
+
+// Read once per language and shared read-only by all of its engines.
+// Combined languages ("eng+deu") span several files and are left to
+// Tesseract's own loader.
+std::shared_ptr<const std::string> loadTraineddata(const std::string& language) {
+    if (language.find('+') != std::string::npos) {
+        return nullptr;
+    }
+
+    std::string path = tessdataDir() + "/" + language + ".traineddata";
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not read " << path << ", falling back to Tesseract's search path" << std::endl;
+        return nullptr;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return std::make_shared<const std::string>(contents.str());
+}
+
+}
+
+bool EnginePool::initialize() {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::shared_ptr<const std::string>> models;
+    for (const auto& sub_pool : sub_pools_) {
+        models.push_back(loadTraineddata(sub_pool->language));
+    }
+
+    // With the models in memory nothing touches the disk any more, so engines
+    // are initialized and warmed up in parallel, one thread per core
+    struct Slot {
+        size_t sub_pool;
+        std::unique_ptr<OCREngine> engine;
+    };
+    std::vector<Slot> slots;
+    for (size_t p = 0; p < sub_pools_.size(); p++) {
+        for (size_t i = 0; i < sub_pools_[p]->target_size; i++) {
+            slots.push_back({p, nullptr});
+        }
+    }
+
+    std::atomic<size_t> next_slot{0};
+    std::atomic<bool> failed{false};
+    auto bringUp = [&]() {
+        size_t i;
+        while (!failed.load() && (i = next_slot.fetch_add(1)) < slots.size()) {
+            const std::string& language = sub_pools_[slots[i].sub_pool]->language;
+            auto engine = std::make_unique<OCREngine>();
+            if (field_extractor_) {
+                engine->setFieldExtractor(field_extractor_);
+            }
+            engine->setTemplateRegistry(template_registry_);
+            if (!engine->initialize(language, models[slots[i].sub_pool]) || !engine->warmUp()) {
+                std::cerr << "Failed to initialize OCR engine for language " << language << std::endl;
+                failed = true;
+                return;
+            }
+            slots[i].engine = std::move(engine);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    size_t thread_count = std::min(slots.size(), defaultSize());
+    for (size_t t = 1; t < thread_count; t++) {
+        threads.emplace_back(bringUp);
+    }
+    bringUp();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& slot : slots) {
+            SubPool& sub_pool = *sub_pools_[slot.sub_pool];
+            sub_pool.available.push_back(slot.engine.get());
+            sub_pool.engines.push_back(std::move(slot.engine));
+        }
+    }
+    ready_.store(true, std::memory_order_release);
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "OCR engine pool initialized with " << size_ << " engines (";
+    for (size_t p = 0; p < sub_pools_.size(); p++) {
+        std::cout << (p > 0 ? ", " : "") << sub_pools_[p]->language << ": " << sub_pools_[p]->target_size;
+    }
+    std::cout << ") in " << static_cast<long>(elapsed_ms) << " ms" << std::endl;
+    return true;
+}
+
+EnginePool::SubPool* EnginePool::findSubPool(const std::string& language) const {
+    if (language.empty()) {
+        return sub_pools_.front().get();
+    }
+    for (const auto& sub_pool : sub_pools_) {
+        if (sub_pool->language == language) {
+            return sub_pool.get();
+        }
+    }
+    return nullptr;
+}
+
+bool EnginePool::hasLanguage(const std::string& language) const {
+    return findSubPool(language) != nullptr;
+}
+
+const std::string& EnginePool::configKey(const std::string& language) const {
+    SubPool* sub_pool = findSubPool(language);
+    return (sub_pool ? sub_pool : sub_pools_.front().get())->config_key;
+}
+
+EnginePool::Lease EnginePool::acquire(const std::string& language, uint64_t pixels) {
+    TraceSpan span("engine.wait");
+    auto start = std::chrono::steady_clock::now();
+    SubPool* sub_pool = findSubPool(language);
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (!sub_pool || !ready()) {
+        rejected_checkouts_++;
+        return Lease();
+    }
+
+    Waiter waiter;
+    if (!tenants_.admit(TenantScope::current(), pixels, waiter)) {
+        rejected_checkouts_++;
+        return Lease();
+    }
+
+    // Free engines only outlast the queue while every waiter's tenant is at
+    // its cap, so taking one here never jumps ahead of an eligible waiter
+    if (!sub_pool->available.empty() && tenants_.eligible(waiter)) {
+        OCREngine* engine = sub_pool->available.back();
+        sub_pool->available.pop_back();
+        tenants_.start(waiter);
+        return leaseLocked(sub_pool, engine, waiter, start);
+    }
+
+    if (waiting_ >= max_waiters_) {
+        tenants_.cancel(waiter);
+        rejected_checkouts_++;
+        return Lease();
+    }
+
+    waiting_++;
+    sub_pool->waiters.push_back(&waiter);
+    waiter.granted.wait_for(lock, wait_timeout_, [&waiter]() { return waiter.engine != nullptr; });
+    waiting_--;
+
+    if (!waiter.engine) {
+        auto& waiters = sub_pool->waiters;
+        waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+        tenants_.cancel(waiter);
+        rejected_checkouts_++;
+        return Lease();
+    }
+    return leaseLocked(sub_pool, waiter.engine, waiter, start);
+}
+
+EnginePool::Lease EnginePool::tryAcquire(const std::string& language, uint64_t pixels) {
+    auto start = std::chrono::steady_clock::now();
+    SubPool* sub_pool = findSubPool(language);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!sub_pool || sub_pool->available.empty()) {
+        return Lease();
+    }
+
+    TenantScheduler::Ticket ticket;
+    if (!tenants_.admit(TenantScope::current(), pixels, ticket)) {
+        return Lease();
+    }
+    if (!tenants_.eligible(ticket)) {
+        tenants_.cancel(ticket);
+        return Lease();
+    }
+    OCREngine* engine = sub_pool->available.back();
+    sub_pool->available.pop_back();
+    tenants_.start(ticket);
+    return leaseLocked(sub_pool, engine, ticket, start);
+}
+
+EnginePool::Lease EnginePool::leaseLocked(SubPool* sub_pool, OCREngine* engine,
+                                          const TenantScheduler::Ticket& ticket,
+                                          std::chrono::steady_clock::time_point start) {
+    double wait_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    total_checkouts_++;
+    total_wait_ms_ += wait_ms;
+    max_wait_ms_ = std::max(max_wait_ms_, wait_ms);
+    class_wait_[static_cast<size_t>(ticket.request_class)]->observe(wait_ms / 1000.0);
+
+    // The lease keeps only the scheduling fields, not the waiter
+    return Lease(this, sub_pool, engine, wait_ms, ticket);
+}
+
+void EnginePool::release(SubPool* sub_pool, OCREngine* engine, const TenantScheduler::Ticket& ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sub_pool->available.push_back(engine);
+    tenants_.finish(ticket);
+    dispatchLocked();
+}
+
+void EnginePool::dispatchLocked() {
+    for (auto& sub_pool : sub_pools_) {
+        while (!sub_pool->available.empty() && !sub_pool->waiters.empty()) {
+            size_t next = tenants_.pick(sub_pool->waiters);
+            if (next == TenantScheduler::npos) {
+                break;
+            }
+            auto* waiter = static_cast<Waiter*>(sub_pool->waiters[next]);
+            sub_pool->waiters.erase(sub_pool->waiters.begin() + next);
+            waiter->engine = sub_pool->available.back();
+            sub_pool->available.pop_back();
+            tenants_.start(*waiter);
+            waiter->granted.notify_one();
+        }
+    }
+}
+
+EnginePoolStats EnginePool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    EnginePoolStats stats;
+    stats.ready = ready();
+    stats.size = 0;
+    stats.available = 0;
+    for (const auto& sub_pool : sub_pools_) {
+        stats.size += sub_pool->engines.size();
+        stats.available += sub_pool->available.size();
+        stats.languages.push_back({sub_pool->language, sub_pool->engines.size(), sub_pool->available.size()});
+    }
+    stats.in_use = stats.size - stats.available;
+    stats.waiting = waiting_;
+    stats.max_waiters = max_waiters_;
+    stats.total_checkouts = total_checkouts_;
+    stats.rejected_checkouts = rejected_checkouts_;
+    stats.average_wait_ms = total_checkouts_ > 0 ? total_wait_ms_ / total_checkouts_ : 0.0;
+    stats.max_wait_ms = max_wait_ms_;
+    stats.tenants = tenants_.getStats();
+    return stats;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ocr_engine.h"
+#include "tenant_scheduler.h"
+
+// A language the pool keeps warm engines for, e.g. "deu" or "eng+fra"
+struct LanguageSpec {
+    std::string language;
+    size_t engines;
+};
+
+struct LanguagePoolStats {
+    std::string language;
+    size_t size;
+    size_t available;
+};
+
+struct EnginePoolStats {
+    bool ready;
+    size_t size;
+    size_t available;
+    size_t in_use;
+    size_t waiting;
+    size_t max_waiters;
+    uint64_t total_checkouts;
+    uint64_t rejected_checkouts;
+    double average_wait_ms;
+    double max_wait_ms;
+    std::vector<LanguagePoolStats> languages;
+    TenantSchedulerStats tenants;
+};
+
+// Fixed set of pre-initialized OCR engines. Each TessBaseAPI is single-threaded,
+// so a request checks one engine out for its whole duration and hands it back
+// when the lease goes out of scope. Engines are grouped into one sub-pool per
+// configured language, so choosing a language is a checkout from the right
+// sub-pool and never reinitializes Tesseract. When every engine is busy,
+// waiters are not woken in arbitrary order: a returned engine is handed
+// straight to the checkout the TenantScheduler picks, by request class and
+// fair share of the tenant in the caller's TenantScope.
+class EnginePool {
+    struct SubPool;
+
+public:
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        OCREngine* operator->() const { return engine_; }
+        OCREngine& operator*() const { return *engine_; }
+        explicit operator bool() const { return engine_ != nullptr; }
+
+        double waitTimeMs() const { return wait_ms_; }
+
+    private:
+        friend class EnginePool;
+        Lease(EnginePool* pool, SubPool* sub_pool, OCREngine* engine, double wait_ms,
+              const TenantScheduler::Ticket& ticket);
+        void release();
+
+        EnginePool* pool_ = nullptr;
+        SubPool* sub_pool_ = nullptr;
+        OCREngine* engine_ = nullptr;
+        double wait_ms_ = 0.0;
+        TenantScheduler::Ticket ticket_;
+    };
+
+    // The first language is the default for requests that don't name one
+    EnginePool(std::vector<LanguageSpec> languages, size_t max_waiters, std::chrono::milliseconds wait_timeout,
+               std::shared_ptr<const FieldExtractor> field_extractor,
+               TenantSchedulerConfig tenants = TenantSchedulerConfig{});
+    ~EnginePool();
+
+    // Loads each language's traineddata once, brings up and warms every
+    // engine, then marks the pool ready. Checkouts fail until then.
+    bool initialize();
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    // Blocks until an engine for language (empty for the default) is free.
+    // Returns an empty lease when the wait queue is already full, the wait
+    // timeout expires, the pool is still warming up, or the current tenant
+    // is over its pixel budget. pixels is what the checkout will recognize,
+    // 0 when unknown.
+    Lease acquire(const std::string& language = std::string(), uint64_t pixels = 0);
+    Lease tryAcquire(const std::string& language = std::string(), uint64_t pixels = 0);
+
+    bool hasLanguage(const std::string& language) const;
+    const std::string& defaultLanguage() const { return sub_pools_.front()->language; }
+
+    // Total engines across all languages
+    size_t size() const { return size_; }
+    const std::string& configKey(const std::string& language = std::string()) const;
+    std::shared_ptr<const FieldExtractor> fieldExtractor() const {
+        return field_extractor_ ? field_extractor_ : FieldExtractor::builtin();
+    }
+    // Handed to every engine; set before initialize()
+    void setTemplateRegistry(std::shared_ptr<TemplateRegistry> template_registry) {
+        template_registry_ = std::move(template_registry);
+    }
+    EnginePoolStats getStats() const;
+
+    static size_t defaultSize();
+
+    // Parses "eng,deu:2,fra" into languages with engine counts; a language
+    // without a count gets default_engines (0 selects one per hardware thread)
+    static std::vector<LanguageSpec> parseLanguages(const std::string& spec, size_t default_engines);
+
+private:
+    // A blocked acquire(); the releasing thread hands it an engine directly
+    struct Waiter : TenantScheduler::Ticket {
+        OCREngine* engine = nullptr;
+        std::condition_variable granted;
+    };
+
+    struct SubPool {
+        std::string language;
+        size_t target_size = 0;
+        std::string config_key;
+        std::vector<std::unique_ptr<OCREngine>> engines;
+        std::vector<OCREngine*> available;
+        std::vector<TenantScheduler::Ticket*> waiters;  // Waiters, in arrival order
+    };
+
+    // Unknown languages resolve to nullptr; the empty string to the default
+    SubPool* findSubPool(const std::string& language) const;
+    void release(SubPool* sub_pool, OCREngine* engine, const TenantScheduler::Ticket& ticket);
+    // Hands free engines to the waiters the scheduler picks, in every
+    // sub-pool: a returned engine may also lift a tenant's cap elsewhere
+    void dispatchLocked();
+    Lease leaseLocked(SubPool* sub_pool, OCREngine* engine, const TenantScheduler::Ticket& ticket,
+                      std::chrono::steady_clock::time_point start);
+
+    size_t size_;
+    size_t max_waiters_;
+    std::chrono::milliseconds wait_timeout_;
+    std::shared_ptr<const FieldExtractor> field_extractor_;
+    std::shared_ptr<TemplateRegistry> template_registry_;
+
+    // Fixed at construction; only the engines inside are filled in later
+    std::vector<std::unique_ptr<SubPool>> sub_pools_;
+    std::atomic<bool> ready_;
+
+    mutable std::mutex mutex_;
+    size_t waiting_;
+    uint64_t total_checkouts_;
+    uint64_t rejected_checkouts_;
+    double total_wait_ms_;
+    double max_wait_ms_;
+    TenantScheduler tenants_;
+    // ocr_engine_wait_seconds, per RequestClass
+    std::array<MetricHistogram*, 2> class_wait_;
+};
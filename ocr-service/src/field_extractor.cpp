@@ -0,0 +1,262 @@
+#include "field_extractor.h"
+#include "ocr_engine.h"
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+inline unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+// Same character class as \s in the ECMAScript regex grammar for ASCII input
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string lowercase(const std::string& text) {
+    std::string result(text);
+    for (auto& c : result) {
+        c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+    }
+    return result;
+}
+
+}
+
+FieldExtractorConfig FieldExtractorConfig::defaults() {
+    FieldExtractorConfig config;
+    config.document_types = {
+        {"invoice", {"invoice", "bill"}},
+        {"receipt", {"receipt"}},
+        {"contract", {"contract", "agreement"}},
+        {"financial_report", {"financial", "report"}}
+    };
+    for (const char* name : {"date", "amount", "total", "name", "address", "phone", "email"}) {
+        config.fields.push_back({name, {name}});
+    }
+    return config;
+}
+
+bool FieldExtractorConfig::loadFromFile(const std::string& path, FieldExtractorConfig& config) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    try {
+        json data = json::parse(file);
+        FieldExtractorConfig loaded;
+
+        for (const auto& entry : data.at("document_types")) {
+            DocumentTypeRule rule;
+            rule.type = entry.at("type").get<std::string>();
+            rule.keywords = entry.at("keywords").get<std::vector<std::string>>();
+            loaded.document_types.push_back(std::move(rule));
+        }
+
+        for (const auto& entry : data.at("fields")) {
+            FieldRule rule;
+            if (entry.is_string()) {
+                rule.name = entry.get<std::string>();
+            } else {
+                rule.name = entry.at("name").get<std::string>();
+                rule.labels = entry.value("labels", std::vector<std::string>{});
+            }
+            if (rule.labels.empty()) {
+                rule.labels.push_back(rule.name);
+            }
+            loaded.fields.push_back(std::move(rule));
+        }
+
+        config = std::move(loaded);
+        return true;
+
+    } catch (const json::exception& e) {
+        std::cerr << "Invalid field extractor config " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+FieldExtractor::FieldExtractor(FieldExtractorConfig config) : config_(std::move(config)) {
+    json fingerprint = json::object();
+    fingerprint["document_types"] = json::array();
+    for (uint32_t i = 0; i < config_.document_types.size(); i++) {
+        const auto& rule = config_.document_types[i];
+        fingerprint["document_types"].push_back({{"type", rule.type}, {"keywords", rule.keywords}});
+        for (const auto& keyword : rule.keywords) {
+            addPattern(keyword, PatternKind::TypeKeyword, i);
+        }
+    }
+    fingerprint["fields"] = json::array();
+    for (uint32_t i = 0; i < config_.fields.size(); i++) {
+        const auto& rule = config_.fields[i];
+        fingerprint["fields"].push_back({{"name", rule.name}, {"labels", rule.labels}});
+        for (const auto& label : rule.labels) {
+            addPattern(label, PatternKind::FieldLabel, i);
+        }
+    }
+    fingerprint_ = fingerprint.dump();
+
+    buildAutomaton();
+}
+
+std::shared_ptr<const FieldExtractor> FieldExtractor::builtin() {
+    static const auto instance = std::make_shared<const FieldExtractor>(FieldExtractorConfig::defaults());
+    return instance;
+}
+
+void FieldExtractor::addPattern(const std::string& text, PatternKind kind, uint32_t rule) {
+    if (text.empty()) {
+        return;
+    }
+
+    if (transitions_.empty()) {
+        transitions_.emplace_back();
+        transitions_.back().fill(-1);
+        outputs_.emplace_back();
+    }
+
+    int32_t state = 0;
+    for (char c : lowercase(text)) {
+        auto symbol = static_cast<unsigned char>(c);
+        if (transitions_[state][symbol] < 0) {
+            transitions_[state][symbol] = static_cast<int32_t>(transitions_.size());
+            transitions_.emplace_back();
+            transitions_.back().fill(-1);
+            outputs_.emplace_back();
+        }
+        state = transitions_[state][symbol];
+    }
+
+    outputs_[state].push_back(static_cast<uint32_t>(patterns_.size()));
+    patterns_.push_back({kind, rule});
+}
+
+void FieldExtractor::buildAutomaton() {
+    if (transitions_.empty()) {
+        transitions_.emplace_back();
+        transitions_.back().fill(0);
+        outputs_.emplace_back();
+        failure_.assign(1, 0);
+        return;
+    }
+
+    // Breadth-first over the trie: fill missing edges from the failure state so
+    // the scan is a pure DFA walk, and merge suffix outputs into each state
+    failure_.assign(transitions_.size(), 0);
+    std::queue<int32_t> pending;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int32_t next = transitions_[0][symbol];
+        if (next < 0) {
+            transitions_[0][symbol] = 0;
+        } else {
+            failure_[next] = 0;
+            pending.push(next);
+        }
+    }
+
+    while (!pending.empty()) {
+        int32_t state = pending.front();
+        pending.pop();
+
+        const auto& inherited = outputs_[failure_[state]];
+        outputs_[state].insert(outputs_[state].end(), inherited.begin(), inherited.end());
+
+        for (int symbol = 0; symbol < 256; symbol++) {
+            int32_t next = transitions_[state][symbol];
+            if (next < 0) {
+                transitions_[state][symbol] = transitions_[failure_[state]][symbol];
+            } else {
+                failure_[next] = transitions_[failure_[state]][symbol];
+                pending.push(next);
+            }
+        }
+    }
+}
+
+bool FieldExtractor::parseValue(std::string_view text, size_t label_end, std::string_view& value) const {
+    // Equivalent of the former  label\s*[:=]\s*([^\n]+)
+    size_t pos = label_end;
+    while (pos < text.size() && isSpace(text[pos])) {
+        pos++;
+    }
+    if (pos >= text.size() || (text[pos] != ':' && text[pos] != '=')) {
+        return false;
+    }
+    size_t separator = pos++;
+    while (pos < text.size() && isSpace(text[pos])) {
+        pos++;
+    }
+
+    // Only whitespace up to the end of the text: the regex backtracked and
+    // captured the last non-newline whitespace character, so do the same
+    if (pos == text.size()) {
+        for (size_t back = text.size(); back-- > separator + 1;) {
+            if (text[back] != '\n') {
+                value = text.substr(back, 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t start = pos;
+    while (pos < text.size() && text[pos] != '\n') {
+        pos++;
+    }
+    if (pos == start) {
+        return false;
+    }
+
+    value = text.substr(start, pos - start);
+    return true;
+}
+
+void FieldExtractor::analyze(std::string_view text, DocumentInfo& info) const {
+    analyze(text, info, nullptr);
+}
+
+void FieldExtractor::analyze(std::string_view text, DocumentInfo& info, std::vector<FieldLocation>* locations) const {
+    std::vector<char> type_seen(config_.document_types.size(), 0);
+    std::vector<std::string_view> values(config_.fields.size());
+    std::vector<char> field_found(config_.fields.size(), 0);
+
+    int32_t state = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        state = transitions_[state][foldCase(static_cast<unsigned char>(text[i]))];
+
+        for (uint32_t id : outputs_[state]) {
+            const Pattern& pattern = patterns_[id];
+            if (pattern.kind == PatternKind::TypeKeyword) {
+                type_seen[pattern.rule] = 1;
+            } else if (!field_found[pattern.rule] && parseValue(text, i + 1, values[pattern.rule])) {
+                // The first occurrence that parses wins, as regex_search did
+                field_found[pattern.rule] = 1;
+            }
+        }
+    }
+
+    info.document_type = "unknown";
+    for (size_t i = 0; i < config_.document_types.size(); i++) {
+        if (type_seen[i]) {
+            info.document_type = config_.document_types[i].type;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < config_.fields.size(); i++) {
+        if (field_found[i]) {
+            const std::string& name = config_.fields[i].name;
+            info.extracted_data[name] = std::string(values[i]);
+            info.detected_fields.push_back(name);
+            if (locations) {
+                locations->push_back({name, static_cast<size_t>(values[i].data() - text.data()), values[i].size()});
+            }
+        }
+    }
+}
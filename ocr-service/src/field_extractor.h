@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct DocumentInfo;
+
+struct DocumentTypeRule {
+    std::string type;
+    std::vector<std::string> keywords;
+};
+
+struct FieldRule {
+    std::string name;
+    std::vector<std::string> labels;  // defaults to {name}
+};
+
+// Where a captured value sits in the analyzed text
+struct FieldLocation {
+    std::string name;
+    size_t offset;
+    size_t length;
+};
+
+struct FieldExtractorConfig {
+    // Earlier document types win when keywords of several types occur
+    std::vector<DocumentTypeRule> document_types;
+    std::vector<FieldRule> fields;
+
+    static FieldExtractorConfig defaults();
+
+    // JSON file of the form
+    //   {"document_types": [{"type": "invoice", "keywords": ["invoice", "bill"]}, ...],
+    //    "fields": ["date", {"name": "total", "labels": ["total", "amount due"]}, ...]}
+    static bool loadFromFile(const std::string& path, FieldExtractorConfig& config);
+};
+
+// Document type detection and "label: value" field capture in a single pass
+// over the OCR text. All keywords and field labels are compiled once into an
+// ASCII case-insensitive Aho-Corasick automaton, so analysis costs one table
+// lookup per input byte regardless of how many rules are configured. Immutable
+// after construction and shared by every engine in the pool.
+class FieldExtractor {
+public:
+    explicit FieldExtractor(FieldExtractorConfig config);
+
+    // Fills document_type, detected_fields and extracted_data, and when
+    // locations is given, where in text each extracted value was found
+    void analyze(std::string_view text, DocumentInfo& info) const;
+    void analyze(std::string_view text, DocumentInfo& info, std::vector<FieldLocation>* locations) const;
+
+    // Stable identifier of the loaded rules, folded into result cache keys
+    const std::string& fingerprint() const { return fingerprint_; }
+
+    static std::shared_ptr<const FieldExtractor> builtin();
+
+private:
+    enum class PatternKind : uint8_t {
+        TypeKeyword,
+        FieldLabel
+    };
+
+    struct Pattern {
+        PatternKind kind;
+        uint32_t rule;
+    };
+
+    void addPattern(const std::string& text, PatternKind kind, uint32_t rule);
+    void buildAutomaton();
+    bool parseValue(std::string_view text, size_t label_end, std::string_view& value) const;
+
+    FieldExtractorConfig config_;
+    std::string fingerprint_;
+
+    std::vector<Pattern> patterns_;
+    std::vector<std::array<int32_t, 256>> transitions_;
+    std::vector<int32_t> failure_;
+    std::vector<std::vector<uint32_t>> outputs_;  // pattern ids ending at each state
+};
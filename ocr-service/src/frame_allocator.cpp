@@ -0,0 +1,186 @@
+#include "frame_allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<const FrameAllocator*> g_allocator{nullptr};
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_pool_hits{0};
+std::atomic<int64_t> g_live_bytes{0};
+std::atomic<int64_t> g_cached_bytes{0};
+
+// Blocks parked by this thread, as (size class, pointer)
+struct ThreadCache {
+    std::vector<std::pair<size_t, void*>> blocks;
+    size_t bytes = 0;
+    ~ThreadCache();
+};
+
+thread_local ThreadCache t_cache;
+// Set once t_cache is destroyed: Mats held by other thread_locals may still
+// be freed after it during thread exit
+thread_local bool t_cache_gone = false;
+thread_local int64_t t_live_bytes = 0;
+thread_local FrameMemoryScope* t_frame_scope = nullptr;
+
+ThreadCache::~ThreadCache() {
+    for (auto& block : blocks) {
+        cv::fastFree(block.second);
+    }
+    g_cached_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    blocks.clear();
+    bytes = 0;
+    t_cache_gone = true;
+}
+
+// Rounds up to a quarter of the power of two below, so a reused block wastes
+// at most a fifth of itself and near-equal page sizes share a class
+size_t sizeClass(size_t bytes) {
+    size_t power = size_t(1) << (63 - __builtin_clzll(static_cast<unsigned long long>(bytes)));
+    size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+}
+
+void FrameAllocator::install(size_t max_cached_per_thread, size_t max_cached_total) {
+    if (g_allocator.load()) {
+        return;
+    }
+    // Never destroyed: Mats allocated through it may outlive main
+    auto* allocator = new FrameAllocator(max_cached_per_thread, max_cached_total);
+    cv::Mat::setDefaultAllocator(allocator);
+    g_allocator.store(allocator);
+}
+
+bool FrameAllocator::installed() {
+    return g_allocator.load(std::memory_order_relaxed) != nullptr;
+}
+
+FrameAllocatorStats FrameAllocator::stats() {
+    FrameAllocatorStats stats;
+    stats.allocations = g_allocations.load(std::memory_order_relaxed);
+    stats.pool_hits = g_pool_hits.load(std::memory_order_relaxed);
+    stats.live_bytes = static_cast<size_t>(std::max<int64_t>(0, g_live_bytes.load(std::memory_order_relaxed)));
+    stats.cached_bytes = static_cast<size_t>(std::max<int64_t>(0, g_cached_bytes.load(std::memory_order_relaxed)));
+    return stats;
+}
+
+cv::UMatData* FrameAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                       cv::AccessFlag, cv::UMatUsageFlags) const {
+    // Same layout rules as OpenCV's own allocator
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    cv::UMatData* u = new cv::UMatData(this);
+    u->size = total;
+    if (data) {
+        u->data = u->origdata = static_cast<uchar*>(data);
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    void* block = nullptr;
+    if (total >= kMinPooledBytes && max_cached_per_thread_ > 0 && !t_cache_gone) {
+        size_t size_class = sizeClass(total);
+        auto& blocks = t_cache.blocks;
+        auto it = std::find_if(blocks.begin(), blocks.end(),
+                               [size_class](const std::pair<size_t, void*>& b) { return b.first == size_class; });
+        if (it != blocks.end()) {
+            block = it->second;
+            *it = blocks.back();
+            blocks.pop_back();
+            t_cache.bytes -= size_class;
+            g_cached_bytes.fetch_sub(static_cast<int64_t>(size_class), std::memory_order_relaxed);
+            g_pool_hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            block = cv::fastMalloc(size_class);
+        }
+    } else {
+        block = cv::fastMalloc(total);
+    }
+    u->data = u->origdata = static_cast<uchar*>(block);
+
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_live_bytes.fetch_add(static_cast<int64_t>(total), std::memory_order_relaxed);
+    t_live_bytes += static_cast<int64_t>(total);
+    if (FrameMemoryScope* scope = t_frame_scope) {
+        scope->allocated_ += total;
+        scope->peak_ = std::max(scope->peak_, t_live_bytes - scope->baseline_);
+    }
+    return u;
+}
+
+bool FrameAllocator::allocate(cv::UMatData* data, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return data != nullptr;
+}
+
+void FrameAllocator::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        size_t total = u->size;
+        g_live_bytes.fetch_sub(static_cast<int64_t>(total), std::memory_order_relaxed);
+        t_live_bytes -= static_cast<int64_t>(total);
+
+        bool parked = false;
+        if (total >= kMinPooledBytes && max_cached_per_thread_ > 0 && !t_cache_gone) {
+            size_t size_class = sizeClass(total);
+            // The total is checked without a lock; it may overshoot by a
+            // block per thread racing here, which is fine for a soft cap
+            if (t_cache.bytes + size_class <= max_cached_per_thread_ &&
+                static_cast<size_t>(g_cached_bytes.load(std::memory_order_relaxed)) + size_class <=
+                    max_cached_total_) {
+                t_cache.blocks.emplace_back(size_class, u->origdata);
+                t_cache.bytes += size_class;
+                g_cached_bytes.fetch_add(static_cast<int64_t>(size_class), std::memory_order_relaxed);
+                parked = true;
+            }
+        }
+        if (!parked) {
+            cv::fastFree(u->origdata);
+        }
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+FrameMemoryHistograms FrameMemoryHistograms::forEndpoint(const std::string& endpoint) {
+    auto& registry = MetricsRegistry::global();
+    std::string labels = "endpoint=\"" + endpoint + "\"";
+    return {
+        registry.histogram("ocr_request_frame_bytes", "Pixel buffer bytes allocated per request", labels,
+                           MetricHistogram::byteBuckets(), 1.0),
+        registry.histogram("ocr_request_peak_frame_bytes", "Most pixel buffer bytes a request held at once",
+                           labels, MetricHistogram::byteBuckets(), 1.0)
+    };
+}
+
+FrameMemoryScope::FrameMemoryScope(const FrameMemoryHistograms& histograms)
+    : histograms_(histograms), outer_(t_frame_scope), baseline_(t_live_bytes) {
+    t_frame_scope = this;
+}
+
+FrameMemoryScope::~FrameMemoryScope() {
+    t_frame_scope = outer_;
+    if (FrameAllocator::installed()) {
+        histograms_.allocated.observe(static_cast<double>(allocated_));
+        histograms_.peak.observe(static_cast<double>(peak_));
+    }
+}
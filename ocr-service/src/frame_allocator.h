@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "metrics.h"
+
+struct FrameAllocatorStats {
+    uint64_t allocations;  // pixel buffers handed out
+    uint64_t pool_hits;    // of those, served from a thread's free list
+    size_t live_bytes;     // held by Mats right now
+    size_t cached_bytes;   // parked in free lists across all threads
+};
+
+// Default cv::Mat allocator for the whole process. Every request clones and
+// converts full frames a few times; handing each one to malloc and back
+// leaves glibc's per-thread arenas fragmented with page-sized holes, and RSS
+// ratchets up until the pod is OOM-killed. Buffers from kMinPooledBytes up
+// are instead rounded to a size class and, when freed, parked on the freeing
+// thread's free list, up to a per-thread and a process-wide byte cap, for the
+// next frame of that class. Smaller buffers go straight to OpenCV's fastMalloc.
+//
+// It also counts the bytes each thread allocates, for FrameMemoryScope.
+class FrameAllocator : public cv::MatAllocator {
+public:
+    static constexpr size_t kMinPooledBytes = 256 * 1024;
+
+    // Makes the allocator OpenCV's default for every Mat allocated from now
+    // on. A zero cap keeps the accounting but pools nothing.
+    static void install(size_t max_cached_per_thread, size_t max_cached_total);
+    static bool installed();
+
+    static FrameAllocatorStats stats();
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+    FrameAllocator(size_t max_cached_per_thread, size_t max_cached_total)
+        : max_cached_per_thread_(max_cached_total > 0 ? max_cached_per_thread : 0),
+          max_cached_total_(max_cached_total) {}
+
+    size_t max_cached_per_thread_;
+    size_t max_cached_total_;
+};
+
+// ocr_request_frame_bytes and ocr_request_peak_frame_bytes for one endpoint.
+// Endpoints register theirs as they are constructed, so the two families
+// interleave in the registry; serialize() regroups them into one block each.
+struct FrameMemoryHistograms {
+    MetricHistogram& allocated;
+    MetricHistogram& peak;
+
+    static FrameMemoryHistograms forEndpoint(const std::string& endpoint);
+};
+
+// Pixel bytes allocated on this thread while the scope lives, recorded into
+// the two histograms when it ends: the total, and the peak held at once
+// counting from the scope's start. Work handed to other threads (tiles, batch
+// items stolen by scheduler workers) is not included. Records nothing when
+// the allocator is not installed.
+class FrameMemoryScope {
+public:
+    explicit FrameMemoryScope(const FrameMemoryHistograms& histograms);
+    ~FrameMemoryScope();
+
+    FrameMemoryScope(const FrameMemoryScope&) = delete;
+    FrameMemoryScope& operator=(const FrameMemoryScope&) = delete;
+
+private:
+    friend class FrameAllocator;
+
+    const FrameMemoryHistograms& histograms_;
+    FrameMemoryScope* outer_;
+    int64_t baseline_;
+    size_t allocated_ = 0;
+    int64_t peak_ = 0;
+};
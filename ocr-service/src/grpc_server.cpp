@@ -0,0 +1,403 @@
+#include "grpc_server.h"
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <grpcpp/grpcpp.h>
+#include "ocr_service.grpc.pb.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Same family as the REST endpoints, told apart by the endpoint label
+MetricHistogram& rpcHistogram(const char* method) {
+    return APIHandler::requestHistogram(std::string("grpc_") + method);
+}
+
+ResultDetail toDetail(ocr::v1::Detail detail, ResultDetail default_detail) {
+    switch (detail) {
+        case ocr::v1::DETAIL_TEXT: return ResultDetail::Text;
+        case ocr::v1::DETAIL_WORDS: return ResultDetail::Words;
+        case ocr::v1::DETAIL_WORD_BOXES: return ResultDetail::WordBoxes;
+        case ocr::v1::DETAIL_LAYOUT: return ResultDetail::Layout;
+        default: return default_detail;
+    }
+}
+
+TilingMode toTiling(ocr::v1::Tiling tiling) {
+    switch (tiling) {
+        case ocr::v1::TILING_OFF: return TilingMode::Off;
+        case ocr::v1::TILING_ON: return TilingMode::On;
+        default: return TilingMode::Auto;
+    }
+}
+
+void fillBox(const cv::Rect& rect, ocr::v1::Box* box) {
+    box->set_x(rect.x);
+    box->set_y(rect.y);
+    box->set_width(rect.width);
+    box->set_height(rect.height);
+}
+
+// Mirrors APIHandler::serializeResult: each detail level adds fields
+void fillResult(const OCRResult& result, ResultDetail detail, ocr::v1::OcrResult* out) {
+    out->set_text(result.text);
+    out->set_confidence(result.confidence);
+    out->set_word_count(static_cast<uint32_t>(result.word_count));
+    if (detail == ResultDetail::Text) {
+        return;
+    }
+
+    bool boxes = detail == ResultDetail::WordBoxes || detail == ResultDetail::Layout;
+    bool layout = detail == ResultDetail::Layout;
+    out->mutable_words()->Reserve(static_cast<int>(result.storedWords()));
+    for (size_t i = 0; i < result.storedWords(); i++) {
+        ocr::v1::Word* word = out->add_words();
+        std::string_view text = result.word(i);
+        word->set_text(text.data(), text.size());
+        if (i < result.word_confidences.size()) {
+            word->set_confidence(result.word_confidences[i]);
+        }
+        if (boxes && i < result.bounding_boxes.size()) {
+            fillBox(result.bounding_boxes[i], word->mutable_box());
+        }
+        if (layout && i < result.word_line_ids.size()) {
+            word->set_line(result.word_line_ids[i]);
+        }
+    }
+    if (layout) {
+        for (size_t i = 0; i < result.line_boxes.size(); i++) {
+            ocr::v1::Line* line = out->add_lines();
+            fillBox(result.line_boxes[i], line->mutable_box());
+            if (i < result.line_block_ids.size()) {
+                line->set_block(result.line_block_ids[i]);
+            }
+        }
+    }
+}
+
+// The REST X-Tenant-ID, X-API-Key and X-Request-Class headers, as metadata
+TenantContext tenantOf(const grpc::ServerContext* context) {
+    auto metadata = [context](const char* key) {
+        auto it = context->client_metadata().find(key);
+        return it != context->client_metadata().end() ? std::string_view(it->second.data(), it->second.size())
+                                                      : std::string_view();
+    };
+    return TenantContext::identify(metadata("x-tenant-id"), metadata("x-api-key"), metadata("x-request-class"),
+                                   RequestClass::Interactive);
+}
+
+std::string_view traceparentOf(const grpc::ServerContext* context) {
+    auto it = context->client_metadata().find("traceparent");
+    return it != context->client_metadata().end() ? std::string_view(it->second.data(), it->second.size())
+                                                  : std::string_view();
+}
+
+// Mirrors APIHandler::serializeTables
+void fillTable(const ExtractedTable& table, ocr::v1::Table* out) {
+    out->set_page(static_cast<uint32_t>(table.page));
+    fillBox(table.box, out->mutable_box());
+    out->set_rows(table.rows);
+    out->set_columns(table.columns);
+    out->mutable_cells()->Reserve(static_cast<int>(table.cells.size()));
+    for (const auto& cell : table.cells) {
+        ocr::v1::TableCell* item = out->add_cells();
+        item->set_row(cell.row);
+        item->set_column(cell.column);
+        item->set_text(cell.text);
+        fillBox(cell.box, item->mutable_box());
+        item->set_type(static_cast<ocr::v1::CellType>(cell.type));  // same order as CellType
+        item->set_value(cell.value);
+        item->set_currency(cell.currency);
+    }
+}
+
+// REST answers 503 and 413/400 for the same conditions
+grpc::Status documentStatus(DocumentStatus status, const std::string& error) {
+    switch (status) {
+        case DocumentStatus::Ok:
+            return grpc::Status::OK;
+        case DocumentStatus::EngineUnavailable:
+            return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "No OCR engine available, retry later");
+        default:
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error);
+    }
+}
+
+}
+
+class GrpcServer::Service final : public ocr::v1::OcrService::Service {
+public:
+    Service(APIHandler& api_handler, size_t max_upload_bytes)
+        : api_handler_(api_handler),
+          max_upload_bytes_(max_upload_bytes),
+          extract_latency_(rpcHistogram("extract")),
+          pages_latency_(rpcHistogram("extract_pages")),
+          analyze_latency_(rpcHistogram("analyze")),
+          extract_memory_(FrameMemoryHistograms::forEndpoint("grpc_extract")),
+          pages_memory_(FrameMemoryHistograms::forEndpoint("grpc_extract_pages")),
+          analyze_memory_(FrameMemoryHistograms::forEndpoint("grpc_analyze")) {
+    }
+
+    grpc::Status Extract(grpc::ServerContext* context, const ocr::v1::ImageRequest* request,
+                         ocr::v1::ExtractResponse* response) override {
+        RequestTrace trace("ocr.v1.OcrService/Extract", traceparentOf(context));
+        TenantScope tenant(tenantOf(context));
+        return extract(request->image(), request->options(), response);
+    }
+
+    grpc::Status ExtractUpload(grpc::ServerContext* context, grpc::ServerReader<ocr::v1::ImageChunk>* reader,
+                               ocr::v1::ExtractResponse* response) override {
+        RequestTrace trace("ocr.v1.OcrService/ExtractUpload", traceparentOf(context));
+        TenantScope tenant(tenantOf(context));
+        std::string image;
+        ocr::v1::OcrOptions options;
+        ocr::v1::ImageChunk chunk;
+        bool first = true;
+        while (reader->Read(&chunk)) {
+            if (first) {
+                options = chunk.options();
+                first = false;
+            }
+            if (image.size() + chunk.data().size() > max_upload_bytes_) {
+                return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                    "Upload exceeds " + std::to_string(max_upload_bytes_) + " bytes");
+            }
+            image += chunk.data();
+        }
+        return extract(image, options, response);
+    }
+
+    grpc::Status ExtractPages(grpc::ServerContext* context, const ocr::v1::ImageRequest* request,
+                              grpc::ServerWriter<ocr::v1::PageResult>* writer) override {
+        try {
+            RequestTrace trace("ocr.v1.OcrService/ExtractPages", traceparentOf(context));
+            StageTimer request_timer(pages_latency_);
+            FrameMemoryScope request_memory(pages_memory_);
+            TenantScope tenant(tenantOf(context));
+            OCROptions options;
+            grpc::Status status = parseOptions(request->image(), request->options(), ResultDetail::Words, options);
+            if (!status.ok()) {
+                return status;
+            }
+
+            ExecutionInfo execution;
+            if (!APIHandler::isPagedDocument(request->image())) {
+                auto result = api_handler_.extractCached(request->image(), options, execution);
+                if (!result) {
+                    return documentStatus(DocumentStatus::EngineUnavailable, "");
+                }
+                ocr::v1::PageResult page;
+                page.set_page(1);
+                page.set_cached(execution.cache_hit);
+                fillResult(*result, options.detail, page.mutable_result());
+                writer->Write(page);
+                return grpc::Status::OK;
+            }
+
+            // Pages finish on pool threads in any order; writes must not overlap
+            std::mutex write_mutex;
+            auto on_page = [&](size_t page_index, const std::shared_ptr<const OCRResult>& result, bool cache_hit) {
+                ocr::v1::PageResult page;
+                page.set_page(static_cast<uint32_t>(page_index + 1));
+                page.set_cached(cache_hit);
+                fillResult(*result, options.detail, page.mutable_result());
+                std::lock_guard<std::mutex> lock(write_mutex);
+                writer->Write(page);
+            };
+            std::vector<std::shared_ptr<const OCRResult>> pages;
+            std::string error;
+            DocumentStatus document = api_handler_.extractDocument(request->image(), options, pages, error,
+                                                                   execution, on_page);
+            return documentStatus(document, error);
+
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("Internal server error: ") + e.what());
+        }
+    }
+
+    grpc::Status Analyze(grpc::ServerContext* context, const ocr::v1::ImageRequest* request,
+                         ocr::v1::AnalyzeResponse* response) override {
+        try {
+            RequestTrace trace("ocr.v1.OcrService/Analyze", traceparentOf(context));
+            StageTimer request_timer(analyze_latency_);
+            FrameMemoryScope request_memory(analyze_memory_);
+            TenantScope tenant(tenantOf(context));
+            auto start = Clock::now();
+            OCROptions options;
+            grpc::Status status = parseOptions(request->image(), request->options(), ResultDetail::Text, options);
+            if (!status.ok()) {
+                return status;
+            }
+            // Field extraction only reads the text, table extraction the word
+            // boxes, and pages are never tiled
+            options.tables = request->options().tables();
+            options.detail = options.tables ? ResultDetail::WordBoxes : ResultDetail::Text;
+            options.tiling = TilingMode::Off;
+
+            ExecutionInfo execution;
+            DocumentStatus document = DocumentStatus::Ok;
+            std::string error;
+            auto info = api_handler_.analyzeData(request->image(), options, document, error, execution);
+            if (!info) {
+                return documentStatus(document, error);
+            }
+
+            response->set_document_type(info->document_type);
+            for (const auto& field : info->detected_fields) {
+                response->add_detected_fields(field);
+            }
+            response->mutable_extracted_data()->insert(info->extracted_data.begin(), info->extracted_data.end());
+            response->set_overall_confidence(info->overall_confidence);
+            for (const auto& table : info->tables) {
+                fillTable(table, response->add_tables());
+            }
+            response->set_cached(execution.cache_hit);
+            response->set_processing_time_ms(elapsedMs(start));
+            return grpc::Status::OK;
+
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("Internal server error: ") + e.what());
+        }
+    }
+
+private:
+    grpc::Status parseOptions(const std::string& image, const ocr::v1::OcrOptions& in, ResultDetail default_detail,
+                              OCROptions& options) {
+        if (image.empty()) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "image is empty");
+        }
+
+        options.language = in.language();
+        if (in.has_char_whitelist()) {
+            options.char_whitelist = in.char_whitelist();
+        }
+        options.dpi = in.dpi();
+        if (in.has_enhance()) {
+            options.preprocessing.enhance = in.enhance();
+        }
+        if (in.has_denoise()) {
+            options.preprocessing.denoise = in.denoise();
+        }
+        if (in.has_deskew()) {
+            options.preprocessing.deskew = in.deskew();
+        }
+        options.detail = toDetail(in.detail(), default_detail);
+        options.tiling = toTiling(in.tiling());
+        if (in.has_adaptive()) {
+            options.adaptive = in.adaptive();
+        }
+        if (in.has_confidence_threshold()) {
+            options.confidence_threshold = in.confidence_threshold();
+        }
+        options.decode.source_dpi = in.source_dpi();
+        if (in.target_dpi() > 0) {
+            options.decode.target_dpi = in.target_dpi();
+        }
+
+        int page_seg_mode = in.psm() != 0 ? in.psm() : static_cast<int>(options.page_seg_mode);
+        std::string error;
+        if (!api_handler_.checkOCROptions(page_seg_mode, options, error)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error);
+        }
+        return grpc::Status::OK;
+    }
+
+    grpc::Status extract(const std::string& image, const ocr::v1::OcrOptions& proto_options,
+                         ocr::v1::ExtractResponse* response) {
+        try {
+            StageTimer request_timer(extract_latency_);
+            FrameMemoryScope request_memory(extract_memory_);
+            auto start = Clock::now();
+            OCROptions options;
+            grpc::Status status = parseOptions(image, proto_options, ResultDetail::Words, options);
+            if (!status.ok()) {
+                return status;
+            }
+
+            ExecutionInfo execution;
+            if (APIHandler::isPagedDocument(image)) {
+                std::vector<std::shared_ptr<const OCRResult>> pages;
+                std::string error;
+                DocumentStatus document = api_handler_.extractDocument(image, options, pages, error, execution);
+                if (document != DocumentStatus::Ok) {
+                    return documentStatus(document, error);
+                }
+                // Document-level text up front, per-page detail underneath
+                fillResult(APIHandler::combinePages(pages), ResultDetail::Text, response->mutable_result());
+                for (const auto& page : pages) {
+                    fillResult(*page, options.detail, response->add_pages());
+                }
+                response->set_page_count(static_cast<uint32_t>(pages.size()));
+            } else {
+                auto result = api_handler_.extractCached(image, options, execution);
+                if (!result) {
+                    return documentStatus(DocumentStatus::EngineUnavailable, "");
+                }
+                fillResult(*result, options.detail, response->mutable_result());
+                response->set_page_count(1);
+            }
+
+            response->set_cached(execution.cache_hit);
+            response->set_queue_time_ms(execution.queue_time_ms);
+            response->set_processing_time_ms(elapsedMs(start));
+            return grpc::Status::OK;
+
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("Internal server error: ") + e.what());
+        }
+    }
+
+    APIHandler& api_handler_;
+    size_t max_upload_bytes_;
+    MetricHistogram& extract_latency_;
+    MetricHistogram& pages_latency_;
+    MetricHistogram& analyze_latency_;
+    FrameMemoryHistograms extract_memory_;
+    FrameMemoryHistograms pages_memory_;
+    FrameMemoryHistograms analyze_memory_;
+};
+
+GrpcServer::GrpcServer(APIHandler& api_handler, std::string address, size_t max_message_bytes,
+                       size_t max_upload_bytes)
+    : service_(std::make_unique<Service>(api_handler, max_upload_bytes)),
+      address_(std::move(address)),
+      max_message_bytes_(max_message_bytes) {
+}
+
+GrpcServer::~GrpcServer() {
+    shutdown();
+}
+
+bool GrpcServer::start() {
+    grpc::ServerBuilder builder;
+    int bound_port = 0;
+    builder.AddListeningPort(address_, grpc::InsecureServerCredentials(), &bound_port);
+    builder.SetMaxReceiveMessageSize(static_cast<int>(max_message_bytes_));
+    builder.SetMaxSendMessageSize(static_cast<int>(max_message_bytes_));
+    // Callers hold one connection open; keepalive pings notice dead peers
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, 60000);
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    builder.RegisterService(service_.get());
+
+    server_ = builder.BuildAndStart();
+    if (!server_ || bound_port == 0) {
+        std::cerr << "Failed to start gRPC server on " << address_ << std::endl;
+        server_.reset();
+        return false;
+    }
+    std::cout << "Serving gRPC on " << address_ << std::endl;
+    return true;
+}
+
+void GrpcServer::shutdown(std::chrono::milliseconds grace) {
+    if (server_) {
+        server_->Shutdown(std::chrono::system_clock::now() + grace);
+        server_->Wait();
+        server_.reset();
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "api_handler.h"
+
+namespace grpc {
+class Server;
+}
+
+// gRPC front end (proto/ocr_service.proto) next to the Crow routes. Calls go
+// through the same APIHandler core, so they share the engine pool, the
+// result cache and the document pipeline with REST requests. Built only with
+// -DOCR_WITH_GRPC=ON.
+class GrpcServer {
+public:
+    GrpcServer(APIHandler& api_handler, std::string address, size_t max_message_bytes, size_t max_upload_bytes);
+    ~GrpcServer();
+
+    GrpcServer(const GrpcServer&) = delete;
+    GrpcServer& operator=(const GrpcServer&) = delete;
+
+    // Binds and starts serving on gRPC's own threads; false if the address
+    // could not be bound
+    bool start();
+
+    // Stops accepting calls and waits up to grace for in-flight ones to
+    // finish, then cancels the rest
+    void shutdown(std::chrono::milliseconds grace = std::chrono::seconds(10));
+
+private:
+    class Service;
+
+    std::unique_ptr<Service> service_;
+    std::unique_ptr<grpc::Server> server_;
+    std::string address_;
+    size_t max_message_bytes_;
+};
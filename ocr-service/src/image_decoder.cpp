@@ -0,0 +1,163 @@
+#include "image_decoder.h"
+#include "metrics.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+ImageFormat detectImageFormat(const unsigned char* data, size_t size) {
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+        return ImageFormat::JPEG;
+    }
+    if (size >= 8 && std::memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        return ImageFormat::PNG;
+    }
+    if (size >= 4 && (std::memcmp(data, "II*\0", 4) == 0 || std::memcmp(data, "MM\0*", 4) == 0)) {
+        return ImageFormat::TIFF;
+    }
+    if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+        return ImageFormat::BMP;
+    }
+    if (size >= 5 && std::memcmp(data, "%PDF-", 5) == 0) {
+        return ImageFormat::PDF;
+    }
+    return ImageFormat::Unknown;
+}
+
+ImageFormat detectImageFormat(const std::string& image_path) {
+    std::ifstream file(image_path, std::ios::binary);
+    if (!file.is_open()) {
+        return ImageFormat::Unknown;
+    }
+
+    unsigned char header[8] = {0};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    return detectImageFormat(header, static_cast<size_t>(file.gcount()));
+}
+
+namespace {
+
+uint32_t readBigEndian(const unsigned char* data, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+int32_t readLittleEndian32(const unsigned char* data) {
+    return static_cast<int32_t>(static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                                static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t probeJpegPixels(const unsigned char* data, size_t size) {
+    // Walk the marker segments up to the first start-of-frame
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return 0;
+        }
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        size_t length = readBigEndian(data + pos + 2, 2);
+        bool frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (frame) {
+            if (pos + 9 > size) {
+                return 0;
+            }
+            uint64_t height = readBigEndian(data + pos + 5, 2);
+            uint64_t width = readBigEndian(data + pos + 7, 2);
+            return width * height;
+        }
+        if (marker == 0xDA || length < 2) {
+            return 0;
+        }
+        pos += 2 + length;
+    }
+    return 0;
+}
+
+}
+
+uint64_t probeImagePixels(std::string_view buffer) {
+    const auto* data = reinterpret_cast<const unsigned char*>(buffer.data());
+    size_t size = buffer.size();
+    switch (detectImageFormat(data, size)) {
+        case ImageFormat::JPEG:
+            return probeJpegPixels(data, size);
+        case ImageFormat::PNG:
+            // IHDR is always the first chunk
+            if (size >= 24 && std::memcmp(data + 12, "IHDR", 4) == 0) {
+                return static_cast<uint64_t>(readBigEndian(data + 16, 4)) * readBigEndian(data + 20, 4);
+            }
+            return 0;
+        case ImageFormat::BMP:
+            if (size >= 26) {
+                int64_t width = readLittleEndian32(data + 18);
+                int64_t height = readLittleEndian32(data + 22);
+                return static_cast<uint64_t>(std::abs(width) * std::abs(height));
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+int chooseImreadFlags(ImageFormat format, const DecodeOptions& options) {
+    bool continuous_tone = format == ImageFormat::JPEG || format == ImageFormat::PNG;
+    if (!continuous_tone || options.source_dpi <= 0 || options.target_dpi <= 0) {
+        return cv::IMREAD_GRAYSCALE;
+    }
+
+    // Pick the largest power-of-two reduction that keeps us at or above the
+    // target resolution; JPEG applies it in the DCT domain during decode
+    int ratio = options.source_dpi / options.target_dpi;
+    if (ratio >= 8) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_8;
+    }
+    if (ratio >= 4) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_4;
+    }
+    if (ratio >= 2) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_2;
+    }
+    return cv::IMREAD_GRAYSCALE;
+}
+
+cv::Mat decodeImageFile(const std::string& image_path, const DecodeOptions& options) {
+    StageTimer timer(Stage::Decode);
+    return cv::imread(image_path, chooseImreadFlags(detectImageFormat(image_path), options));
+}
+
+bool readImageFile(const std::string& image_path, std::string& buffer) {
+    std::ifstream file(image_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::streamsize size = file.tellg();
+    if (size <= 0) {
+        return false;
+    }
+
+    buffer.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(&buffer[0], size));
+}
+
+cv::Mat decodeImageBuffer(std::string_view buffer, const DecodeOptions& options) {
+    if (buffer.empty()) {
+        return cv::Mat();
+    }
+
+    StageTimer timer(Stage::Decode);
+    const auto* bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+    cv::Mat encoded(1, static_cast<int>(buffer.size()), CV_8UC1, const_cast<unsigned char*>(bytes));
+    return cv::imdecode(encoded, chooseImreadFlags(detectImageFormat(bytes, buffer.size()), options));
+}
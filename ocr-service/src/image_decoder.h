@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <opencv2/opencv.hpp>
+
+enum class ImageFormat {
+    Unknown,
+    JPEG,
+    PNG,
+    TIFF,
+    BMP,
+    PDF
+};
+
+struct DecodeOptions {
+    int source_dpi = 0;    // scan resolution if the caller knows it, 0 = unknown
+    int target_dpi = 300;  // resolution Tesseract should see
+};
+
+// Sniffs the container format from the leading magic bytes
+ImageFormat detectImageFormat(const unsigned char* data, size_t size);
+ImageFormat detectImageFormat(const std::string& image_path);
+
+// Width times height from the JPEG, PNG or BMP header, without decoding; 0
+// for other formats or a header it cannot read. Used to cost a request
+// before any engine is spent on it.
+uint64_t probeImagePixels(std::string_view buffer);
+
+// OCR only ever consumes a single 8-bit channel, so every source is decoded
+// straight to grayscale. Continuous-tone formats are additionally decoded at
+// 1/2, 1/4 or 1/8 scale when the source resolution is known to be well above
+// the target; bilevel-friendly formats (TIFF/BMP fax scans) are never reduced.
+int chooseImreadFlags(ImageFormat format, const DecodeOptions& options);
+
+cv::Mat decodeImageFile(const std::string& image_path, const DecodeOptions& options);
+
+// Reads the encoded bytes of a file so they can be hashed and then decoded
+// from memory with decodeImageBuffer
+bool readImageFile(const std::string& image_path, std::string& buffer);
+
+// Decodes an encoded image held in memory (e.g. a multipart upload) without
+// copying it; the buffer only has to outlive the call
+cv::Mat decodeImageBuffer(std::string_view buffer, const DecodeOptions& options);
@@ -0,0 +1,377 @@
+#include "job_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+const char* jobStatusName(JobStatus status) {
+    switch (status) {
+        case JobStatus::Queued:
+            return "queued";
+        case JobStatus::Running:
+            return "running";
+        case JobStatus::Completed:
+            return "completed";
+        case JobStatus::Failed:
+            return "failed";
+    }
+    return "unknown";
+}
+
+nlohmann::json JobSnapshot::toJson() const {
+    nlohmann::json job = {
+        {"job_id", id},
+        {"type", type},
+        {"status", jobStatusName(status)},
+        {"priority", priority},
+        {"streaming", streaming},
+        {"created_at_ms", created_at_ms}
+    };
+    if (started_at_ms > 0) {
+        job["started_at_ms"] = started_at_ms;
+    }
+    if (status == JobStatus::Completed || status == JobStatus::Failed) {
+        job["finished_at_ms"] = finished_at_ms;
+        job["status_code"] = outcome.status_code;
+        job["result"] = outcome.body;
+    }
+    return job;
+}
+
+JobManager::JobManager(size_t workers, size_t max_queued, size_t max_retained, WebhookNotifier& notifier)
+    : worker_count_(workers > 0 ? workers : 1), max_queued_(max_queued), max_retained_(max_retained),
+      notifier_(notifier), id_generator_(std::random_device{}()), next_sequence_(0), running_(0),
+      submitted_(0), rejected_(0), completed_(0), failed_(0), stopping_(false), accepting_(true) {
+}
+
+JobManager::~JobManager() {
+    stop();
+}
+
+void JobManager::start(Runner runner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!workers_.empty()) {
+        return;
+    }
+    runner_ = std::move(runner);
+    workers_.reserve(worker_count_);
+    for (size_t i = 0; i < worker_count_; i++) {
+        workers_.emplace_back(&JobManager::workerLoop, this);
+    }
+}
+
+void JobManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    stream_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+int64_t JobManager::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string JobManager::generateIdLocked() {
+    // 128 random bits; ids double as capability tokens for polling, so they
+    // must not be guessable from one another
+    char id[33];
+    std::snprintf(id, sizeof(id), "%016llx%016llx",
+                  static_cast<unsigned long long>(id_generator_()),
+                  static_cast<unsigned long long>(id_generator_()));
+    return id;
+}
+
+bool JobManager::acceptsCallback(const std::string& callback_url) const {
+    return notifier_.accepts(callback_url);
+}
+
+bool JobManager::submit(const std::string& type, nlohmann::json request, int priority, bool streaming,
+                        std::string callback_url, std::string& job_id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || !accepting_ || queue_.size() >= max_queued_) {
+            rejected_++;
+            return false;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->snapshot.id = generateIdLocked();
+        job->snapshot.type = type;
+        job->snapshot.priority = priority;
+        job->snapshot.streaming = streaming;
+        job->snapshot.created_at_ms = nowMs();
+        job->request = std::move(request);
+        job->callback_url = std::move(callback_url);
+
+        job_id = job->snapshot.id;
+        enqueueLocked(std::move(job));
+        submitted_++;
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+void JobManager::enqueueLocked(std::shared_ptr<Job> job) {
+    job->sequence = next_sequence_++;
+    jobs_[job->snapshot.id] = job;
+    queue_.push(std::move(job));
+}
+
+void JobManager::stopAccepting() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    accepting_ = false;
+}
+
+size_t JobManager::checkpointQueued(const std::string& directory) {
+    nlohmann::json checkpoint = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Popped in priority order, so a restore re-queues them in that order
+        while (!queue_.empty()) {
+            std::shared_ptr<Job> job = queue_.top();
+            queue_.pop();
+            checkpoint.push_back({
+                {"job_id", job->snapshot.id},
+                {"type", job->snapshot.type},
+                {"priority", job->snapshot.priority},
+                {"streaming", job->snapshot.streaming},
+                {"created_at_ms", job->snapshot.created_at_ms},
+                {"callback_url", job->callback_url},
+                {"request", std::move(job->request)}
+            });
+            jobs_.erase(job->snapshot.id);
+        }
+    }
+    if (checkpoint.empty()) {
+        return 0;
+    }
+
+    // Written aside and renamed, so a restoring instance never sees half a file
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        name = "jobs-" + std::to_string(nowMs()) + "-" + generateIdLocked().substr(0, 8) + ".json";
+    }
+    std::filesystem::path path = std::filesystem::path(directory) / name;
+    std::filesystem::path partial = path;
+    partial += ".partial";
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        out << checkpoint.dump();
+        if (!out) {
+            std::cerr << "Failed to write job checkpoint " << partial << std::endl;
+            return 0;
+        }
+    }
+    std::filesystem::rename(partial, path, ec);
+    if (ec) {
+        std::cerr << "Failed to publish job checkpoint " << path << ": " << ec.message() << std::endl;
+        return 0;
+    }
+    std::cout << "Checkpointed " << checkpoint.size() << " queued jobs to " << path << std::endl;
+    return checkpoint.size();
+}
+
+bool JobManager::readCheckpoint(const std::string& path, std::vector<std::shared_ptr<Job>>& jobs) {
+    std::ifstream in(path, std::ios::binary);
+    nlohmann::json checkpoint = nlohmann::json::parse(in, nullptr, false);
+    if (!checkpoint.is_array()) {
+        return false;
+    }
+    try {
+        for (auto& entry : checkpoint) {
+            auto job = std::make_shared<Job>();
+            job->snapshot.id = entry.at("job_id").get<std::string>();
+            job->snapshot.type = entry.at("type").get<std::string>();
+            job->snapshot.priority = entry.value("priority", 0);
+            job->snapshot.streaming = entry.value("streaming", false);
+            job->snapshot.created_at_ms = entry.value("created_at_ms", int64_t{0});
+            job->callback_url = entry.value("callback_url", std::string());
+            job->request = std::move(entry.at("request"));
+            jobs.push_back(std::move(job));
+        }
+    } catch (const nlohmann::json::exception&) {
+        return false;
+    }
+    return true;
+}
+
+size_t JobManager::restoreCheckpoints(const std::string& directory) {
+    std::error_code ec;
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.path().extension() == ".json") {
+            files.push_back(entry.path());
+        }
+    }
+
+    size_t restored = 0;
+    for (const auto& file : files) {
+        // Instances starting together share the directory; the rename is
+        // the claim, and whoever loses it skips the file
+        std::filesystem::path claimed = file;
+        claimed += ".restoring";
+        std::filesystem::rename(file, claimed, ec);
+        if (ec) {
+            continue;
+        }
+
+        std::vector<std::shared_ptr<Job>> jobs;
+        if (!readCheckpoint(claimed.string(), jobs)) {
+            std::cerr << "Ignoring unreadable job checkpoint " << file << std::endl;
+            continue;
+        }
+        {
+            // Restored jobs were admitted once already; they are not held to
+            // the queue bound a second time
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& job : jobs) {
+                enqueueLocked(std::move(job));
+                submitted_++;
+                restored++;
+            }
+        }
+        std::filesystem::remove(claimed, ec);
+    }
+    if (restored > 0) {
+        std::cout << "Restored " << restored << " checkpointed jobs from " << directory << std::endl;
+    }
+    return restored;
+}
+
+bool JobManager::find(const std::string& job_id, JobSnapshot& snapshot) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) {
+        return false;
+    }
+    snapshot = it->second->snapshot;
+    return true;
+}
+
+bool JobManager::readResults(const std::string& job_id, uint64_t cursor, std::chrono::milliseconds wait,
+                             std::vector<std::string>& lines, uint64_t& next_cursor, JobStatus& status) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) {
+        return false;
+    }
+    std::shared_ptr<Job> job = it->second;
+
+    while (job->stream_base < cursor && !job->stream.empty()) {
+        job->stream.pop_front();
+        job->stream_base++;
+    }
+
+    stream_cv_.wait_for(lock, wait, [&]() {
+        return stopping_ || job->stream_base + job->stream.size() > cursor ||
+               job->snapshot.status == JobStatus::Completed || job->snapshot.status == JobStatus::Failed;
+    });
+
+    uint64_t end = job->stream_base + job->stream.size();
+    for (uint64_t index = std::max(cursor, job->stream_base); index < end; index++) {
+        lines.push_back(job->stream[index - job->stream_base]);
+    }
+    next_cursor = end;
+    status = job->snapshot.status;
+    return true;
+}
+
+void JobManager::workerLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = queue_.top();
+            queue_.pop();
+            job->snapshot.status = JobStatus::Running;
+            job->snapshot.started_at_ms = nowMs();
+            running_++;
+        }
+
+        ResultEmitter emit = [this, job](std::string line) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                job->stream.push_back(std::move(line));
+            }
+            stream_cv_.notify_all();
+        };
+
+        // The request and type are only written before the job was queued,
+        // so they can be read here without the lock
+        JobOutcome outcome;
+        try {
+            outcome = runner_(job->snapshot.type, job->request, emit);
+        } catch (const std::exception& e) {
+            outcome.status_code = 500;
+            outcome.body = {{"success", false}, {"error", std::string("Job failed: ") + e.what()}};
+        }
+
+        JobSnapshot finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_--;
+            job->snapshot.outcome = std::move(outcome);
+            job->snapshot.finished_at_ms = nowMs();
+            bool ok = job->snapshot.outcome.status_code >= 200 && job->snapshot.outcome.status_code < 300;
+            job->snapshot.status = ok ? JobStatus::Completed : JobStatus::Failed;
+            if (ok) {
+                completed_++;
+            } else {
+                failed_++;
+            }
+            finished = job->snapshot;
+            job->request = nlohmann::json();
+            retireLocked(job->snapshot.id);
+        }
+
+        stream_cv_.notify_all();
+
+        if (!job->callback_url.empty()) {
+            notifier_.enqueue(job->callback_url, finished.toJson().dump());
+        }
+    }
+}
+
+void JobManager::retireLocked(const std::string& job_id) {
+    finished_order_.push_back(job_id);
+    while (finished_order_.size() > max_retained_) {
+        jobs_.erase(finished_order_.front());
+        finished_order_.pop_front();
+    }
+}
+
+JobManagerStats JobManager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    JobManagerStats stats;
+    stats.queued = queue_.size();
+    stats.running = running_;
+    stats.max_queued = max_queued_;
+    stats.retained = finished_order_.size();
+    stats.submitted = submitted_;
+    stats.rejected = rejected_;
+    stats.completed = completed_;
+    stats.failed = failed_;
+    return stats;
+}
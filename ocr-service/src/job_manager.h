@@ -0,0 +1,166 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "webhook_notifier.h"
+
+enum class JobStatus {
+    Queued,
+    Running,
+    Completed,
+    Failed
+};
+
+const char* jobStatusName(JobStatus status);
+
+// What a job's handler produced: the HTTP status and body it would have
+// answered synchronously
+struct JobOutcome {
+    int status_code = 500;
+    nlohmann::json body;
+};
+
+// Publishes one partial result (a single NDJSON line) of the running job
+using ResultEmitter = std::function<void(std::string line)>;
+
+struct JobSnapshot {
+    std::string id;
+    std::string type;
+    JobStatus status = JobStatus::Queued;
+    int priority = 0;
+    bool streaming = false;
+    int64_t created_at_ms = 0;
+    int64_t started_at_ms = 0;
+    int64_t finished_at_ms = 0;
+    JobOutcome outcome;
+
+    nlohmann::json toJson() const;
+};
+
+struct JobManagerStats {
+    size_t queued;
+    size_t running;
+    size_t max_queued;
+    size_t retained;
+    uint64_t submitted;
+    uint64_t rejected;
+    uint64_t completed;
+    uint64_t failed;
+};
+
+// Asynchronous front end to the synchronous handlers. Submissions go into a
+// bounded priority queue (higher priority first, FIFO within a priority)
+// drained by a fixed set of job workers, so long batches no longer hold an
+// HTTP connection open. Finished jobs are kept for polling up to a retention
+// limit, oldest evicted first, and optionally announced to a callback URL.
+// Streaming jobs additionally expose the results emitted so far as a cursor
+// over a line log; lines the client has read past are released.
+class JobManager {
+public:
+    using Runner = std::function<JobOutcome(const std::string& type, const nlohmann::json& request,
+                                            const ResultEmitter& emit)>;
+
+    JobManager(size_t workers, size_t max_queued, size_t max_retained, WebhookNotifier& notifier);
+    ~JobManager();
+
+    JobManager(const JobManager&) = delete;
+    JobManager& operator=(const JobManager&) = delete;
+
+    // Workers start once the runner exists, which lets the API handler that
+    // submits jobs also be the one that executes them
+    void start(Runner runner);
+    void stop();
+
+    // Refuses new submissions, as when the queue is full, while the workers
+    // keep running the jobs already queued
+    void stopAccepting();
+
+    // Takes every job still queued off the queue and writes them to a new
+    // file in directory, for a replacement instance to restore. Returns how
+    // many were written; jobs already running are left to finish.
+    size_t checkpointQueued(const std::string& directory);
+
+    // Queues the jobs of every checkpoint file in directory under their
+    // original ids, deleting each file it takes. Call before start().
+    size_t restoreCheckpoints(const std::string& directory);
+
+    // Whether the notifier would deliver to callback_url
+    bool acceptsCallback(const std::string& callback_url) const;
+
+    // Returns false when the queue is full; the caller should shed the request
+    bool submit(const std::string& type, nlohmann::json request, int priority, bool streaming,
+                std::string callback_url, std::string& job_id);
+    bool find(const std::string& job_id, JobSnapshot& snapshot) const;
+
+    // Returns the result lines from cursor onward, waiting up to wait for at
+    // least one while the job is unfinished. Lines before cursor are taken as
+    // received and dropped. next_cursor is where the following read resumes.
+    bool readResults(const std::string& job_id, uint64_t cursor, std::chrono::milliseconds wait,
+                     std::vector<std::string>& lines, uint64_t& next_cursor, JobStatus& status);
+
+    JobManagerStats getStats() const;
+
+private:
+    struct Job {
+        JobSnapshot snapshot;
+        nlohmann::json request;
+        std::string callback_url;
+        uint64_t sequence = 0;
+
+        // Emitted result lines; stream.front() has index stream_base
+        std::deque<std::string> stream;
+        uint64_t stream_base = 0;
+    };
+
+    struct QueueOrder {
+        bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+            if (a->snapshot.priority != b->snapshot.priority) {
+                return a->snapshot.priority < b->snapshot.priority;
+            }
+            return a->sequence > b->sequence;
+        }
+    };
+
+    void workerLoop();
+    void enqueueLocked(std::shared_ptr<Job> job);
+    static bool readCheckpoint(const std::string& path, std::vector<std::shared_ptr<Job>>& jobs);
+    void retireLocked(const std::string& job_id);
+    std::string generateIdLocked();
+    static int64_t nowMs();
+
+    size_t worker_count_;
+    size_t max_queued_;
+    size_t max_retained_;
+    WebhookNotifier& notifier_;
+    Runner runner_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    std::condition_variable stream_cv_;
+    std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, QueueOrder> queue_;
+    std::unordered_map<std::string, std::shared_ptr<Job>> jobs_;
+    std::deque<std::string> finished_order_;
+    std::mt19937_64 id_generator_;
+    uint64_t next_sequence_;
+    size_t running_;
+    uint64_t submitted_;
+    uint64_t rejected_;
+    uint64_t completed_;
+    uint64_t failed_;
+    bool stopping_;
+    bool accepting_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,90 @@
+#include "lifecycle_manager.h"
+#include <csignal>
+#include <iostream>
+#include <pthread.h>
+#include <signal.h>
+
+namespace {
+
+sigset_t shutdownSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    return signals;
+}
+
+}
+
+LifecycleManager::Admission::~Admission() {
+    if (manager_) {
+        manager_->in_flight_.fetch_sub(1);
+    }
+}
+
+LifecycleManager::LifecycleManager(std::chrono::milliseconds drain_timeout)
+    : drain_timeout_(drain_timeout), draining_(false), cancelled_(false), in_flight_(0) {
+}
+
+LifecycleManager::~LifecycleManager() {
+    cancel();
+}
+
+void LifecycleManager::blockShutdownSignals() {
+    sigset_t signals = shutdownSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+void LifecycleManager::watch(DrainHandler drain) {
+    if (watcher_.joinable()) {
+        return;
+    }
+    watcher_ = std::thread(&LifecycleManager::run, this, std::move(drain));
+}
+
+void LifecycleManager::cancel() {
+    if (!watcher_.joinable()) {
+        return;
+    }
+    // The watcher only wakes for a signal; send it one it will ignore
+    if (!draining()) {
+        cancelled_.store(true);
+        pthread_kill(watcher_.native_handle(), SIGTERM);
+    }
+    watcher_.join();
+}
+
+void LifecycleManager::run(DrainHandler drain) {
+    sigset_t signals = shutdownSignals();
+    int signal = 0;
+    if (sigwait(&signals, &signal) != 0 || cancelled_.load()) {
+        return;
+    }
+
+    std::cout << "Received signal " << signal << ", draining for up to " << drain_timeout_.count()
+              << " ms..." << std::endl;
+    Clock::time_point deadline = Clock::now() + drain_timeout_;
+    draining_.store(true);
+    drain(deadline);
+}
+
+LifecycleManager::Admission LifecycleManager::admit() {
+    // Count first, then check: the drain sets the flag before it reads the
+    // count, so either it sees this request or this request sees the flag
+    in_flight_.fetch_add(1);
+    if (draining_.load()) {
+        in_flight_.fetch_sub(1);
+        return Admission();
+    }
+    return Admission(this);
+}
+
+bool LifecycleManager::waitUntil(Clock::time_point deadline, const std::function<bool()>& done) {
+    while (!done()) {
+        if (Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return true;
+}
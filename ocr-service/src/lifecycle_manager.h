@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+// Turns SIGTERM/SIGINT into an orderly drain instead of an exit. The signals
+// are blocked in every thread and taken by one watcher thread with sigwait,
+// so the drain itself runs as ordinary code rather than in a signal handler.
+// Work-creating requests hold an Admission while they run; once draining,
+// new ones are refused and the drain waits for the admitted ones.
+class LifecycleManager {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Runs once on the watcher thread; everything must be finished, or given
+    // up on, by the deadline
+    using DrainHandler = std::function<void(Clock::time_point deadline)>;
+
+    class Admission {
+    public:
+        Admission() = default;
+        Admission(Admission&& other) noexcept : manager_(other.manager_) { other.manager_ = nullptr; }
+        Admission& operator=(Admission&&) = delete;
+        Admission(const Admission&) = delete;
+        Admission& operator=(const Admission&) = delete;
+        ~Admission();
+
+        explicit operator bool() const { return manager_ != nullptr; }
+
+    private:
+        friend class LifecycleManager;
+        explicit Admission(LifecycleManager* manager) : manager_(manager) {}
+
+        LifecycleManager* manager_ = nullptr;
+    };
+
+    explicit LifecycleManager(std::chrono::milliseconds drain_timeout);
+    ~LifecycleManager();
+
+    LifecycleManager(const LifecycleManager&) = delete;
+    LifecycleManager& operator=(const LifecycleManager&) = delete;
+
+    // Must run on the main thread before any other thread starts, so every
+    // thread inherits the blocked mask and none takes the signal itself
+    static void blockShutdownSignals();
+
+    // Starts the watcher; on the first signal it marks the service draining
+    // and calls drain
+    void watch(DrainHandler drain);
+
+    // Lets the watcher exit without draining, for shutdowns that did not
+    // come from a signal
+    void cancel();
+
+    // Empty once draining; the caller should answer 503
+    Admission admit();
+    bool draining() const { return draining_.load(std::memory_order_acquire); }
+    size_t inFlight() const { return in_flight_.load(std::memory_order_acquire); }
+
+    // Polls done until it holds or deadline passes; true if it held
+    static bool waitUntil(Clock::time_point deadline, const std::function<bool()>& done);
+
+private:
+    void run(DrainHandler drain);
+
+    std::chrono::milliseconds drain_timeout_;
+    std::atomic<bool> draining_;
+    std::atomic<bool> cancelled_;
+    std::atomic<size_t> in_flight_;
+    std::thread watcher_;
+};
@@ -1,78 +1,452 @@
+#include <algorithm>
 #include <iostream>
 #include <memory>
-#include <signal.h>
+#include <cstdlib>
+#include <string>
+#include <thread>
 #include <crow.h>
 #include <nlohmann/json.hpp>
 
-#include "ocr_engine.h"
+#include "engine_pool.h"
+#include "work_stealing_scheduler.h"
+#include "result_cache.h"
+#include "page_tiler.h"
+#include "document_pipeline.h"
+#include "webhook_notifier.h"
+#include "tracing.h"
+#include "job_manager.h"
 #include "api_handler.h"
+#include "metrics.h"
+#include "lifecycle_manager.h"
+#include "frame_allocator.h"
+#ifdef OCR_WITH_GRPC
+#include "grpc_server.h"
+#endif
 
 using json = nlohmann::json;
 
-std::unique_ptr<OCREngine> ocr_engine;
+std::unique_ptr<EnginePool> engine_pool;
+std::shared_ptr<TemplateRegistry> template_registry;
+std::unique_ptr<WorkStealingScheduler> scheduler;
+std::unique_ptr<ResultCache> result_cache;
+std::unique_ptr<PageTiler> page_tiler;
+std::unique_ptr<DocumentPipeline> document_pipeline;
+std::unique_ptr<WebhookNotifier> webhook_notifier;
+std::unique_ptr<WebhookNotifier> trace_exporter;
+std::unique_ptr<JobManager> job_manager;
+std::unique_ptr<RasterSource> raster_source;
 std::unique_ptr<APIHandler> api_handler;
+std::unique_ptr<LifecycleManager> lifecycle;
 
-void signal_handler(int signal) {
-    std::cout << "Received signal " << signal << ", shutting down..." << std::endl;
-    exit(0);
+size_t getEnvSize(const char* name, size_t default_value) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return default_value;
+    }
+    try {
+        return static_cast<size_t>(std::stoul(value));
+    } catch (const std::exception&) {
+        std::cerr << "Ignoring invalid value for " << name << ": " << value << std::endl;
+        return default_value;
+    }
+}
+
+// Scrape-time views of state the pool, scheduler and cache already track
+void registerServiceMetrics() {
+    using Type = MetricsRegistry::Type;
+    auto& registry = MetricsRegistry::global();
+
+    registry.callback("ocr_engine_pool_size", "OCR engines in the pool", Type::Gauge,
+                      []() { return static_cast<double>(engine_pool->getStats().size); });
+    registry.callback("ocr_engine_pool_in_use", "OCR engines currently checked out", Type::Gauge,
+                      []() { return static_cast<double>(engine_pool->getStats().in_use); });
+    registry.callback("ocr_engine_pool_utilization", "Fraction of OCR engines checked out", Type::Gauge, []() {
+        EnginePoolStats stats = engine_pool->getStats();
+        return stats.size > 0 ? static_cast<double>(stats.in_use) / stats.size : 0.0;
+    });
+    registry.callback("ocr_engine_pool_waiting", "Requests queued for an OCR engine", Type::Gauge,
+                      []() { return static_cast<double>(engine_pool->getStats().waiting); });
+    registry.callback("ocr_engine_pool_checkouts_total", "OCR engine checkouts", Type::Counter,
+                      []() { return static_cast<double>(engine_pool->getStats().total_checkouts); });
+    registry.callback("ocr_engine_pool_rejected_total", "Requests turned away with no engine available",
+                      Type::Counter,
+                      []() { return static_cast<double>(engine_pool->getStats().rejected_checkouts); });
+    registry.callback("ocr_tenants_active", "Tenants with engine checkouts queued or running", Type::Gauge,
+                      []() { return static_cast<double>(engine_pool->getStats().tenants.tenants); });
+    for (RequestClass request_class : {RequestClass::Interactive, RequestClass::Bulk}) {
+        registry.callback("ocr_engine_grants_total", "OCR engine checkouts by request class", Type::Counter,
+                          [request_class]() {
+                              return static_cast<double>(
+                                  engine_pool->getStats().tenants.granted[static_cast<size_t>(request_class)]);
+                          },
+                          std::string("class=\"") + requestClassName(request_class) + "\"");
+    }
+    registry.callback("ocr_tenant_over_budget_total", "Checkouts refused over a tenant's pixel budget",
+                      Type::Counter,
+                      []() { return static_cast<double>(engine_pool->getStats().tenants.over_budget); });
+    registry.callback("ocr_traces_total", "Requests traced", Type::Counter,
+                      []() { return static_cast<double>(Tracer::global().getStats().traces); });
+    registry.callback("ocr_traces_kept_total", "Traces exported as sampled upstream, slow, or baseline",
+                      Type::Counter, []() { return static_cast<double>(Tracer::global().getStats().kept); });
+    registry.callback("ocr_trace_spans_dropped_total", "Spans past a trace's span buffer", Type::Counter,
+                      []() { return static_cast<double>(Tracer::global().getStats().dropped_spans); });
+    registry.callback("ocr_scheduler_pending_tasks", "Batch and tile tasks waiting for a worker", Type::Gauge,
+                      []() { return static_cast<double>(scheduler->pendingTasks()); });
+
+    registry.callback("ocr_jobs_queued", "Async jobs waiting for a job worker", Type::Gauge,
+                      []() { return static_cast<double>(job_manager->getStats().queued); });
+    registry.callback("ocr_jobs_running", "Async jobs being executed", Type::Gauge,
+                      []() { return static_cast<double>(job_manager->getStats().running); });
+    registry.callback("ocr_jobs_rejected_total", "Async jobs refused with 429", Type::Counter,
+                      []() { return static_cast<double>(job_manager->getStats().rejected); });
+    registry.callback("ocr_jobs_completed_total", "Async jobs that finished successfully", Type::Counter,
+                      []() { return static_cast<double>(job_manager->getStats().completed); });
+    registry.callback("ocr_jobs_failed_total", "Async jobs whose handler returned an error", Type::Counter,
+                      []() { return static_cast<double>(job_manager->getStats().failed); });
+
+    registry.callback("ocr_frame_bytes_live", "Pixel buffer bytes held by Mats", Type::Gauge,
+                      []() { return static_cast<double>(FrameAllocator::stats().live_bytes); });
+    registry.callback("ocr_frame_bytes_pooled", "Freed pixel buffer bytes kept for reuse", Type::Gauge,
+                      []() { return static_cast<double>(FrameAllocator::stats().cached_bytes); });
+    registry.callback("ocr_frame_allocations_total", "Pixel buffers allocated", Type::Counter,
+                      []() { return static_cast<double>(FrameAllocator::stats().allocations); });
+    registry.callback("ocr_frame_pool_hits_total", "Pixel buffers served from a free list", Type::Counter,
+                      []() { return static_cast<double>(FrameAllocator::stats().pool_hits); });
+
+    registry.callback("ocr_result_cache_hits_total", "Result cache hits", Type::Counter,
+                      []() { return static_cast<double>(result_cache->getStats().hits); });
+    registry.callback("ocr_result_cache_misses_total", "Result cache misses", Type::Counter,
+                      []() { return static_cast<double>(result_cache->getStats().misses); });
+    registry.callback("ocr_result_cache_hit_ratio", "Result cache hits over lookups", Type::Gauge,
+                      []() { return result_cache->getStats().hit_rate; });
+    registry.callback("ocr_result_cache_evictions_total", "Result cache evictions", Type::Counter,
+                      []() { return static_cast<double>(result_cache->getStats().evictions); });
+    registry.callback("ocr_result_cache_entries", "Results held in the cache", Type::Gauge,
+                      []() { return static_cast<double>(result_cache->getStats().entries); });
+    registry.callback("ocr_result_cache_bytes", "Approximate bytes held in the cache", Type::Gauge,
+                      []() { return static_cast<double>(result_cache->getStats().bytes); });
+
+    registry.callback("ocr_templates", "Document layouts known to the template registry", Type::Gauge,
+                      []() { return static_cast<double>(template_registry->getStats().templates); });
+    registry.callback("ocr_template_matches_total", "Analyzed pages matched to a known layout", Type::Counter,
+                      []() { return static_cast<double>(template_registry->getStats().matches); });
+    registry.callback("ocr_template_misses_total", "Analyzed pages with no known layout", Type::Counter,
+                      []() { return static_cast<double>(template_registry->getStats().misses); });
+    registry.callback("ocr_template_fallbacks_total", "Matched pages whose fields were re-read from the full page",
+                      Type::Counter,
+                      []() { return static_cast<double>(template_registry->getStats().fallbacks); });
+}
+
+// Work-creating routes run only while the service still admits requests;
+// once a drain has begun they answer 503 so callers retry on another pod
+template <typename Handler>
+crow::response admitted(Handler&& handle) {
+    LifecycleManager::Admission admission = lifecycle->admit();
+    if (!admission) {
+        json body = {{"success", false}, {"error", "Service is shutting down"}, {"status_code", 503}};
+        crow::response res(503, body.dump());
+        res.set_header("Content-Type", "application/json");
+        res.set_header("Retry-After", "1");
+        return res;
+    }
+    return handle();
 }
 
 int main() {
-    // Set up signal handling
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // SIGTERM/SIGINT start a drain on the lifecycle watcher instead of
+    // killing in-flight work; blocked before any thread exists
+    LifecycleManager::blockShutdownSignals();
 
     try {
-        // Initialize OCR engine
-        ocr_engine = std::make_unique<OCREngine>();
-        if (!ocr_engine->initialize()) {
-            std::cerr << "Failed to initialize OCR engine" << std::endl;
-            return 1;
+        // A drain has this long to finish admitted requests and queued jobs;
+        // keep it under the pod's terminationGracePeriodSeconds
+        lifecycle = std::make_unique<LifecycleManager>(
+            std::chrono::milliseconds(getEnvSize("OCR_DRAIN_TIMEOUT_MS", 25000)));
+
+        // Frame buffers are recycled per thread instead of churning glibc's
+        // arenas; installed before anything allocates a Mat
+        // (OCR_FRAME_POOL_MAX_BYTES=0 turns the recycling off)
+        FrameAllocator::install(getEnvSize("OCR_FRAME_POOL_THREAD_BYTES", 32 * 1024 * 1024),
+                                getEnvSize("OCR_FRAME_POOL_MAX_BYTES", 256 * 1024 * 1024));
+
+        // Initialize OCR engine pool (MAX_WORKERS=0 means one engine per core)
+        size_t pool_size = getEnvSize("MAX_WORKERS", 0);
+        size_t max_waiters = getEnvSize("OCR_POOL_MAX_WAITERS", 64);
+        auto wait_timeout = std::chrono::milliseconds(getEnvSize("OCR_POOL_WAIT_TIMEOUT_MS", 30000));
+
+        // Field definitions are compiled once and shared by every engine
+        std::string field_config_path = std::getenv("OCR_FIELD_CONFIG") ? std::getenv("OCR_FIELD_CONFIG")
+                                                                         : "config/fields.json";
+        FieldExtractorConfig field_config;
+        if (!FieldExtractorConfig::loadFromFile(field_config_path, field_config)) {
+            std::cerr << "Field config " << field_config_path << " not loaded, using built-in fields" << std::endl;
+            field_config = FieldExtractorConfig::defaults();
         }
+        auto field_extractor = std::make_shared<const FieldExtractor>(std::move(field_config));
+
+        // One warm sub-pool per language (OCR_LANGUAGES="eng,deu:2,fra" with an
+        // optional engine count per language); the first is the default
+        std::string languages = std::getenv("OCR_LANGUAGES") ? std::getenv("OCR_LANGUAGES") : "eng";
+        
+        // Busy engines go to interactive requests first and are shared fairly
+        // between tenants (X-Tenant-ID or API key); OCR_TENANT_MAX_PAGES caps
+        // the engines one tenant holds, OCR_TENANT_MAX_PIXELS what it may have
+        // queued, and OCR_TENANT_WEIGHTS="frontend:4,etl:0.5" sets shares
+        TenantSchedulerConfig tenants;
+        tenants.max_pages_per_tenant = getEnvSize("OCR_TENANT_MAX_PAGES", 0);
+        tenants.max_pixels_per_tenant = getEnvSize("OCR_TENANT_MAX_PIXELS", 0);
+        tenants.interactive_burst = static_cast<unsigned>(getEnvSize("OCR_INTERACTIVE_BURST", 8));
+        tenants.weights = TenantSchedulerConfig::parseWeights(
+            std::getenv("OCR_TENANT_WEIGHTS") ? std::getenv("OCR_TENANT_WEIGHTS") : "");
+        engine_pool = std::make_unique<EnginePool>(EnginePool::parseLanguages(languages, pool_size),
+                                                   max_waiters, wait_timeout, field_extractor, std::move(tenants));
+        
+        // Layouts of analyzed documents are learned so later pages of the same
+        // template only have their field regions read (OCR_TEMPLATE_MAX=0
+        // disables; OCR_TEMPLATE_MAX_DISTANCE is in differing bits of 4096)
+        template_registry = std::make_shared<TemplateRegistry>(
+            getEnvSize("OCR_TEMPLATE_MAX", 256), static_cast<int>(getEnvSize("OCR_TEMPLATE_MAX_DISTANCE", 200)));
+        engine_pool->setTemplateRegistry(template_registry);
+
+        // One batch worker per engine; batch items are work-stolen across them
+        scheduler = std::make_unique<WorkStealingScheduler>(engine_pool->size());
+
+        // Uploads above this size are spilled to /tmp instead of decoded in memory
+        size_t upload_spill_bytes = getEnvSize("OCR_UPLOAD_SPILL_BYTES", 64 * 1024 * 1024);
+
+        // Results of repeated submissions are served from memory
+        // (OCR_CACHE_MAX_ENTRIES=0 disables, OCR_CACHE_MAX_BYTES=0 means no size bound)
+        result_cache = std::make_unique<ResultCache>(getEnvSize("OCR_CACHE_MAX_ENTRIES", 1024),
+                                                     getEnvSize("OCR_CACHE_MAX_BYTES", 256 * 1024 * 1024));
+
+        // Pages of at least this many pixels are split into text blocks and
+        // recognized on several engines at once (OCR_TILING_MIN_PIXELS=0 leaves
+        // tiling to the per-request "tiling" flag)
+        page_tiler = std::make_unique<PageTiler>(*engine_pool, *scheduler,
+                                                 getEnvSize("OCR_TILING_MIN_PIXELS", 20 * 1000 * 1000));
+
+        // Multi-page TIFF/PDF: pages decoded ahead of OCR are capped so a long
+        // document holds only a few frames; longer documents are refused
+        size_t pages_in_flight = getEnvSize("OCR_DOCUMENT_PAGES_IN_FLIGHT", std::min<size_t>(engine_pool->size(), 4));
+        document_pipeline = std::make_unique<DocumentPipeline>(pages_in_flight,
+                                                               getEnvSize("OCR_DOCUMENT_MAX_PAGES", 500));
+
+        // Async jobs: a bounded queue in front of the handlers; a full queue
+        // answers 429 rather than letting work pile up. Callbacks go only to
+        // the comma-separated OCR_JOB_CALLBACK_HOSTS or, when it is unset, to
+        // any host that resolves to a public address
+        WebhookNotifier::globalInit();
+        DeliveryPolicy callback_policy;
+        callback_policy.allowed_hosts = DeliveryPolicy::parseHosts(
+            std::getenv("OCR_JOB_CALLBACK_HOSTS") ? std::getenv("OCR_JOB_CALLBACK_HOSTS") : "");
+        callback_policy.public_only = callback_policy.allowed_hosts.empty();
+        webhook_notifier = std::make_unique<WebhookNotifier>(
+            std::chrono::milliseconds(getEnvSize("OCR_JOB_CALLBACK_TIMEOUT_MS", 5000)), 3,
+            getEnvSize("OCR_JOB_CALLBACK_BACKLOG", 1024), std::move(callback_policy));
+        job_manager = std::make_unique<JobManager>(getEnvSize("OCR_JOB_WORKERS", engine_pool->size()),
+                                                   getEnvSize("OCR_JOB_QUEUE_SIZE", 256),
+                                                   getEnvSize("OCR_JOB_RETENTION", 1000),
+                                                   *webhook_notifier);
+
+        // Tracing, off unless OCR_OTLP_ENDPOINT names a collector's
+        // /v1/traces: every request is traced into a buffer on its stack, and
+        // kept when the caller's traceparent is sampled, when it takes at
+        // least OCR_TRACE_SLOW_MS (0 turns tracing off), or for
+        // OCR_TRACE_SAMPLE_PERMILLE of the rest. Kept traces are posted as
+        // OTLP/JSON from a background thread. OCR_TRACE_STDOUT=1 logs them
+        // instead, synchronously and only meant for debugging.
+        TraceConfig trace_config;
+        trace_config.slow_threshold = std::chrono::milliseconds(getEnvSize("OCR_TRACE_SLOW_MS", 2000));
+        trace_config.sample_ratio = std::min<size_t>(getEnvSize("OCR_TRACE_SAMPLE_PERMILLE", 0), 1000) / 1000.0;
+        if (const char* service_name = std::getenv("OTEL_SERVICE_NAME")) {
+            trace_config.service_name = service_name;
+        }
+        std::string otlp_endpoint = std::getenv("OCR_OTLP_ENDPOINT") ? std::getenv("OCR_OTLP_ENDPOINT") : "";
+        if (!otlp_endpoint.empty() && WebhookNotifier::isValidUrl(otlp_endpoint)) {
+            trace_exporter = std::make_unique<WebhookNotifier>(std::chrono::milliseconds(2000), 1,
+                                                               getEnvSize("OCR_TRACE_BACKLOG", 256));
+            Tracer::global().configure(trace_config, [otlp_endpoint](std::string body) {
+                trace_exporter->enqueue(otlp_endpoint, std::move(body));
+            });
+        } else if (getEnvSize("OCR_TRACE_STDOUT", 0) != 0) {
+            Tracer::global().configure(trace_config, [](std::string body) {
+                std::cout << "trace " << body << std::endl;
+            });
+        } else if (!otlp_endpoint.empty()) {
+            std::cerr << "Ignoring invalid OCR_OTLP_ENDPOINT " << otlp_endpoint << ", tracing is off" << std::endl;
+        }
+
+        // Co-located callers may pass a decoded raster by shared-memory name;
+        // only names under OCR_SHM_PREFIX are opened, and at most
+        // OCR_SHM_MAX_SEGMENTS of them stay mapped between requests
+        std::string shm_prefix = std::getenv("OCR_SHM_PREFIX") ? std::getenv("OCR_SHM_PREFIX") : "/ocr-";
+        raster_source = std::make_unique<RasterSource>(shm_prefix, getEnvSize("OCR_SHM_MAX_SEGMENTS", 16));
 
         // Initialize API handler
-        api_handler = std::make_unique<APIHandler>(*ocr_engine);
+        api_handler = std::make_unique<APIHandler>(*engine_pool, *scheduler, *result_cache, *page_tiler,
+                                                   *document_pipeline, *job_manager, *raster_source,
+                                                   upload_spill_bytes);
+        // Jobs a drained instance left queued resume here instead of being
+        // resubmitted (OCR_JOB_CHECKPOINT_DIR on a volume the pods share;
+        // unset keeps queued jobs in memory only)
+        std::string checkpoint_dir = std::getenv("OCR_JOB_CHECKPOINT_DIR") ? std::getenv("OCR_JOB_CHECKPOINT_DIR")
+                                                                           : "";
+        if (!checkpoint_dir.empty()) {
+            job_manager->restoreCheckpoints(checkpoint_dir);
+        }
+        job_manager->start([](const std::string& type, const json& request_data, const ResultEmitter& emit) {
+            return api_handler->runJob(type, request_data, emit);
+        });
+
+        registerServiceMetrics();
+
+#ifdef OCR_WITH_GRPC
+        // Internal callers send image bytes over one persistent HTTP/2
+        // connection, served from the same pool (OCR_GRPC_PORT=0 disables)
+        std::unique_ptr<GrpcServer> grpc_server;
+        size_t grpc_port = getEnvSize("OCR_GRPC_PORT", 50051);
+        if (grpc_port > 0) {
+            grpc_server = std::make_unique<GrpcServer>(*api_handler, "0.0.0.0:" + std::to_string(grpc_port),
+                                                       getEnvSize("OCR_GRPC_MAX_MESSAGE_BYTES", 64 * 1024 * 1024),
+                                                       getEnvSize("OCR_GRPC_MAX_UPLOAD_BYTES", 256 * 1024 * 1024));
+            if (!grpc_server->start()) {
+                return 1;
+            }
+        }
+#endif
+
+        // Prometheus scrapes a dedicated port so /metrics never queues behind
+        // OCR requests for an HTTP worker
+        auto metrics_port = static_cast<std::uint16_t>(getEnvSize("METRICS_PORT", 9092));
+        crow::SimpleApp metrics_app;
+        CROW_ROUTE(metrics_app, "/metrics")
+        ([]() {
+            crow::response res(MetricsRegistry::global().serialize());
+            res.set_header("Content-Type", "text/plain; version=0.0.4");
+            return res;
+        });
+        std::thread metrics_thread([&metrics_app, metrics_port]() {
+            metrics_app.signal_clear().port(metrics_port).concurrency(1).run();
+        });
 
         // Create Crow app
         crow::SimpleApp app;
 
-        // Health check endpoint
+        // Liveness: answers as soon as the server is up, warm or not
         CROW_ROUTE(app, "/health")
         ([]() {
+            EnginePoolStats stats = engine_pool->getStats();
+            json languages = json::array();
+            for (const auto& language : stats.languages) {
+                languages.push_back({
+                    {"language", language.language},
+                    {"size", language.size},
+                    {"available", language.available}
+                });
+            }
+            ResultCacheStats cache_stats = result_cache->getStats();
+            JobManagerStats job_stats = job_manager->getStats();
+            bool draining = lifecycle->draining();
             json response = {
-                {"status", "healthy"},
+                {"status", draining ? "draining" : "healthy"},
+                {"ready", stats.ready && !draining},
+                {"in_flight_requests", lifecycle->inFlight()},
                 {"service", "ocr-service"},
-                {"version", "1.0.0"}
+                {"version", "1.0.0"},
+                {"preprocessing_backend", preprocessingBackendName(PreprocessingPipeline::backend())},
+                {"raster_segments", raster_source->mappedSegments()},
+                {"engine_pool", {
+                    {"ready", stats.ready},
+                    {"size", stats.size},
+                    {"available", stats.available},
+                    {"in_use", stats.in_use},
+                    {"waiting", stats.waiting},
+                    {"max_waiters", stats.max_waiters},
+                    {"total_checkouts", stats.total_checkouts},
+                    {"rejected_checkouts", stats.rejected_checkouts},
+                    {"average_wait_ms", stats.average_wait_ms},
+                    {"max_wait_ms", stats.max_wait_ms},
+                    {"languages", languages}
+                }},
+                {"jobs", {
+                    {"queued", job_stats.queued},
+                    {"running", job_stats.running},
+                    {"max_queued", job_stats.max_queued},
+                    {"retained", job_stats.retained},
+                    {"submitted", job_stats.submitted},
+                    {"rejected", job_stats.rejected},
+                    {"completed", job_stats.completed},
+                    {"failed", job_stats.failed}
+                }},
+                {"result_cache", {
+                    {"hits", cache_stats.hits},
+                    {"misses", cache_stats.misses},
+                    {"hit_rate", cache_stats.hit_rate},
+                    {"evictions", cache_stats.evictions},
+                    {"entries", cache_stats.entries},
+                    {"bytes", cache_stats.bytes},
+                    {"max_entries", cache_stats.max_entries},
+                    {"max_bytes", cache_stats.max_bytes}
+                }}
             };
             return crow::response(response.dump());
         });
 
+        // Readiness: only once every engine is loaded and warmed up, so no
+        // traffic is routed here while the first requests would run cold
+        CROW_ROUTE(app, "/ready")
+        ([]() {
+            // A draining instance leaves the Service endpoints before it stops
+            bool ready = engine_pool->ready() && !lifecycle->draining();
+            json response = {{"ready", ready}};
+            return crow::response(ready ? 200 : 503, response.dump());
+        });
+
         // OCR extraction endpoint
         CROW_ROUTE(app, "/api/v1/ocr/extract")
         .methods("POST"_method)
         ([&](const crow::request& req) {
-            return api_handler->handleExtractRequest(req);
+            return admitted([&]() { return api_handler->handleExtractRequest(req); });
         });
 
         // Text extraction endpoint
         CROW_ROUTE(app, "/api/v1/ocr/text")
         .methods("POST"_method)
         ([&](const crow::request& req) {
-            return api_handler->handleTextExtraction(req);
+            return admitted([&]() { return api_handler->handleTextExtraction(req); });
         });
 
         // Document analysis endpoint
         CROW_ROUTE(app, "/api/v1/ocr/analyze")
         .methods("POST"_method)
         ([&](const crow::request& req) {
-            return api_handler->handleDocumentAnalysis(req);
+            return admitted([&]() { return api_handler->handleDocumentAnalysis(req); });
         });
 
         // Batch processing endpoint
         CROW_ROUTE(app, "/api/v1/ocr/batch")
         .methods("POST"_method)
         ([&](const crow::request& req) {
-            return api_handler->handleBatchProcessing(req);
+            return admitted([&]() { return api_handler->handleBatchProcessing(req); });
+        });
+
+        // Asynchronous job endpoints
+        CROW_ROUTE(app, "/api/v1/ocr/jobs")
+        .methods("POST"_method)
+        ([&](const crow::request& req) {
+            return admitted([&]() { return api_handler->handleJobSubmission(req); });
+        });
+
+        CROW_ROUTE(app, "/api/v1/ocr/jobs/<string>")
+        .methods("GET"_method)
+        ([&](const crow::request& req, const std::string& job_id) {
+            return api_handler->handleJobStatus(job_id, req);
+        });
+
+        CROW_ROUTE(app, "/api/v1/ocr/jobs/<string>/results")
+        .methods("GET"_method)
+        ([&](const crow::request& req, const std::string& job_id) {
+            return api_handler->handleJobResults(job_id, req);
         });
 
         // Set up CORS
@@ -86,8 +460,77 @@ int main() {
         });
 
         // Start server
-        std::cout << "Starting OCR Service on port 8002..." << std::endl;
-        app.port(8002).multithreaded().run();
+        // Enough HTTP workers to keep every engine busy, hold the bounded wait
+        // queue, and still answer /health while all engines are checked out
+        auto http_threads = static_cast<std::uint16_t>(engine_pool->size() + max_waiters + 2);
+
+        std::cout << "Starting OCR Service on port 8002 with " << engine_pool->size()
+                  << " OCR engines..." << std::endl;
+        std::cout << "Serving metrics on port " << metrics_port << std::endl;
+
+        // Models load and engines warm up while the server already answers
+        // /health; /ready flips once they are done
+        bool pool_failed = false;
+        std::thread warmup_thread([&app, &pool_failed]() {
+            // Self-checks the accelerated preprocessing backends before any
+            // engine builds its pipeline
+            std::cout << "Preprocessing backend: "
+                      << preprocessingBackendName(PreprocessingPipeline::backend()) << std::endl;
+            if (!engine_pool->initialize()) {
+                std::cerr << "Failed to initialize OCR engine pool" << std::endl;
+                pool_failed = true;
+                app.wait_for_server_start();
+                app.stop();
+            }
+        });
+
+        // On SIGTERM: stop admitting work and drop out of /ready, let
+        // admitted requests, queued jobs and checked-out engines finish,
+        // checkpoint whatever is still queued at the deadline, then stop
+        lifecycle->watch([&](LifecycleManager::Clock::time_point deadline) {
+            job_manager->stopAccepting();
+#ifdef OCR_WITH_GRPC
+            if (grpc_server) {
+                grpc_server->shutdown(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - LifecycleManager::Clock::now()));
+            }
+#endif
+            bool drained = LifecycleManager::waitUntil(deadline, []() {
+                JobManagerStats jobs = job_manager->getStats();
+                return lifecycle->inFlight() == 0 && jobs.queued == 0 && jobs.running == 0 &&
+                       engine_pool->getStats().in_use == 0;
+            });
+            if (!drained) {
+                JobManagerStats jobs = job_manager->getStats();
+                std::cerr << "Drain deadline passed with " << lifecycle->inFlight() << " requests, "
+                          << jobs.queued << " queued and " << jobs.running << " running jobs left" << std::endl;
+                if (!checkpoint_dir.empty()) {
+                    job_manager->checkpointQueued(checkpoint_dir);
+                }
+            }
+            std::cout << "Drain " << (drained ? "complete" : "abandoned") << ", stopping" << std::endl;
+            app.stop();
+        });
+
+        // Crow's own SIGINT/SIGTERM handling would stop the server mid-request
+        app.signal_clear().port(8002).concurrency(http_threads).run();
+
+        lifecycle->cancel();
+        warmup_thread.join();
+#ifdef OCR_WITH_GRPC
+        grpc_server.reset();
+#endif
+        metrics_app.stop();
+        metrics_thread.join();
+        job_manager->stop();
+        // Flush callbacks for jobs that finished during the drain while
+        // libcurl is still initialized
+        webhook_notifier.reset();
+        trace_exporter.reset();
+        WebhookNotifier::globalCleanup();
+        if (pool_failed) {
+            return 1;
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,211 @@
+#include "metrics.h"
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string formatValue(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    return buffer;
+}
+
+std::string joinLabels(const std::string& labels, const std::string& extra) {
+    if (labels.empty()) {
+        return "{" + extra + "}";
+    }
+    return "{" + labels + "," + extra + "}";
+}
+
+const char* typeName(MetricsRegistry::Type type) {
+    switch (type) {
+        case MetricsRegistry::Type::Counter:
+            return "counter";
+        case MetricsRegistry::Type::Gauge:
+            return "gauge";
+        case MetricsRegistry::Type::Histogram:
+            return "histogram";
+    }
+    return "untyped";
+}
+
+}
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Decode:
+            return "decode";
+        case Stage::Enhance:
+            return "enhance";
+        case Stage::Denoise:
+            return "denoise";
+        case Stage::Deskew:
+            return "deskew";
+        case Stage::SetImage:
+            return "set_image";
+        case Stage::Recognize:
+            return "recognize";
+        case Stage::Iterate:
+            return "iterate";
+        case Stage::Serialize:
+            return "serialize";
+        case Stage::Count:
+            break;
+    }
+    return "unknown";
+}
+
+MetricHistogram::MetricHistogram(std::vector<double> bounds, double resolution)
+    : bounds_(std::move(bounds)), resolution_(resolution), buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    for (size_t i = 0; i <= bounds_.size(); i++) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::vector<double> MetricHistogram::latencyBuckets() {
+    return {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0};
+}
+
+std::vector<double> MetricHistogram::byteBuckets() {
+    std::vector<double> bounds;
+    for (double bytes = 64.0 * 1024; bytes <= 1024.0 * 1024 * 1024; bytes *= 4) {
+        bounds.push_back(bytes);
+    }
+    return bounds;
+}
+
+void MetricHistogram::observe(double value) {
+    size_t bucket = 0;
+    while (bucket < bounds_.size() && value > bounds_[bucket]) {
+        bucket++;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_units_.fetch_add(static_cast<uint64_t>(value > 0 ? value / resolution_ : 0), std::memory_order_relaxed);
+}
+
+StageTimer::StageTimer(Stage stage) : StageTimer(MetricsRegistry::global().stage(stage), stageName(stage)) {
+}
+
+StageTimer::StageTimer(MetricHistogram& histogram, const char* span_name)
+    : histogram_(histogram), start_(std::chrono::steady_clock::now()), span_(span_name) {
+}
+
+StageTimer::~StageTimer() {
+    histogram_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::MetricsRegistry() {
+    for (size_t i = 0; i < stages_.size(); i++) {
+        auto stage = static_cast<Stage>(i);
+        stages_[i] = &histogram("ocr_stage_duration_seconds", "Time spent in each OCR pipeline stage",
+                                std::string("stage=\"") + stageName(stage) + "\"");
+    }
+}
+
+MetricsRegistry::Entry& MetricsRegistry::publish(std::unique_ptr<Entry> entry) {
+    std::lock_guard<std::mutex> lock(register_mutex_);
+    size_t index = size_.load(std::memory_order_relaxed);
+    if (index >= kMaxEntries) {
+        throw std::length_error("metrics registry is full");
+    }
+    entries_[index] = std::move(entry);
+    // Release pairs with the acquire in serialize(): a scraper that sees the
+    // new size also sees the fully constructed entry
+    size_.store(index + 1, std::memory_order_release);
+    return *entries_[index];
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    entry->type = Type::Counter;
+    entry->counter = std::make_unique<MetricCounter>();
+    return *publish(std::move(entry)).counter;
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                            const std::string& labels, std::vector<double> bounds,
+                                            double resolution) {
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    entry->type = Type::Histogram;
+    entry->histogram = std::make_unique<MetricHistogram>(std::move(bounds), resolution);
+    return *publish(std::move(entry)).histogram;
+}
+
+void MetricsRegistry::callback(const std::string& name, const std::string& help, Type type,
+                               std::function<double()> read, const std::string& labels) {
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    entry->type = type;
+    entry->read = std::move(read);
+    publish(std::move(entry));
+}
+
+std::string MetricsRegistry::serialize() const {
+    std::ostringstream out;
+    size_t size = size_.load(std::memory_order_acquire);
+
+    // Series of one family may be registered at different times (the gRPC
+    // server's after the REST handlers'), but the text format needs each
+    // family in one block under a single HELP/TYPE: families go out in
+    // first-registered order, each with all of its series
+    std::vector<size_t> order;
+    order.reserve(size);
+    std::vector<char> placed(size, 0);
+    for (size_t i = 0; i < size; i++) {
+        if (placed[i]) {
+            continue;
+        }
+        for (size_t j = i; j < size; j++) {
+            if (!placed[j] && entries_[j]->name == entries_[i]->name) {
+                order.push_back(j);
+                placed[j] = 1;
+            }
+        }
+    }
+
+    const std::string* previous_name = nullptr;
+    for (size_t i : order) {
+        const Entry& entry = *entries_[i];
+        if (!previous_name || *previous_name != entry.name) {
+            out << "# HELP " << entry.name << " " << entry.help << "\n";
+            out << "# TYPE " << entry.name << " " << typeName(entry.type) << "\n";
+            previous_name = &entry.name;
+        }
+
+        std::string labels = entry.labels.empty() ? "" : "{" + entry.labels + "}";
+        if (entry.read) {
+            out << entry.name << labels << " " << formatValue(entry.read()) << "\n";
+        } else if (entry.counter) {
+            out << entry.name << labels << " " << entry.counter->value() << "\n";
+        } else if (entry.histogram) {
+            const MetricHistogram& histogram = *entry.histogram;
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < histogram.bounds().size(); b++) {
+                cumulative += histogram.bucketCount(b);
+                out << entry.name << "_bucket"
+                    << joinLabels(entry.labels, "le=\"" + formatValue(histogram.bounds()[b]) + "\"")
+                    << " " << cumulative << "\n";
+            }
+            cumulative += histogram.bucketCount(histogram.bounds().size());
+            out << entry.name << "_bucket" << joinLabels(entry.labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+            out << entry.name << "_sum" << labels << " " << formatValue(histogram.sum()) << "\n";
+            out << entry.name << "_count" << labels << " " << cumulative << "\n";
+        }
+    }
+    return out.str();
+}
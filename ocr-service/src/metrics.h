@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tracing.h"
+
+// Pipeline stages timed into ocr_stage_duration_seconds{stage="..."}
+enum class Stage {
+    Decode,
+    Enhance,
+    Denoise,
+    Deskew,
+    SetImage,   // Mat -> Tesseract's internal Pix copy
+    Recognize,
+    Iterate,    // result walk / text extraction after recognition
+    Serialize,  // response JSON
+    Count
+};
+
+const char* stageName(Stage stage);
+
+class MetricCounter {
+public:
+    void inc(uint64_t amount = 1) { value_.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Fixed-bucket histogram. observe() is a handful of relaxed atomic adds, so
+// hot paths can record without a lock; the sum is kept as an integral count
+// of resolution-sized units (nanoseconds for latencies).
+class MetricHistogram {
+public:
+    explicit MetricHistogram(std::vector<double> bounds, double resolution = 1e-9);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    uint64_t bucketCount(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_units_.load(std::memory_order_relaxed) * resolution_; }
+
+    // 0.5 ms .. 30 s, spanning a cached hit up to a large multi-page scan
+    static std::vector<double> latencyBuckets();
+    // 64 KiB .. 1 GiB, from a thumbnail up to a 600 dpi colour page with copies
+    static std::vector<double> byteBuckets();
+
+private:
+    std::vector<double> bounds_;
+    double resolution_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;  // per bound, plus +Inf
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_units_{0};
+};
+
+// Records the lifetime of the timer into a histogram, and into the request's
+// trace as a span when it is named
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage);
+    explicit StageTimer(MetricHistogram& histogram, const char* span_name = nullptr);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    MetricHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+    TraceSpan span_;
+};
+
+// Process-wide metric set exposed in the Prometheus text format. Metrics are
+// registered up front and never removed; entries are published into a
+// fixed-size table with an atomic count, so recording and scraping never
+// take a lock. Only registration itself is serialized.
+class MetricsRegistry {
+public:
+    enum class Type {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    static MetricsRegistry& global();
+
+    // labels is the rendered label set without braces, e.g. endpoint="extract"
+    MetricCounter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    MetricHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                               std::vector<double> bounds = MetricHistogram::latencyBuckets(),
+                               double resolution = 1e-9);
+
+    // Value computed at scrape time, for state other components already track
+    void callback(const std::string& name, const std::string& help, Type type, std::function<double()> read,
+                  const std::string& labels = "");
+
+    MetricHistogram& stage(Stage stage) { return *stages_[static_cast<size_t>(stage)]; }
+
+    std::string serialize() const;
+
+private:
+    MetricsRegistry();
+
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::string labels;
+        Type type;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricHistogram> histogram;
+        std::function<double()> read;
+    };
+
+    static constexpr size_t kMaxEntries = 256;
+
+    Entry& publish(std::unique_ptr<Entry> entry);
+
+    std::array<std::unique_ptr<Entry>, kMaxEntries> entries_;
+    std::atomic<size_t> size_{0};
+    std::mutex register_mutex_;
+    std::array<MetricHistogram*, static_cast<size_t>(Stage::Count)> stages_{};
+};
@@ -1,10 +1,38 @@
 #include "ocr_engine.h"
+#include "metrics.h"
+#include "tracing.h"
 #include <iostream>
 #include <algorithm>
-#include <regex>
+#include <cctype>
+
+namespace {
+
+// Long side of the fast pass; an A4 page at 300 DPI comes down to roughly
+// 150 DPI, still comfortably above the text sizes Tesseract reads reliably
+const double kFastPassMaxSide = 1800.0;
+
+cv::Rect scaleRect(const cv::Rect& rect, double factor) {
+    return cv::Rect(static_cast<int>(rect.x * factor), static_cast<int>(rect.y * factor),
+                    static_cast<int>(rect.width * factor + 0.5), static_cast<int>(rect.height * factor + 0.5));
+}
+
+}
+
+OCREngine::AdaptiveCounters& OCREngine::adaptiveCounters() {
+    static AdaptiveCounters counters{
+        MetricsRegistry::global().counter("ocr_adaptive_pages_total", "Pages by adaptive recognition path",
+                                          "path=\"fast\""),
+        MetricsRegistry::global().counter("ocr_adaptive_pages_total", "Pages by adaptive recognition path",
+                                          "path=\"lines\""),
+        MetricsRegistry::global().counter("ocr_adaptive_pages_total", "Pages by adaptive recognition path",
+                                          "path=\"full\"")
+    };
+    return counters;
+}
 
 OCREngine::OCREngine() 
-    : language_("eng"), confidence_threshold_(60.0), preprocessing_enabled_(true), initialized_(false) {
+    : field_extractor_(FieldExtractor::builtin()),
+      language_("eng"), initialized_(false), applied_page_seg_mode_(tesseract::PSM_AUTO) {
 }
 
 OCREngine::~OCREngine() {
@@ -12,21 +40,32 @@ OCREngine::~OCREngine() {
 }
 
 bool OCREngine::initialize() {
+    return initialize(language_, nullptr);
+}
+
+bool OCREngine::initialize(const std::string& language, const std::shared_ptr<const std::string>& traineddata) {
     try {
+        language_ = language;
         tess_api_ = std::make_unique<tesseract::TessBaseAPI>();
         
-        // Initialize Tesseract with English language
-        if (tess_api_->Init(nullptr, language_.c_str())) {
-            std::cerr << "Failed to initialize Tesseract" << std::endl;
+        // Parsing the model from memory skips the tessdata lookup and file read
+        int status = traineddata
+            ? tess_api_->Init(traineddata->data(), static_cast<int>(traineddata->size()), language_.c_str(),
+                              tesseract::OEM_DEFAULT, nullptr, 0, nullptr, nullptr, false, nullptr)
+            : tess_api_->Init(nullptr, language_.c_str());
+        if (status) {
+            std::cerr << "Failed to initialize Tesseract for language " << language_ << std::endl;
             return false;
         }
         
-        // Set OCR parameters
-        tess_api_->SetPageSegMode(tesseract::PSM_AUTO);
-        tess_api_->SetVariable("tessedit_char_whitelist", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz.,!?@#$%&*()_+-=[]{}|;:'\"<>/\\ ");
+        // Start from the default options; requests change them only as needed
+        OCROptions defaults;
+        applied_page_seg_mode_ = defaults.page_seg_mode;
+        applied_char_whitelist_ = defaults.char_whitelist;
+        tess_api_->SetPageSegMode(applied_page_seg_mode_);
+        tess_api_->SetVariable("tessedit_char_whitelist", applied_char_whitelist_.c_str());
         
         initialized_ = true;
-        std::cout << "OCR Engine initialized successfully" << std::endl;
         return true;
         
     } catch (const std::exception& e) {
@@ -35,6 +74,22 @@ bool OCREngine::initialize() {
     }
 }
 
+bool OCREngine::warmUp() {
+    if (!initialized_) {
+        return false;
+    }
+    
+    cv::Mat sample(64, 320, CV_8UC1, cv::Scalar(255));
+    cv::putText(sample, "Warm up 0123", cv::Point(8, 44), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0), 2);
+    
+    OCROptions options;
+    options.preprocessing = PreprocessingOptions::none();
+    options.detail = ResultDetail::Text;
+    options.adaptive = false;
+    extractTextFromMat(sample, options);
+    return true;
+}
+
 void OCREngine::cleanup() {
     if (tess_api_) {
         tess_api_->End();
@@ -44,84 +99,261 @@ void OCREngine::cleanup() {
 }
 
 OCRResult OCREngine::extractText(const std::string& image_path) {
-    cv::Mat image = cv::imread(image_path);
+    return extractText(image_path, OCROptions{});
+}
+
+OCRResult OCREngine::extractText(const std::string& image_path, const OCROptions& options) {
+    cv::Mat image = decodeImageFile(image_path, options.decode);
     if (image.empty()) {
         std::cerr << "Failed to load image: " << image_path << std::endl;
         return OCRResult{};
     }
     
-    return extractTextFromMat(image);
+    return extractTextFromMat(image, options);
+}
+
+OCRResult OCREngine::extractTextFromBuffer(std::string_view buffer, const OCROptions& options) {
+    cv::Mat image = decodeImageBuffer(buffer, options.decode);
+    if (image.empty()) {
+        std::cerr << "Failed to decode image buffer of " << buffer.size() << " bytes" << std::endl;
+        return OCRResult{};
+    }
+    
+    return extractTextFromMat(image, options);
 }
 
 OCRResult OCREngine::extractTextFromMat(const cv::Mat& image) {
+    return extractTextFromMat(image, OCROptions{});
+}
+
+OCRResult OCREngine::extractTextFromMat(const cv::Mat& image, const OCROptions& options) {
     if (!initialized_) {
         std::cerr << "OCR Engine not initialized" << std::endl;
         return OCRResult{};
     }
+    // Switching languages means reloading the model; that is the pool's job
+    if (!options.language.empty() && options.language != language_) {
+        std::cerr << "OCR engine for " << language_ << " asked to recognize " << options.language << std::endl;
+        return OCRResult{};
+    }
     
-    OCRResult result;
+    TraceSpan span("ocr.extract");
+    span.annotate("image.width", image.cols);
+    span.annotate("image.height", image.rows);
+    OCRResult result = options.adaptive ? recognizeAdaptive(image, options) : recognizeImage(image, options);
+    span.annotate("ocr.mean_text_conf", result.confidence);
+    span.annotate("ocr.word_count", static_cast<double>(result.word_count));
+    return result;
+}
+
+OCRResult OCREngine::recognizeAdaptive(const cv::Mat& image, const OCROptions& options) {
+    OCROptions full = options;
+    full.adaptive = false;
     
-    try {
-        cv::Mat processed_image = image.clone();
-        
-        if (preprocessing_enabled_) {
-            processed_image = preprocessImage(processed_image);
+    // Fast pass: no preprocessing, long side capped, with enough layout to
+    // tell which lines need another look
+    double scale = std::min(1.0, kFastPassMaxSide / static_cast<double>(std::max(image.cols, image.rows)));
+    if (scale == 1.0 && !options.preprocessing.any()) {
+        // The fast pass would be the full path; nothing to adapt
+        return recognizeImage(image, full);
+    }
+    cv::Mat fast_image = image;
+    if (scale < 1.0) {
+        cv::resize(image, fast_image, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+    OCROptions fast = full;
+    fast.preprocessing = PreprocessingOptions::none();
+    fast.detail = ResultDetail::Layout;
+    if (fast.dpi > 0) {
+        fast.dpi = std::max(70, static_cast<int>(fast.dpi * scale));
+    }
+    OCRResult first = recognizeImage(fast_image, fast);
+    
+    size_t line_count = first.line_boxes.size();
+    std::vector<double> line_confidence_sum(line_count, 0.0);
+    std::vector<size_t> line_words(line_count, 0);
+    std::vector<char> weak(line_count, 0);
+    size_t weak_lines = 0;
+    for (size_t i = 0; i < first.storedWords(); i++) {
+        int line = first.word_line_ids[i];
+        if (line < 0 || static_cast<size_t>(line) >= line_count) {
+            continue;
+        }
+        line_confidence_sum[line] += first.word_confidences[i];
+        line_words[line]++;
+        if (first.word_confidences[i] < options.confidence_threshold && !weak[line]) {
+            weak[line] = 1;
+            weak_lines++;
+        }
+    }
+    
+    // A page that is poor overall, or mostly weak lines, is cheaper to redo
+    // in one piece than line by line
+    AdaptiveCounters& counters = adaptiveCounters();
+    if (first.word_count == 0 || first.confidence < options.confidence_threshold || weak_lines * 2 > line_count) {
+        counters.full.inc();
+        return recognizeImage(image, full);
+    }
+    
+    if (scale < 1.0) {
+        for (auto& box : first.bounding_boxes) {
+            box = scaleRect(box, 1.0 / scale);
+        }
+        for (auto& box : first.line_boxes) {
+            box = scaleRect(box, 1.0 / scale);
+        }
+    }
+    if (weak_lines == 0) {
+        counters.fast.inc();
+        trimDetail(first, options.detail);
+        return first;
+    }
+    
+    // Second pass over the weak lines only, at full resolution with the
+    // requested preprocessing. Deskew is left to the page-level path: a
+    // single line crop carries too little to estimate an angle from.
+    counters.lines.inc();
+    OCROptions region = full;
+    region.page_seg_mode = tesseract::PSM_SINGLE_LINE;
+    region.detail = ResultDetail::WordBoxes;
+    region.preprocessing.deskew = false;
+    
+    cv::Rect page_rect(0, 0, image.cols, image.rows);
+    std::vector<OCRResult> redone(line_count);
+    std::vector<char> replaced(line_count, 0);
+    for (size_t line = 0; line < line_count; line++) {
+        if (!weak[line]) {
+            continue;
+        }
+        const cv::Rect& line_box = first.line_boxes[line];
+        int pad_x = line_box.height;
+        int pad_y = line_box.height / 4;
+        cv::Rect crop = cv::Rect(line_box.x - pad_x, line_box.y - pad_y,
+                                 line_box.width + 2 * pad_x, line_box.height + 2 * pad_y) & page_rect;
+        if (crop.area() == 0) {
+            continue;
         }
         
-        // Convert to Pix for Tesseract
-        cv::Mat gray;
-        cv::cvtColor(processed_image, gray, cv::COLOR_BGR2GRAY);
-        
-        // Create Pix from OpenCV Mat
-        Pix* pix = pixCreate(gray.cols, gray.rows, 8);
-        if (!pix) {
-            std::cerr << "Failed to create Pix" << std::endl;
-            return result;
+        OCRResult attempt = recognizeImage(image(crop), region);
+        double line_confidence = line_words[line] > 0 ? line_confidence_sum[line] / line_words[line] : 0.0;
+        if (attempt.word_count == 0 || attempt.confidence <= line_confidence) {
+            continue;
+        }
+        for (auto& box : attempt.bounding_boxes) {
+            box += crop.tl();
+        }
+        redone[line] = std::move(attempt);
+        replaced[line] = 1;
+    }
+    
+    OCRResult merged = mergeLines(first, redone, replaced);
+    trimDetail(merged, options.detail);
+    return merged;
+}
+
+OCRResult OCREngine::mergeLines(const OCRResult& page, const std::vector<OCRResult>& redone,
+                                const std::vector<char>& replaced) {
+    // Rebuilt line by line with collectWords' separators (a newline per line,
+    // a blank line after each paragraph), with redone lines swapped in for
+    // the page's own words
+    OCRResult merged{};
+    merged.line_boxes = page.line_boxes;
+    merged.line_block_ids = page.line_block_ids;
+    merged.line_paragraph_ids = page.line_paragraph_ids;
+    
+    int confidence_sum = 0;
+    size_t word = 0;
+    int previous_paragraph = -1;
+    for (size_t line = 0; line < page.line_boxes.size(); line++) {
+        size_t begin = word;
+        while (word < page.storedWords() && page.word_line_ids[word] == static_cast<int>(line)) {
+            word++;
         }
         
-        // Copy data from Mat to Pix
-        l_uint32* data = pixGetData(pix);
-        int wpl = pixGetWpl(pix);
-        for (int y = 0; y < gray.rows; y++) {
-            for (int x = 0; x < gray.cols; x++) {
-                SET_DATA_BYTE(data + y * wpl, x, gray.at<uchar>(y, x));
-            }
+        const OCRResult& source = replaced[line] ? redone[line] : page;
+        size_t from = replaced[line] ? 0 : begin;
+        size_t to = replaced[line] ? source.storedWords() : word;
+        if (from == to) {
+            continue;
         }
         
-        // Set image for OCR
-        tess_api_->SetImage(pix);
+        int paragraph = page.line_paragraph_ids[line];
+        if (previous_paragraph >= 0 && paragraph != previous_paragraph) {
+            merged.text += '\n';
+        }
+        previous_paragraph = paragraph;
         
-        // Get text
-        char* text = tess_api_->GetUTF8Text();
-        if (text) {
-            result.text = std::string(text);
-            delete[] text;
+        for (size_t i = from; i < to; i++) {
+            merged.appendWord(source.word(i), source.word_confidences[i]);
+            merged.text += i + 1 < to ? ' ' : '\n';
+            merged.bounding_boxes.push_back(source.bounding_boxes[i]);
+            merged.word_line_ids.push_back(static_cast<int>(line));
+            confidence_sum += static_cast<int>(source.word_confidences[i]);
         }
+    }
+    
+    if (previous_paragraph >= 0) {
+        merged.text += '\n';
+    }
+    
+    merged.word_count = merged.storedWords();
+    merged.confidence = merged.word_count > 0 ? confidence_sum / static_cast<int>(merged.word_count) : 0;
+    return merged;
+}
+
+void OCREngine::trimDetail(OCRResult& result, ResultDetail detail) {
+    if (detail != ResultDetail::Layout) {
+        result.word_line_ids.clear();
+        result.line_boxes.clear();
+        result.line_block_ids.clear();
+        result.line_paragraph_ids.clear();
+    }
+    if (detail == ResultDetail::Text || detail == ResultDetail::Words) {
+        result.bounding_boxes.clear();
+    }
+    if (detail == ResultDetail::Text) {
+        result.word_spans.clear();
+        result.word_confidences.clear();
+    }
+}
+
+OCRResult OCREngine::recognizeImage(const cv::Mat& image, const OCROptions& options) {
+    OCRResult result{};
+    
+    try {
+        // The pipeline works in its own reused buffers, so the caller's frame
+        // is only read, never cloned
+        const cv::Mat& processed_image = options.preprocessing.any()
+            ? preprocessing_pipeline_.run(image, options.preprocessing)
+            : image;
         
-        // Get confidence
-        result.confidence = tess_api_->MeanTextConf();
+        // Preprocessed frames and grayscale-decoded files are already single
+        // channel; only caller-supplied colour Mats need converting
+        cv::Mat gray;
+        if (processed_image.channels() == 3) {
+            cv::cvtColor(processed_image, gray, cv::COLOR_BGR2GRAY);
+        } else if (processed_image.channels() == 4) {
+            cv::cvtColor(processed_image, gray, cv::COLOR_BGRA2GRAY);
+        } else {
+            gray = processed_image;
+        }
         
-        // Get word-level information
-        tesseract::ResultIterator* ri = tess_api_->GetIterator();
-        if (ri) {
-            do {
-                const char* word = ri->GetUTF8Text(tesseract::RIL_WORD);
-                if (word) {
-                    result.words.push_back(std::string(word));
-                    result.word_confidences.push_back(ri->Confidence(tesseract::RIL_WORD));
-                    
-                    // Get bounding box
-                    int left, top, right, bottom;
-                    ri->BoundingBox(tesseract::RIL_WORD, &left, &top, &right, &bottom);
-                    result.bounding_boxes.push_back(cv::Rect(left, top, right - left, bottom - top));
-                    
-                    delete[] word;
-                }
-            } while (ri->Next(tesseract::RIL_WORD));
-            delete ri;
+        // Hand the 8-bit buffer to Tesseract directly; passing the row stride
+        // lets it read padded rows and ROI views without an intermediate Pix
+        applyOptions(options);
+        {
+            StageTimer timer(Stage::SetImage);
+            tess_api_->SetImage(gray.data, gray.cols, gray.rows, 1, static_cast<int>(gray.step));
+            if (options.dpi > 0) {
+                tess_api_->SetSourceResolution(options.dpi);
+            }
         }
         
-        pixDestroy(&pix);
+        if (options.detail == ResultDetail::Text) {
+            collectText(result);
+        } else {
+            collectWords(result, options.detail);
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error during OCR: " << e.what() << std::endl;
@@ -130,166 +362,283 @@ OCRResult OCREngine::extractTextFromMat(const cv::Mat& image) {
     return result;
 }
 
+void OCREngine::applyOptions(const OCROptions& options) {
+    if (options.page_seg_mode != applied_page_seg_mode_) {
+        tess_api_->SetPageSegMode(options.page_seg_mode);
+        applied_page_seg_mode_ = options.page_seg_mode;
+    }
+    if (options.char_whitelist != applied_char_whitelist_) {
+        tess_api_->SetVariable("tessedit_char_whitelist", options.char_whitelist.c_str());
+        applied_char_whitelist_ = options.char_whitelist;
+    }
+}
+
+void OCREngine::collectText(OCRResult& result) {
+    // Text-only callers never look at words, so skip the iterator walk.
+    // Recognize explicitly (GetUTF8Text would do it implicitly) so the two
+    // costs are timed separately.
+    {
+        StageTimer timer(Stage::Recognize);
+        if (tess_api_->Recognize(nullptr) != 0) {
+            std::cerr << "Tesseract recognition failed" << std::endl;
+            return;
+        }
+    }
+    
+    StageTimer timer(Stage::Iterate);
+    char* text = tess_api_->GetUTF8Text();
+    if (text) {
+        result.text = std::string(text);
+        delete[] text;
+    }
+    
+    result.confidence = tess_api_->MeanTextConf();
+    
+    bool in_word = false;
+    for (char c : result.text) {
+        bool space = c == ' ' || c == '\n' || c == '\t' || c == '\r';
+        if (!space && !in_word) {
+            result.word_count++;
+        }
+        in_word = !space;
+    }
+}
+
+void OCREngine::collectWords(OCRResult& result, ResultDetail detail) {
+    // Recognize once and walk the result a single time; the page text is
+    // rebuilt from the words with the same separators GetUTF8Text emits
+    // (space between words, newline per line, blank line per paragraph)
+    {
+        StageTimer timer(Stage::Recognize);
+        if (tess_api_->Recognize(nullptr) != 0) {
+            std::cerr << "Tesseract recognition failed" << std::endl;
+            return;
+        }
+    }
+    
+    StageTimer timer(Stage::Iterate);
+    std::unique_ptr<tesseract::ResultIterator> ri(tess_api_->GetIterator());
+    if (!ri) {
+        return;
+    }
+    
+    bool want_boxes = detail == ResultDetail::WordBoxes || detail == ResultDetail::Layout;
+    bool want_layout = detail == ResultDetail::Layout;
+    int confidence_sum = 0;
+    int line = -1;
+    int block = -1;
+    int paragraph = -1;
+    
+    do {
+        if (want_layout) {
+            if (ri->IsAtBeginningOf(tesseract::RIL_BLOCK)) {
+                block++;
+            }
+            if (ri->IsAtBeginningOf(tesseract::RIL_PARA)) {
+                paragraph++;
+            }
+            if (ri->IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
+                line++;
+                int left, top, right, bottom;
+                ri->BoundingBox(tesseract::RIL_TEXTLINE, &left, &top, &right, &bottom);
+                result.line_boxes.push_back(cv::Rect(left, top, right - left, bottom - top));
+                result.line_block_ids.push_back(block);
+                result.line_paragraph_ids.push_back(paragraph);
+            }
+        }
+        
+        std::unique_ptr<char[]> word(ri->GetUTF8Text(tesseract::RIL_WORD));
+        if (!word) {
+            continue;
+        }
+        
+        float confidence = ri->Confidence(tesseract::RIL_WORD);
+        
+        result.appendWord(word.get(), confidence);
+        if (ri->IsAtFinalElement(tesseract::RIL_TEXTLINE, tesseract::RIL_WORD)) {
+            result.text += '\n';
+            if (ri->IsAtFinalElement(tesseract::RIL_PARA, tesseract::RIL_WORD)) {
+                result.text += '\n';
+            }
+        } else {
+            result.text += ' ';
+        }
+        
+        if (want_boxes) {
+            int left, top, right, bottom;
+            ri->BoundingBox(tesseract::RIL_WORD, &left, &top, &right, &bottom);
+            result.bounding_boxes.push_back(cv::Rect(left, top, right - left, bottom - top));
+        }
+        if (want_layout) {
+            result.word_line_ids.push_back(line);
+        }
+        
+        // MeanTextConf() truncates each word confidence before averaging
+        confidence_sum += static_cast<int>(confidence);
+    } while (ri->Next(tesseract::RIL_WORD));
+    
+    result.word_count = result.storedWords();
+    result.confidence = result.word_count > 0 ? confidence_sum / static_cast<int>(result.word_count) : 0;
+}
+
 DocumentInfo OCREngine::analyzeDocument(const std::string& image_path) {
-    cv::Mat image = cv::imread(image_path);
+    return analyzeDocument(image_path, OCROptions{});
+}
+
+DocumentInfo OCREngine::analyzeDocument(const std::string& image_path, const OCROptions& options) {
+    cv::Mat image = decodeImageFile(image_path, options.decode);
     if (image.empty()) {
         std::cerr << "Failed to load image: " << image_path << std::endl;
         return DocumentInfo{};
     }
     
-    return analyzeDocumentFromMat(image);
+    return analyzeDocumentFromMat(image, options);
+}
+
+DocumentInfo OCREngine::analyzeDocumentFromBuffer(std::string_view buffer, const OCROptions& options) {
+    cv::Mat image = decodeImageBuffer(buffer, options.decode);
+    if (image.empty()) {
+        std::cerr << "Failed to decode image buffer of " << buffer.size() << " bytes" << std::endl;
+        return DocumentInfo{};
+    }
+    
+    return analyzeDocumentFromMat(image, options);
 }
 
 DocumentInfo OCREngine::analyzeDocumentFromMat(const cv::Mat& image) {
+    return analyzeDocumentFromMat(image, OCROptions{});
+}
+
+DocumentInfo OCREngine::analyzeDocumentFromMat(const cv::Mat& image, const OCROptions& options) {
     DocumentInfo info;
+    TraceSpan span("ocr.analyze");
+    span.annotate("image.width", image.cols);
+    span.annotate("image.height", image.rows);
     
-    // Extract text first
-    OCRResult ocr_result = extractTextFromMat(image);
+    // A known layout only needs its field regions read; tables need the
+    // whole page regardless
+    bool templates = template_registry_ && template_registry_->enabled() && !options.tables;
+    LayoutFingerprint fingerprint;
+    if (templates) {
+        std::shared_ptr<const DocumentTemplate> known;
+        {
+            TraceSpan match_span("template.match");
+            fingerprint = LayoutFingerprint::compute(image);
+            known = template_registry_->match(fingerprint, language_);
+            match_span.annotate("template.matched", known ? 1 : 0);
+        }
+        if (known) {
+            if (analyzeFromTemplate(image, fingerprint, *known, options, info)) {
+                span.annotate("ocr.mean_text_conf", info.overall_confidence);
+                return info;
+            }
+            template_registry_->fallback(known->id);
+            info = DocumentInfo{};
+        }
+    }
+    
+    // Extract text first; field extraction never needs the word walk, but
+    // tables are rebuilt from the word boxes and templates learned from them
+    OCROptions text_options = options;
+    text_options.detail = options.tables || templates ? ResultDetail::WordBoxes : ResultDetail::Text;
+    OCRResult ocr_result = extractTextFromMat(image, text_options);
     
     if (ocr_result.text.empty()) {
         return info;
     }
     
-    // Simple document type detection
-    std::string text_lower = ocr_result.text;
-    std::transform(text_lower.begin(), text_lower.end(), text_lower.begin(), ::tolower);
-    
-    if (text_lower.find("invoice") != std::string::npos || 
-        text_lower.find("bill") != std::string::npos) {
-        info.document_type = "invoice";
-    } else if (text_lower.find("receipt") != std::string::npos) {
-        info.document_type = "receipt";
-    } else if (text_lower.find("contract") != std::string::npos || 
-               text_lower.find("agreement") != std::string::npos) {
-        info.document_type = "contract";
-    } else if (text_lower.find("financial") != std::string::npos || 
-               text_lower.find("report") != std::string::npos) {
-        info.document_type = "financial_report";
-    } else {
-        info.document_type = "unknown";
-    }
-    
-    // Extract common fields
-    std::vector<std::string> fields = {"date", "amount", "total", "name", "address", "phone", "email"};
-    for (const auto& field : fields) {
-        std::regex pattern(field + "\\s*[:=]\\s*([^\\n]+)", std::regex_constants::icase);
-        std::smatch match;
-        if (std::regex_search(ocr_result.text, match, pattern)) {
-            info.extracted_data[field] = match[1].str();
-            info.detected_fields.push_back(field);
-        }
+    // Document type detection and field capture share one pass over the text
+    std::vector<FieldLocation> locations;
+    {
+        TraceSpan fields_span("fields");
+        field_extractor_->analyze(ocr_result.text, info, templates ? &locations : nullptr);
+    }
+    if (options.tables) {
+        TraceSpan tables_span("tables");
+        info.tables = extractTables(ocr_result);
+        tables_span.annotate("tables.count", static_cast<double>(info.tables.size()));
+    }
+    if (templates) {
+        template_registry_->learn(fingerprint, language_, ocr_result, info, locations);
     }
     
     info.overall_confidence = ocr_result.confidence;
+    span.annotate("ocr.mean_text_conf", info.overall_confidence);
     
     return info;
 }
 
+bool OCREngine::analyzeFromTemplate(const cv::Mat& image, const LayoutFingerprint& fingerprint,
+                                    const DocumentTemplate& known, const OCROptions& options, DocumentInfo& info) {
+    // Each region is one line of a value, so read it like the adaptive pass
+    // reads a weak line: single-line segmentation and no deskew
+    OCROptions field_options = options;
+    field_options.page_seg_mode = tesseract::PSM_SINGLE_LINE;
+    field_options.detail = ResultDetail::Text;
+    field_options.adaptive = false;
+    field_options.preprocessing.deskew = false;
+    
+    TraceSpan span("template.read");
+    span.annotate("template.fields", static_cast<double>(known.fields.size()));
+    cv::Rect page_rect(0, 0, image.cols, image.rows);
+    double confidence_sum = 0.0;
+    for (const auto& field : known.fields) {
+        cv::Rect crop = DocumentTemplate::locate(field, fingerprint.content) & page_rect;
+        if (crop.area() == 0) {
+            return false;
+        }
+        field_options.char_whitelist = field.numeric ? TemplateRegistry::numericWhitelist() : options.char_whitelist;
+        OCRResult read = extractTextFromMat(image(crop), field_options);
+        
+        std::string_view value = read.text;
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+            value.remove_suffix(1);
+        }
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+            value.remove_prefix(1);
+        }
+        if (value.empty() || read.confidence < options.confidence_threshold ||
+            !TemplateRegistry::plausible(field, value)) {
+            return false;
+        }
+        info.extracted_data[field.name] = std::string(value);
+        info.detected_fields.push_back(field.name);
+        confidence_sum += read.confidence;
+    }
+    
+    info.document_type = known.document_type;
+    info.overall_confidence = confidence_sum / known.fields.size();
+    return true;
+}
+
 std::vector<OCRResult> OCREngine::processBatch(const std::vector<std::string>& image_paths) {
+    return processBatch(image_paths, OCROptions{});
+}
+
+std::vector<OCRResult> OCREngine::processBatch(const std::vector<std::string>& image_paths,
+                                               const OCROptions& options) {
     std::vector<OCRResult> results;
     results.reserve(image_paths.size());
     
     for (const auto& path : image_paths) {
-        results.push_back(extractText(path));
+        results.push_back(extractText(path, options));
     }
     
     return results;
 }
 
-void OCREngine::setLanguage(const std::string& language) {
-    language_ = language;
-    if (initialized_) {
-        // Reinitialize with new language
-        cleanup();
-        initialize();
-    }
+void OCREngine::setFieldExtractor(std::shared_ptr<const FieldExtractor> field_extractor) {
+    field_extractor_ = std::move(field_extractor);
 }
 
-void OCREngine::setConfidenceThreshold(double threshold) {
-    confidence_threshold_ = threshold;
-}
-
-void OCREngine::enablePreprocessing(bool enable) {
-    preprocessing_enabled_ = enable;
-}
-
-cv::Mat OCREngine::preprocessImage(const cv::Mat& input) {
-    cv::Mat processed = input.clone();
-    
-    // Convert to grayscale if needed
-    if (processed.channels() > 1) {
-        cv::cvtColor(processed, processed, cv::COLOR_BGR2GRAY);
-    }
-    
-    // Apply preprocessing steps
-    processed = enhanceImage(processed);
-    processed = removeNoise(processed);
-    processed = deskewImage(processed);
-    
-    return processed;
+void OCREngine::setTemplateRegistry(std::shared_ptr<TemplateRegistry> template_registry) {
+    template_registry_ = std::move(template_registry);
 }
 
-cv::Mat OCREngine::enhanceImage(const cv::Mat& input) {
-    cv::Mat enhanced = input.clone();
-    
-    // Apply histogram equalization
-    cv::equalizeHist(enhanced, enhanced);
-    
-    // Apply adaptive threshold
-    cv::adaptiveThreshold(enhanced, enhanced, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, 11, 2);
-    
-    return enhanced;
+std::string OCREngine::configKey() const {
+    return configKey(language_, *field_extractor_);
 }
 
-cv::Mat OCREngine::removeNoise(const cv::Mat& input) {
-    cv::Mat denoised = input.clone();
-    
-    // Apply Gaussian blur to reduce noise
-    cv::GaussianBlur(denoised, denoised, cv::Size(3, 3), 0);
-    
-    // Apply morphological operations
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2));
-    cv::morphologyEx(denoised, denoised, cv::MORPH_CLOSE, kernel);
-    
-    return denoised;
+std::string OCREngine::configKey(const std::string& language, const FieldExtractor& field_extractor) {
+    return language + "|fields=" + field_extractor.fingerprint();
 }
-
-cv::Mat OCREngine::deskewImage(const cv::Mat& input) {
-    cv::Mat deskewed = input.clone();
-    
-    // Find contours
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(deskewed, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-    
-    if (contours.empty()) {
-        return deskewed;
-    }
-    
-    // Find the largest contour (assumed to be the main text area)
-    auto max_contour = std::max_element(contours.begin(), contours.end(),
-        [](const std::vector<cv::Point>& a, const std::vector<cv::Point>& b) {
-            return cv::contourArea(a) < cv::contourArea(b);
-        });
-    
-    if (max_contour == contours.end()) {
-        return deskewed;
-    }
-    
-    // Fit a rotated rectangle
-    cv::RotatedRect rect = cv::minAreaRect(*max_contour);
-    double angle = rect.angle;
-    
-    // Adjust angle
-    if (angle < -45) {
-        angle = 90 + angle;
-    }
-    
-    // Rotate image if angle is significant
-    if (std::abs(angle) > 0.5) {
-        cv::Point2f center(deskewed.cols / 2.0f, deskewed.rows / 2.0f);
-        cv::Mat rotation_matrix = cv::getRotationMatrix2D(center, angle, 1.0);
-        cv::warpAffine(deskewed, deskewed, rotation_matrix, deskewed.size());
-    }
-    
-    return deskewed;
-} 
\ No newline at end of file
@@ -1,18 +1,60 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <opencv2/opencv.hpp>
 #include <tesseract/baseapi.h>
 #include <leptonica/allheaders.h>
+#include "preprocessing_pipeline.h"
+#include "image_decoder.h"
+#include "field_extractor.h"
+#include "ocr_options.h"
+#include "metrics.h"
+#include "table_extractor.h"
+#include "template_registry.h"
 
+// Where one word's UTF-8 bytes sit in OCRResult::text
+struct TextSpan {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Words are a column-wise table, indexed by word. Their text is not stored
+// per word: the page text is built from the words, so each word is a span
+// of it, and a 2,000-word page costs one string instead of 2,000. Columns a
+// detail level does not ask for stay empty.
 struct OCRResult {
     std::string text;
     double confidence;
+    size_t word_count;
+    
+    // Words detail and up
+    std::vector<TextSpan> word_spans;
+    std::vector<float> word_confidences;   // 0..100, as Tesseract reports them
+    // WordBoxes detail and up
     std::vector<cv::Rect> bounding_boxes;
-    std::vector<std::string> words;
-    std::vector<double> word_confidences;
+    
+    // Layout detail only
+    std::vector<int32_t> word_line_ids;
+    std::vector<cv::Rect> line_boxes;    // per line
+    std::vector<int32_t> line_block_ids;  // per line
+    std::vector<int32_t> line_paragraph_ids;  // per line; paragraphs never span blocks
+    
+    size_t storedWords() const { return word_spans.size(); }
+    // Valid until text is next modified
+    std::string_view word(size_t index) const {
+        const TextSpan& span = word_spans[index];
+        return std::string_view(text).substr(span.offset, span.length);
+    }
+    // Appends word to text, without a separator, and records its span
+    void appendWord(std::string_view word, float confidence) {
+        word_spans.push_back({static_cast<uint32_t>(text.size()), static_cast<uint32_t>(word.size())});
+        word_confidences.push_back(confidence);
+        text += word;
+    }
 };
 
 struct DocumentInfo {
@@ -20,6 +62,7 @@ struct DocumentInfo {
     std::vector<std::string> detected_fields;
     std::map<std::string, std::string> extracted_data;
     double overall_confidence;
+    std::vector<ExtractedTable> tables;  // only when OCROptions::tables is set
 };
 
 class OCREngine {
@@ -28,33 +71,80 @@ public:
     ~OCREngine();
 
     bool initialize();
+    // Initializes for language from an in-memory copy of its traineddata;
+    // a null buffer loads it from the tessdata directory instead
+    bool initialize(const std::string& language, const std::shared_ptr<const std::string>& traineddata);
     void cleanup();
+    
+    // Runs one small recognition so Tesseract's lazily built state exists
+    // before the first real request
+    bool warmUp();
 
-    // Core OCR functions
+    // Core OCR functions. The engine's language is fixed at initialization;
+    // options naming a different one are refused with an empty result.
     OCRResult extractText(const std::string& image_path);
+    OCRResult extractText(const std::string& image_path, const OCROptions& options);
+    OCRResult extractTextFromBuffer(std::string_view buffer, const OCROptions& options);
     OCRResult extractTextFromMat(const cv::Mat& image);
+    OCRResult extractTextFromMat(const cv::Mat& image, const OCROptions& options);
     
     // Document processing
     DocumentInfo analyzeDocument(const std::string& image_path);
+    DocumentInfo analyzeDocument(const std::string& image_path, const OCROptions& options);
+    DocumentInfo analyzeDocumentFromBuffer(std::string_view buffer, const OCROptions& options);
     DocumentInfo analyzeDocumentFromMat(const cv::Mat& image);
+    DocumentInfo analyzeDocumentFromMat(const cv::Mat& image, const OCROptions& options);
     
     // Batch processing
     std::vector<OCRResult> processBatch(const std::vector<std::string>& image_paths);
+    std::vector<OCRResult> processBatch(const std::vector<std::string>& image_paths, const OCROptions& options);
     
     // Configuration
-    void setLanguage(const std::string& language);
-    void setConfidenceThreshold(double threshold);
-    void enablePreprocessing(bool enable);
+    void setFieldExtractor(std::shared_ptr<const FieldExtractor> field_extractor);
+    // Layouts to match documents against before analyzing the whole page;
+    // null (the default) always analyzes the whole page
+    void setTemplateRegistry(std::shared_ptr<TemplateRegistry> template_registry);
+    
+    const std::string& language() const { return language_; }
+    
+    // Identifies everything engine-side that affects OCR output (language and
+    // field definitions); combined with OCROptions::cacheKey() to key results
+    std::string configKey() const;
+    static std::string configKey(const std::string& language, const FieldExtractor& field_extractor);
 
 private:
     std::unique_ptr<tesseract::TessBaseAPI> tess_api_;
-    cv::Mat preprocessImage(const cv::Mat& input);
-    cv::Mat enhanceImage(const cv::Mat& input);
-    cv::Mat removeNoise(const cv::Mat& input);
-    cv::Mat deskewImage(const cv::Mat& input);
+    
+    // How adaptive pages were settled: by the fast pass alone, by redoing
+    // some lines, or by the full path over the whole page
+    struct AdaptiveCounters {
+        MetricCounter& fast;
+        MetricCounter& lines;
+        MetricCounter& full;
+    };
+    static AdaptiveCounters& adaptiveCounters();
+    
+    OCRResult recognizeAdaptive(const cv::Mat& image, const OCROptions& options);
+    OCRResult recognizeImage(const cv::Mat& image, const OCROptions& options);
+    static OCRResult mergeLines(const OCRResult& page, const std::vector<OCRResult>& redone,
+                                const std::vector<char>& replaced);
+    static void trimDetail(OCRResult& result, ResultDetail detail);
+    // Fills info from the template's field regions alone; false when a field
+    // reads empty or below the confidence threshold
+    bool analyzeFromTemplate(const cv::Mat& image, const LayoutFingerprint& fingerprint,
+                             const DocumentTemplate& known, const OCROptions& options, DocumentInfo& info);
+    void applyOptions(const OCROptions& options);
+    void collectText(OCRResult& result);
+    void collectWords(OCRResult& result, ResultDetail detail);
+    
+    PreprocessingPipeline preprocessing_pipeline_;
+    std::shared_ptr<const FieldExtractor> field_extractor_;
+    std::shared_ptr<TemplateRegistry> template_registry_;
     
     std::string language_;
-    double confidence_threshold_;
-    bool preprocessing_enabled_;
     bool initialized_;
-}; 
\ No newline at end of file
+    
+    // Last settings handed to Tesseract, so unchanged options cost nothing
+    tesseract::PageSegMode applied_page_seg_mode_;
+    std::string applied_char_whitelist_;
+};
\ No newline at end of file
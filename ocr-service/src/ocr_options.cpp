@@ -0,0 +1,25 @@
+#include "ocr_options.h"
+#include <cstdio>
+
+const char* OCROptions::defaultCharWhitelist() {
+    return "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz.,!?@#$%&*()_+-=[]{}|;:'\"<>/\\ ";
+}
+
+std::string OCROptions::cacheKey() const {
+    // The threshold is a double; every digit of it decides which lines are
+    // re-read, so it goes into the key exactly
+    char threshold[32];
+    std::snprintf(threshold, sizeof(threshold), "%.17g", confidence_threshold);
+    return "psm=" + std::to_string(static_cast<int>(page_seg_mode)) +
+           "|whitelist=" + char_whitelist +
+           "|dpi=" + std::to_string(dpi) +
+           "|detail=" + std::to_string(static_cast<int>(detail)) +
+           "|tiling=" + std::to_string(static_cast<int>(tiling)) +
+           "|enhance=" + (preprocessing.enhance ? "1" : "0") +
+           "|denoise=" + (preprocessing.denoise ? "1" : "0") +
+           "|deskew=" + (preprocessing.deskew ? "1" : "0") +
+           "|source_dpi=" + std::to_string(decode.source_dpi) +
+           "|target_dpi=" + std::to_string(decode.target_dpi) +
+           "|adaptive=" + (adaptive ? std::string(threshold) : std::string("off")) +
+           "|tables=" + (tables ? "1" : "0");
+}
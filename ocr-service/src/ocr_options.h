@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <tesseract/baseapi.h>
+#include "preprocessing_pipeline.h"
+#include "image_decoder.h"
+
+// How much of Tesseract's result to materialize. Each level includes the
+// previous one; pick the cheapest level the caller will actually serialize.
+enum class ResultDetail {
+    Text,       // text, mean confidence and word count only
+    Words,      // + per-word strings and confidences
+    WordBoxes,  // + per-word bounding boxes
+    Layout      // + text line boxes and line/block membership
+};
+
+enum class TilingMode {
+    Auto,  // tile pages at or above the configured pixel count
+    Off,
+    On
+};
+
+// Everything a single OCR call depends on. Built once per request and passed
+// down by const reference, so requests with different settings can share the
+// pool without touching each other's configuration; an engine only
+// reconfigures Tesseract when an option differs from what it last applied.
+struct OCROptions {
+    std::string language;  // empty selects the pool's default language
+    tesseract::PageSegMode page_seg_mode = tesseract::PSM_AUTO;
+    std::string char_whitelist = defaultCharWhitelist();  // empty allows every character
+    int dpi = 0;           // resolution hint passed to Tesseract, 0 = let it estimate
+    PreprocessingOptions preprocessing;
+    DecodeOptions decode;
+    ResultDetail detail = ResultDetail::WordBoxes;
+    TilingMode tiling = TilingMode::Auto;
+
+    // Recognize a downscaled, unpreprocessed copy first and only send the
+    // page, or just its lines with words below confidence_threshold, through
+    // the full preprocessing path. Off runs the full path directly.
+    bool adaptive = true;
+    double confidence_threshold = 60.0;
+
+    // Document analysis only: also rebuild tables from the word boxes, which
+    // needs at least WordBoxes detail from recognition
+    bool tables = false;
+
+    // Identifies every option that affects the result, except the language,
+    // which the engine's own config key covers
+    std::string cacheKey() const;
+
+    static const char* defaultCharWhitelist();
+};
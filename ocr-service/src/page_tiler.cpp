@@ -0,0 +1,249 @@
+#include "page_tiler.h"
+#include "tracing.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Block detection runs on a copy about this wide; enough to separate columns
+// and paragraphs on a letter-size page without touching every source pixel
+constexpr int kDetectionWidth = 1200;
+
+// Blocks smaller than this on the detection copy are specks, not text
+constexpr int kMinBlockSide = 8;
+
+}
+
+PageTiler::PageTiler(EnginePool& engine_pool, WorkStealingScheduler& scheduler, size_t min_tiling_pixels)
+    : engine_pool_(engine_pool), scheduler_(scheduler), min_tiling_pixels_(min_tiling_pixels) {
+}
+
+bool PageTiler::shouldTile(const cv::Mat& image, TilingMode mode) const {
+    switch (mode) {
+        case TilingMode::On:
+            return true;
+        case TilingMode::Off:
+            return false;
+        case TilingMode::Auto:
+            break;
+    }
+    return min_tiling_pixels_ > 0 && image.total() >= min_tiling_pixels_;
+}
+
+std::vector<cv::Rect> PageTiler::detectTextBlocks(const cv::Mat& gray) {
+    std::vector<cv::Rect> blocks;
+    if (gray.empty() || gray.channels() != 1) {
+        return blocks;
+    }
+
+    double scale = std::min(1.0, static_cast<double>(kDetectionWidth) / gray.cols);
+    cv::Mat small;
+    if (scale < 1.0) {
+        cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    } else {
+        small = gray;
+    }
+
+    // Ink becomes foreground; dilating wider than tall joins the words of a
+    // line and the lines of a paragraph while keeping columns apart
+    cv::Mat binary;
+    cv::threshold(small, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT,
+        cv::Size(std::max(3, small.cols / 60), std::max(3, small.rows / 150)));
+    cv::dilate(binary, binary, kernel);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(binary, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    // Pad in page coordinates so glyphs cut by the downsample stay inside
+    const cv::Rect page(0, 0, gray.cols, gray.rows);
+    const int padding = std::max(8, gray.cols / 200);
+    for (const auto& contour : contours) {
+        cv::Rect box = cv::boundingRect(contour);
+        if (box.width < kMinBlockSide || box.height < kMinBlockSide) {
+            continue;
+        }
+
+        cv::Rect scaled(static_cast<int>(box.x / scale) - padding,
+                        static_cast<int>(box.y / scale) - padding,
+                        static_cast<int>(box.width / scale) + 2 * padding,
+                        static_cast<int>(box.height / scale) + 2 * padding);
+        scaled &= page;
+        if (scaled.area() > 0) {
+            blocks.push_back(scaled);
+        }
+    }
+
+    // Padding can make neighbours overlap; OCR'ing the shared strip twice
+    // would duplicate words
+    mergeOverlapping(blocks);
+    sortReadingOrder(blocks);
+    return blocks;
+}
+
+void PageTiler::mergeOverlapping(std::vector<cv::Rect>& blocks) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < blocks.size() && !merged; i++) {
+            for (size_t j = i + 1; j < blocks.size(); j++) {
+                if ((blocks[i] & blocks[j]).area() > 0) {
+                    blocks[i] |= blocks[j];
+                    blocks.erase(blocks.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void PageTiler::sortReadingOrder(std::vector<cv::Rect>& blocks) {
+    // Group blocks into column bands by horizontal overlap, then read the
+    // bands left to right and each band top to bottom
+    std::sort(blocks.begin(), blocks.end(), [](const cv::Rect& a, const cv::Rect& b) {
+        return a.x < b.x;
+    });
+
+    std::vector<std::vector<cv::Rect>> bands;
+    int band_right = 0;
+    for (const auto& block : blocks) {
+        if (bands.empty() || block.x >= band_right) {
+            bands.emplace_back();
+            band_right = block.x + block.width;
+        } else {
+            band_right = std::max(band_right, block.x + block.width);
+        }
+        bands.back().push_back(block);
+    }
+
+    blocks.clear();
+    for (auto& band : bands) {
+        std::sort(band.begin(), band.end(), [](const cv::Rect& a, const cv::Rect& b) {
+            return a.y < b.y;
+        });
+        blocks.insert(blocks.end(), band.begin(), band.end());
+    }
+}
+
+bool PageTiler::extract(const cv::Mat& image, const OCROptions& options, OCRResult& result,
+                        double& queue_time_ms) {
+    queue_time_ms = 0.0;
+
+    // Preprocess the whole page once so deskew sees the full page and tiles
+    // are cut from the same frame a single engine would have recognized.
+    // Local rather than per-thread: this thread may run other requests' tiling
+    // tasks while it waits in parallelFor below.
+    PreprocessingPipeline pipeline;
+    const cv::Mat& page = options.preprocessing.any() ? pipeline.run(image, options.preprocessing) : image;
+    // Tiles are cut from the finished page, so neither preprocessing nor an
+    // adaptive second pass has anything left to add per tile
+    OCROptions tile_options = options;
+    tile_options.preprocessing = PreprocessingOptions::none();
+    tile_options.adaptive = false;
+
+    std::vector<cv::Rect> blocks = detectTextBlocks(page);
+    if (blocks.size() <= 1) {
+        // Nothing to split; recognize the page on one engine
+        EnginePool::Lease engine = engine_pool_.acquire(options.language, page.total());
+        if (!engine) {
+            return false;
+        }
+        queue_time_ms = engine.waitTimeMs();
+        result = engine->extractTextFromMat(page, tile_options);
+        return true;
+    }
+
+    std::vector<OCRResult> tiles(blocks.size());
+    std::vector<char> tile_ok(blocks.size(), 0);
+    std::vector<double> tile_wait_ms(blocks.size(), 0.0);
+
+    // Each block is its own task with its own engine; the ROI is a view into
+    // page, so no pixels are copied before Tesseract's own SetImage copy
+    const TenantContext& page_tenant = TenantScope::current();
+    TraceLink page_trace = TraceScope::current();
+    scheduler_.parallelFor(blocks.size(), [&](size_t index) {
+        TenantScope tile_tenant(page_tenant);
+        TraceScope tile_trace(page_trace);
+        TraceSpan span("page.tile");
+        EnginePool::Lease engine = engine_pool_.acquire(options.language, blocks[index].area());
+        if (!engine) {
+            return;
+        }
+        tile_wait_ms[index] = engine.waitTimeMs();
+        tiles[index] = engine->extractTextFromMat(page(blocks[index]), tile_options);
+        tile_ok[index] = 1;
+    });
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (!tile_ok[i]) {
+            std::cerr << "No OCR engine available for page tile " << i << " of " << blocks.size() << std::endl;
+            return false;
+        }
+        queue_time_ms = std::max(queue_time_ms, tile_wait_ms[i]);
+    }
+
+    result = OCRResult{};
+    result.confidence = 0.0;
+    result.word_count = 0;
+    int line_offset = 0;
+    int block_offset = 0;
+    int paragraph_offset = 0;
+    double confidence_sum = 0.0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        appendTile(result, tiles[i], blocks[i], line_offset, block_offset, paragraph_offset, confidence_sum);
+    }
+    result.confidence = result.word_count > 0 ? confidence_sum / result.word_count : 0.0;
+    return true;
+}
+
+void PageTiler::appendTile(OCRResult& page, const OCRResult& tile, const cv::Rect& offset,
+                           int& line_offset, int& block_offset, int& paragraph_offset,
+                           double& confidence_sum) {
+    if (tile.word_count == 0) {
+        return;
+    }
+
+    // Tesseract ends each tile's text with a line break; only add one when
+    // a tile didn't, so blocks never run together
+    if (!page.text.empty() && page.text.back() != '\n') {
+        page.text += '\n';
+    }
+    const auto text_base = static_cast<uint32_t>(page.text.size());
+    page.text += tile.text;
+
+    // Word-weighted so tiles with a single stray word don't dominate
+    confidence_sum += tile.confidence * tile.word_count;
+    page.word_count += tile.word_count;
+
+    for (const TextSpan& span : tile.word_spans) {
+        page.word_spans.push_back({span.offset + text_base, span.length});
+    }
+    page.word_confidences.insert(page.word_confidences.end(),
+                                 tile.word_confidences.begin(), tile.word_confidences.end());
+
+    const cv::Point shift = offset.tl();
+    for (const auto& box : tile.bounding_boxes) {
+        page.bounding_boxes.push_back(box + shift);
+    }
+    for (const auto& box : tile.line_boxes) {
+        page.line_boxes.push_back(box + shift);
+    }
+    for (int line : tile.word_line_ids) {
+        page.word_line_ids.push_back(line + line_offset);
+    }
+
+    int max_block = -1;
+    for (int block : tile.line_block_ids) {
+        page.line_block_ids.push_back(block + block_offset);
+        max_block = std::max(max_block, block);
+    }
+    int max_paragraph = -1;
+    for (int paragraph : tile.line_paragraph_ids) {
+        page.line_paragraph_ids.push_back(paragraph + paragraph_offset);
+        max_paragraph = std::max(max_paragraph, paragraph);
+    }
+    line_offset += static_cast<int>(tile.line_boxes.size());
+    block_offset += max_block + 1;
+    paragraph_offset += max_paragraph + 1;
+}
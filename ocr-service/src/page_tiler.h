@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "engine_pool.h"
+#include "work_stealing_scheduler.h"
+
+// Intra-page parallelism for large scans. Text blocks are found with a cheap
+// morphological pass on a downsampled copy, each block is OCR'd as its own job
+// on the scheduler with its own engine, and the per-block results are stitched
+// back in reading order with boxes shifted into page coordinates.
+class PageTiler {
+public:
+    PageTiler(EnginePool& engine_pool, WorkStealingScheduler& scheduler, size_t min_tiling_pixels);
+
+    bool shouldTile(const cv::Mat& image, TilingMode mode) const;
+
+    // Returns false when an engine could not be checked out for some block.
+    // queue_time_ms receives the longest engine wait among the blocks.
+    bool extract(const cv::Mat& image, const OCROptions& options, OCRResult& result, double& queue_time_ms);
+
+    // Text block rectangles in page coordinates, sorted in reading order
+    // (column by column, top to bottom within a column)
+    static std::vector<cv::Rect> detectTextBlocks(const cv::Mat& gray);
+
+private:
+    static void sortReadingOrder(std::vector<cv::Rect>& blocks);
+    static void mergeOverlapping(std::vector<cv::Rect>& blocks);
+    static void appendTile(OCRResult& page, const OCRResult& tile, const cv::Rect& offset,
+                           int& line_offset, int& block_offset, int& paragraph_offset, double& confidence_sum);
+
+    EnginePool& engine_pool_;
+    WorkStealingScheduler& scheduler_;
+    size_t min_tiling_pixels_;
+};
@@ -0,0 +1,209 @@
+#include "preprocessing_kernels.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OCR_HAVE_X86 1
+#endif
+
+namespace {
+
+// Every pass runs its AVX2 variant over as much of the row as fits whole
+// vectors, when the CPU has it, and the scalar loop over the rest.
+
+// h[x] = p[x-1] + 2 p[x] + p[x+1], reflect-101 at both ends
+int horizontalEdges(const uint8_t* p, uint16_t* h, int width) {
+    h[0] = static_cast<uint16_t>(2 * p[1] + 2 * p[0]);
+    h[width - 1] = static_cast<uint16_t>(2 * p[width - 2] + 2 * p[width - 1]);
+    return 1;
+}
+
+void horizontalScalar(const uint8_t* p, uint16_t* h, int x, int end) {
+    for (; x < end; x++) {
+        h[x] = static_cast<uint16_t>(p[x - 1] + 2 * p[x] + p[x + 1]);
+    }
+}
+
+// Rounds half up, as OpenCV's fixed-point conversion does
+void verticalScalar(const uint16_t* h0, const uint16_t* h1, const uint16_t* h2, uint8_t* out, int x, int end) {
+    for (; x < end; x++) {
+        out[x] = static_cast<uint8_t>((h0[x] + 2 * h1[x] + h2[x] + 8) >> 4);
+    }
+}
+
+// 2x2 window anchored at (1, 1): pixels (x-1..x, y-1..y); anything outside
+// the frame is skipped, which is what OpenCV's default morphology border does
+template <typename Op>
+void windowScalar(const uint8_t* above, const uint8_t* row, uint8_t* out, int x, int end, Op op) {
+    for (; x < end; x++) {
+        uint8_t value = op(row[x - 1], row[x]);
+        if (above) {
+            value = op(value, op(above[x - 1], above[x]));
+        }
+        out[x] = value;
+    }
+}
+
+template <typename Op>
+void windowEdge(const uint8_t* above, const uint8_t* row, uint8_t* out, Op op) {
+    out[0] = above ? op(row[0], above[0]) : row[0];
+}
+
+struct Max {
+    uint8_t operator()(uint8_t a, uint8_t b) const { return std::max(a, b); }
+};
+
+struct Min {
+    uint8_t operator()(uint8_t a, uint8_t b) const { return std::min(a, b); }
+};
+
+#ifdef OCR_HAVE_X86
+
+__attribute__((target("avx2")))
+int horizontalAvx2(const uint8_t* p, uint16_t* h, int x, int end) {
+    for (; x + 16 <= end; x += 16) {
+        __m256i left = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x - 1)));
+        __m256i center = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x)));
+        __m256i right = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x + 1)));
+        __m256i sum = _mm256_add_epi16(_mm256_add_epi16(left, right), _mm256_slli_epi16(center, 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(h + x), sum);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+int verticalAvx2(const uint16_t* h0, const uint16_t* h1, const uint16_t* h2, uint8_t* out, int x, int end) {
+    const __m256i rounding = _mm256_set1_epi16(8);
+    for (; x + 16 <= end; x += 16) {
+        __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h0 + x));
+        __m256i middle = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h1 + x));
+        __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h2 + x));
+        __m256i sum = _mm256_add_epi16(_mm256_add_epi16(top, bottom), _mm256_slli_epi16(middle, 1));
+        __m256i value = _mm256_srli_epi16(_mm256_add_epi16(sum, rounding), 4);
+        // packus works per 128-bit lane; gather the two packed quarters
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(packed));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline __m256i windowOpAvx2(__m256i a, __m256i b, bool is_max) {
+    return is_max ? _mm256_max_epu8(a, b) : _mm256_min_epu8(a, b);
+}
+
+__attribute__((target("avx2")))
+int windowAvx2(const uint8_t* above, const uint8_t* row, uint8_t* out, int x, int end, bool is_max) {
+    for (; x + 32 <= end; x += 32) {
+        __m256i value = windowOpAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x)), is_max);
+        if (above) {
+            __m256i pair = windowOpAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x - 1)),
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x)), is_max);
+            value = windowOpAvx2(value, pair, is_max);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), value);
+    }
+    return x;
+}
+
+bool cpuHasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+#else
+
+bool cpuHasAvx2() {
+    return false;
+}
+
+#endif
+
+}
+
+bool denoiseFusedUsesAvx2() {
+    return cpuHasAvx2();
+}
+
+void denoiseFusedRows(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step,
+                      int width, int height, FusedDenoiseScratch& scratch) {
+    const size_t w = static_cast<size_t>(width);
+    scratch.horizontal.resize(3 * w);
+    scratch.blurred.resize(2 * w);
+    scratch.dilated.resize(2 * w);
+    const bool avx2 = cpuHasAvx2();
+
+    auto horizontalRow = [&](int y) {
+        const uint8_t* p = src + static_cast<size_t>(y) * src_step;
+        uint16_t* h = scratch.horizontal.data() + static_cast<size_t>(y % 3) * w;
+        int x = horizontalEdges(p, h, width);
+#ifdef OCR_HAVE_X86
+        if (avx2) {
+            x = horizontalAvx2(p, h, x, width - 1);
+        }
+#endif
+        horizontalScalar(p, h, x, width - 1);
+    };
+    auto horizontalAt = [&](int y) {
+        // Reflect-101 vertically: row -1 is row 1, row height is row height - 2
+        y = y < 0 ? 1 : (y >= height ? height - 2 : y);
+        return scratch.horizontal.data() + static_cast<size_t>(y % 3) * w;
+    };
+
+    horizontalRow(0);
+    for (int y = 0; y < height; y++) {
+        if (y + 1 < height) {
+            horizontalRow(y + 1);
+        }
+
+        // Blur row y
+        uint8_t* blurred = scratch.blurred.data() + static_cast<size_t>(y % 2) * w;
+        const uint16_t* h0 = horizontalAt(y - 1);
+        const uint16_t* h1 = horizontalAt(y);
+        const uint16_t* h2 = horizontalAt(y + 1);
+        int x = 0;
+#ifdef OCR_HAVE_X86
+        if (avx2) {
+            x = verticalAvx2(h0, h1, h2, blurred, x, width);
+        }
+#endif
+        verticalScalar(h0, h1, h2, blurred, x, width);
+
+        // Dilate row y from blurred rows y-1 and y
+        const uint8_t* blurred_above = y > 0 ? scratch.blurred.data() + static_cast<size_t>((y - 1) % 2) * w
+                                             : nullptr;
+        uint8_t* dilated = scratch.dilated.data() + static_cast<size_t>(y % 2) * w;
+        windowEdge(blurred_above, blurred, dilated, Max());
+        x = 1;
+#ifdef OCR_HAVE_X86
+        if (avx2) {
+            x = windowAvx2(blurred_above, blurred, dilated, x, width, true);
+        }
+#endif
+        windowScalar(blurred_above, blurred, dilated, x, width, Max());
+
+        // Erode row y from dilated rows y-1 and y, straight into dst
+        const uint8_t* dilated_above = y > 0 ? scratch.dilated.data() + static_cast<size_t>((y - 1) % 2) * w
+                                             : nullptr;
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_step;
+        windowEdge(dilated_above, dilated, out, Min());
+        x = 1;
+#ifdef OCR_HAVE_X86
+        if (avx2) {
+            x = windowAvx2(dilated_above, dilated, out, x, width, false);
+        }
+#endif
+        windowScalar(dilated_above, dilated, out, x, width, Min());
+    }
+}
+
+bool denoiseFused(const cv::Mat& src, cv::Mat& dst, FusedDenoiseScratch& scratch) {
+    if (src.type() != CV_8UC1 || src.cols < 2 || src.rows < 2) {
+        return false;
+    }
+    // dst must not alias src: rows of src are still read after dst rows above them are written
+    dst.create(src.size(), CV_8UC1);
+    denoiseFusedRows(src.data, src.step, dst.data, dst.step, src.cols, src.rows, scratch);
+    return true;
+}
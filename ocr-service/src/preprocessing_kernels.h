@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Working rows for denoiseFused, kept by the caller so steady-state pages of
+// one size allocate nothing
+struct FusedDenoiseScratch {
+    std::vector<uint16_t> horizontal;  // 3 rows of horizontal blur sums
+    std::vector<uint8_t> blurred;      // 2 rows of blurred pixels
+    std::vector<uint8_t> dilated;      // 2 rows of dilated pixels
+};
+
+// GaussianBlur(Size(3, 3), 0) followed by morphologyEx(MORPH_CLOSE) with a
+// 2x2 rectangle, fused into one pass over the frame. Reproduces OpenCV's
+// arithmetic exactly: the bit-exact [1 2 1]/4 kernel rounded half up, reflect-101
+// blur borders, and morphology that ignores pixels outside the frame.
+// Uses AVX2 when the CPU has it. Returns false, leaving dst untouched, for
+// frames it does not handle (not 8-bit single channel, or under 2x2).
+bool denoiseFused(const cv::Mat& src, cv::Mat& dst, FusedDenoiseScratch& scratch);
+
+// The same over raw rows, for callers without a Mat
+void denoiseFusedRows(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step,
+                      int width, int height, FusedDenoiseScratch& scratch);
+
+bool denoiseFusedUsesAvx2();
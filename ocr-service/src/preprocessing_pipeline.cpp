@@ -0,0 +1,294 @@
+#include "preprocessing_pipeline.h"
+#include "metrics.h"
+#include <opencv2/core/ocl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Skew is estimated on a 1/kSkewDownsample copy; text lines stay several
+// pixels tall there at typical scan resolutions
+constexpr int kSkewDownsample = 4;
+constexpr double kMaxSkewDegrees = 15.0;
+constexpr double kCoarseStepDegrees = 1.0;
+constexpr double kFineStepDegrees = 0.1;
+constexpr double kDeskewToleranceDegrees = 0.5;
+constexpr size_t kMinInkPoints = 200;
+constexpr double kMinScoreGain = 1.02;
+
+// Deterministic page for the backend self-check: text on a lighting gradient
+// with sensor noise, at an odd size so vector loops end in scalar tails
+cv::Mat syntheticPage() {
+    cv::Mat page(613, 997, CV_8UC1);
+    cv::RNG rng(0x5eed);
+    for (int y = 0; y < page.rows; y++) {
+        uchar* row = page.ptr(y);
+        for (int x = 0; x < page.cols; x++) {
+            row[x] = static_cast<uchar>(150 + (x + y) * 80 / (page.cols + page.rows) + rng.uniform(0, 25));
+        }
+    }
+    const char* lines[] = {"INVOICE 2024-0117", "Total due: $1,284.50", "Thank you for your business."};
+    int baseline = 120;
+    for (const char* line : lines) {
+        cv::putText(page, line, cv::Point(40, baseline), cv::FONT_HERSHEY_SIMPLEX, 1.6, cv::Scalar(30), 3);
+        baseline += 150;
+    }
+    return page;
+}
+
+}
+
+const char* preprocessingBackendName(PreprocessingBackend backend) {
+    switch (backend) {
+        case PreprocessingBackend::FusedCPU: return denoiseFusedUsesAvx2() ? "fused-avx2" : "fused";
+        case PreprocessingBackend::OpenCL: return "opencl";
+        case PreprocessingBackend::OpenCV: break;
+    }
+    return "opencv";
+}
+
+PreprocessingPipeline::PreprocessingPipeline()
+    : PreprocessingPipeline(backend()) {
+}
+
+PreprocessingPipeline::PreprocessingPipeline(PreprocessingBackend backend)
+    : backend_(backend),
+      morph_kernel_(cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2))) {
+}
+
+PreprocessingBackend PreprocessingPipeline::backend() {
+    static const PreprocessingBackend selected = selectBackend();
+    return selected;
+}
+
+PreprocessingBackend PreprocessingPipeline::selectBackend() {
+    const char* env = std::getenv("OCR_PREPROCESSING_BACKEND");
+    std::string requested = env ? env : "auto";
+
+    std::vector<PreprocessingBackend> candidates;
+    if (requested == "opencl") {
+        candidates = {PreprocessingBackend::OpenCL};
+    } else if (requested == "fused") {
+        candidates = {PreprocessingBackend::FusedCPU};
+    } else if (requested != "opencv") {
+        if (requested != "auto") {
+            std::cerr << "Unknown OCR_PREPROCESSING_BACKEND " << requested << ", using auto" << std::endl;
+        }
+        candidates = {PreprocessingBackend::OpenCL, PreprocessingBackend::FusedCPU};
+    }
+
+    for (PreprocessingBackend candidate : candidates) {
+        if (candidate == PreprocessingBackend::OpenCL) {
+            // Integrated CPU OpenCL runtimes are slower than the fused kernels
+            if (!cv::ocl::haveOpenCL() || !cv::ocl::Device::getDefault().isGPU()) {
+                continue;
+            }
+        }
+        if (matchesOpenCV(candidate)) {
+            return candidate;
+        }
+        std::cerr << "Preprocessing backend " << preprocessingBackendName(candidate)
+                  << " does not reproduce the OpenCV output, not using it" << std::endl;
+    }
+    return PreprocessingBackend::OpenCV;
+}
+
+bool PreprocessingPipeline::matchesOpenCV(PreprocessingBackend backend) {
+    try {
+        cv::Mat page = syntheticPage();
+        // Binarized input (the usual chain) and raw grayscale into denoise
+        const PreprocessingOptions variants[] = {{true, true, false}, {false, true, false}};
+        for (const PreprocessingOptions& options : variants) {
+            PreprocessingPipeline reference(PreprocessingBackend::OpenCV);
+            PreprocessingPipeline candidate(backend);
+            const cv::Mat& expected = reference.run(page, options);
+            const cv::Mat& actual = candidate.run(page, options);
+            if (expected.size() != actual.size() || cv::norm(expected, actual, cv::NORM_INF) != 0) {
+                return false;
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Preprocessing backend " << preprocessingBackendName(backend)
+                  << " self-check failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+const cv::Mat& PreprocessingPipeline::run(const cv::Mat& input, const PreprocessingOptions& options) {
+    loadGray(input);
+
+    if (backend_ == PreprocessingBackend::OpenCL && (options.enhance || options.denoise)) {
+        runOnDevice(options);
+    } else {
+        if (options.enhance) {
+            StageTimer timer(Stage::Enhance);
+            enhanceImage();
+        }
+        if (options.denoise) {
+            StageTimer timer(Stage::Denoise);
+            removeNoise();
+        }
+    }
+    if (options.deskew) {
+        StageTimer timer(Stage::Deskew);
+        deskewImage();
+    }
+
+    return current_;
+}
+
+void PreprocessingPipeline::runOnDevice(const PreprocessingOptions& options) {
+    // One upload and one download per page; the same calls as the CPU stages,
+    // ping-ponging between two device frames that persist across pages.
+    // Kernels are queued asynchronously, so stage timings cover submission
+    // and the download carries the wait.
+    current_.copyTo(device_current_);
+    if (options.enhance) {
+        StageTimer timer(Stage::Enhance);
+        cv::equalizeHist(device_current_, device_scratch_);
+        cv::adaptiveThreshold(device_scratch_, device_current_, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                              cv::THRESH_BINARY, 11, 2);
+    }
+    if (options.denoise) {
+        StageTimer timer(Stage::Denoise);
+        cv::GaussianBlur(device_current_, device_scratch_, cv::Size(3, 3), 0);
+        cv::morphologyEx(device_scratch_, device_current_, cv::MORPH_CLOSE, morph_kernel_);
+    }
+    device_current_.copyTo(current_);
+}
+
+void PreprocessingPipeline::loadGray(const cv::Mat& input) {
+    // Mat::create inside cvtColor/copyTo is a no-op when the buffer already
+    // has the right size and type, which is the steady state for a pool engine
+    if (input.channels() == 3) {
+        cv::cvtColor(input, current_, cv::COLOR_BGR2GRAY);
+    } else if (input.channels() == 4) {
+        cv::cvtColor(input, current_, cv::COLOR_BGRA2GRAY);
+    } else {
+        input.copyTo(current_);
+    }
+}
+
+void PreprocessingPipeline::swapBuffers() {
+    cv::swap(current_, scratch_);
+}
+
+void PreprocessingPipeline::enhanceImage() {
+    // Apply histogram equalization
+    cv::equalizeHist(current_, current_);
+
+    // Apply adaptive threshold; with a distinct destination OpenCV keeps its
+    // local-mean frame in dst rather than allocating one per call
+    cv::adaptiveThreshold(current_, scratch_, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, 11, 2);
+    swapBuffers();
+}
+
+void PreprocessingPipeline::removeNoise() {
+    // Blur and close in one pass over the frame instead of two
+    if (backend_ == PreprocessingBackend::FusedCPU && denoiseFused(current_, scratch_, fused_scratch_)) {
+        swapBuffers();
+        return;
+    }
+
+    // Apply Gaussian blur to reduce noise
+    cv::GaussianBlur(current_, scratch_, cv::Size(3, 3), 0);
+    swapBuffers();
+
+    // Apply morphological operations
+    cv::morphologyEx(current_, scratch_, cv::MORPH_CLOSE, morph_kernel_);
+    swapBuffers();
+}
+
+void PreprocessingPipeline::deskewImage() {
+    double angle = estimateSkew();
+
+    // Small residual skew costs Tesseract nothing; skip the full-size warp
+    if (std::abs(angle) < kDeskewToleranceDegrees) {
+        return;
+    }
+
+    // The only full-resolution step. Replicating the border keeps the page
+    // background in the corners instead of black wedges.
+    cv::Point2f center(current_.cols / 2.0f, current_.rows / 2.0f);
+    cv::Mat rotation_matrix = cv::getRotationMatrix2D(center, angle, 1.0);
+    cv::warpAffine(current_, scratch_, rotation_matrix, current_.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    swapBuffers();
+}
+
+double PreprocessingPipeline::estimateSkew() {
+    if (current_.cols < kSkewDownsample * 16 || current_.rows < kSkewDownsample * 16) {
+        return 0.0;
+    }
+
+    // Dark ink on a light page, whether or not enhance already binarized it
+    cv::resize(current_, skew_sample_, cv::Size(current_.cols / kSkewDownsample, current_.rows / kSkewDownsample),
+               0, 0, cv::INTER_AREA);
+    cv::threshold(skew_sample_, skew_mask_, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+
+    ink_points_.clear();
+    cv::findNonZero(skew_mask_, ink_points_);
+    // Blank pages, and pages that are mostly ink, have no line structure
+    size_t pixels = skew_mask_.total();
+    if (ink_points_.size() < kMinInkPoints || ink_points_.size() > pixels / 2) {
+        return 0.0;
+    }
+
+    // Coarse pass over the whole range, then refine around the best angle.
+    // Ties keep the angle closest to level.
+    double best_angle = 0.0;
+    double best_score = profileScore(0.0);
+    double level_score = best_score;
+    int coarse_steps = static_cast<int>(kMaxSkewDegrees / kCoarseStepDegrees);
+    for (int step = -coarse_steps; step <= coarse_steps; step++) {
+        double angle = step * kCoarseStepDegrees;
+        double score = profileScore(angle);
+        if (score > best_score) {
+            best_score = score;
+            best_angle = angle;
+        }
+    }
+    double coarse_angle = best_angle;
+    int fine_steps = static_cast<int>(std::lround(kCoarseStepDegrees / kFineStepDegrees));
+    for (int step = -fine_steps; step <= fine_steps; step++) {
+        double angle = coarse_angle + step * kFineStepDegrees;
+        double score = profileScore(angle);
+        if (score > best_score) {
+            best_score = score;
+            best_angle = angle;
+        }
+    }
+
+    // A profile barely sharper than the level one is noise, not skew
+    if (best_score < level_score * kMinScoreGain) {
+        return 0.0;
+    }
+    return best_angle;
+}
+
+double PreprocessingPipeline::profileScore(double degrees) {
+    // Project every ink pixel onto the axis perpendicular to lines at this
+    // angle. Aligned lines pile into few bins, so the sum of squared bin
+    // counts peaks at the true skew.
+    double radians = degrees * CV_PI / 180.0;
+    double sin_a = std::sin(radians);
+    double cos_a = std::cos(radians);
+    double center_x = skew_mask_.cols / 2.0;
+    double center_y = skew_mask_.rows / 2.0;
+    int half = static_cast<int>(std::ceil(std::hypot(center_x, center_y))) + 1;
+
+    profile_.assign(static_cast<size_t>(2 * half + 1), 0);
+    for (const cv::Point& point : ink_points_) {
+        double y = (point.y - center_y) * cos_a - (point.x - center_x) * sin_a;
+        profile_[static_cast<size_t>(static_cast<int>(std::lround(y)) + half)]++;
+    }
+
+    double score = 0.0;
+    for (int count : profile_) {
+        score += static_cast<double>(count) * count;
+    }
+    return score;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "preprocessing_kernels.h"
+
+struct PreprocessingOptions {
+    bool enhance = true;   // histogram equalization + adaptive threshold
+    bool denoise = true;   // gaussian blur + morphological close
+    bool deskew = true;
+
+    bool any() const { return enhance || denoise || deskew; }
+
+    static PreprocessingOptions none() { return {false, false, false}; }
+};
+
+// Where the enhance and denoise stages run. Every backend produces the same
+// pixels as OpenCV; deskew always runs on the CPU frame.
+enum class PreprocessingBackend {
+    OpenCV,    // cv::Mat calls, one stage at a time
+    FusedCPU,  // blur + close fused into one pass over the frame, AVX2 when available
+    OpenCL     // enhance and denoise on the device through cv::UMat
+};
+
+const char* preprocessingBackendName(PreprocessingBackend backend);
+
+// Grayscale preprocessing chain run ahead of Tesseract. The pipeline owns its
+// working frames and ping-pongs between them, so once it has seen a page of a
+// given size, later pages of that size reuse the same buffers instead of
+// cloning the frame at every stage. Not thread-safe: each OCREngine owns one.
+class PreprocessingPipeline {
+public:
+    // Uses the process-wide backend()
+    PreprocessingPipeline();
+    explicit PreprocessingPipeline(PreprocessingBackend backend);
+
+    // Runs the enabled stages over input. The returned frame is owned by the
+    // pipeline and stays valid until the next call to run().
+    const cv::Mat& run(const cv::Mat& input, const PreprocessingOptions& options);
+
+    // Chosen on first use: OCR_PREPROCESSING_BACKEND=opencv|fused|opencl
+    // forces one, auto (the default) prefers OpenCL on a GPU, then the fused
+    // kernels. A candidate is only taken after it reproduces the OpenCV
+    // pipeline exactly on a synthetic page; otherwise OpenCV is used.
+    static PreprocessingBackend backend();
+
+private:
+    static PreprocessingBackend selectBackend();
+    static bool matchesOpenCV(PreprocessingBackend backend);
+
+    void runOnDevice(const PreprocessingOptions& options);
+    void loadGray(const cv::Mat& input);
+    void enhanceImage();
+    void removeNoise();
+    void deskewImage();
+    // Skew of the text lines in degrees, 0 when there is too little ink to tell
+    double estimateSkew();
+    double profileScore(double degrees);
+    void swapBuffers();
+
+    PreprocessingBackend backend_;
+    cv::Mat current_;
+    cv::Mat scratch_;
+    cv::UMat device_current_;
+    cv::UMat device_scratch_;
+    FusedDenoiseScratch fused_scratch_;
+    cv::Mat morph_kernel_;
+    // Deskew estimation works on a downsampled ink mask
+    cv::Mat skew_sample_;
+    cv::Mat skew_mask_;
+    std::vector<cv::Point> ink_points_;
+    std::vector<int> profile_;
+};
@@ -0,0 +1,167 @@
+#include "raster_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Same bound as Tesseract's image dimensions
+constexpr size_t kMaxRasterSide = 32767;
+
+std::string systemError(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+}
+
+std::shared_ptr<const MappedRegion> MappedRegion::mapDescriptor(int fd, size_t size, std::string& error) {
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        error = systemError("mmap failed");
+        return nullptr;
+    }
+    return std::shared_ptr<const MappedRegion>(new MappedRegion(data, size));
+}
+
+std::shared_ptr<const MappedRegion> MappedRegion::mapFile(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = systemError("cannot open " + path);
+        return nullptr;
+    }
+
+    struct stat status;
+    std::shared_ptr<const MappedRegion> region;
+    if (fstat(fd, &status) != 0) {
+        error = systemError("cannot stat " + path);
+    } else if (status.st_size <= 0) {
+        error = path + " is empty";
+    } else {
+        region = mapDescriptor(fd, static_cast<size_t>(status.st_size), error);
+        if (region) {
+            // Decoders read front to back
+            madvise(region->data_, region->size_, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+    return region;
+}
+
+MappedRegion::~MappedRegion() {
+    munmap(data_, size_);
+}
+
+std::string_view RasterHandle::bytes() const {
+    if (image.empty()) {
+        return {};
+    }
+    size_t row_bytes = static_cast<size_t>(image.cols) * image.elemSize();
+    size_t span = image.step * static_cast<size_t>(image.rows - 1) + row_bytes;
+    return {reinterpret_cast<const char*>(image.data), span};
+}
+
+RasterSource::RasterSource(std::string shm_prefix, size_t max_segments)
+    : shm_prefix_(std::move(shm_prefix)), max_segments_(std::max<size_t>(1, max_segments)) {
+}
+
+size_t RasterSource::mappedSegments() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+std::shared_ptr<const MappedRegion> RasterSource::mapSharedMemory(const std::string& name, std::string& error) {
+    if (shm_prefix_.empty() || name.compare(0, shm_prefix_.size(), shm_prefix_) != 0 ||
+        name.find('/', 1) != std::string::npos) {
+        error = "shared memory name must start with " + shm_prefix_;
+        return nullptr;
+    }
+
+    // One open and fstat per request tells whether the cached mapping is
+    // still the caller's current object
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = systemError("cannot open shared memory " + name);
+        // An unlinked name's old mapping would only hold on to its memory
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.erase(name);
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        error = "shared memory " + name + " is empty";
+        ::close(fd);
+        return nullptr;
+    }
+    auto inode = static_cast<unsigned long>(status.st_ino);
+    auto size = static_cast<size_t>(status.st_size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segments_.size() >= max_segments_ && segments_.find(name) == segments_.end()) {
+        auto oldest = std::min_element(segments_.begin(), segments_.end(), [](const auto& a, const auto& b) {
+            return a.second.last_used < b.second.last_used;
+        });
+        segments_.erase(oldest);
+    }
+    Segment& segment = segments_[name];
+    segment.last_used = ++tick_;
+    if (!segment.region || segment.inode != inode || segment.size != size) {
+        // Requests still holding the old mapping keep it alive until they finish
+        segment.region = MappedRegion::mapDescriptor(fd, size, error);
+        segment.inode = inode;
+        segment.size = size;
+    }
+    ::close(fd);
+    auto region = segment.region;
+    if (!region) {
+        segments_.erase(name);
+    }
+    return region;
+}
+
+bool RasterSource::open(const RasterDescriptor& descriptor, RasterHandle& raster, std::string& error) {
+    if (descriptor.shm.empty() == descriptor.file.empty()) {
+        error = "raster needs exactly one of shm or file";
+        return false;
+    }
+    if (descriptor.channels != 1 && descriptor.channels != 3 && descriptor.channels != 4) {
+        error = "raster channels must be 1, 3 or 4";
+        return false;
+    }
+    if (descriptor.width <= 0 || descriptor.height <= 0 ||
+        static_cast<size_t>(descriptor.width) > kMaxRasterSide ||
+        static_cast<size_t>(descriptor.height) > kMaxRasterSide) {
+        error = "raster width and height must be between 1 and " + std::to_string(kMaxRasterSide);
+        return false;
+    }
+
+    size_t row_bytes = static_cast<size_t>(descriptor.width) * static_cast<size_t>(descriptor.channels);
+    size_t stride = descriptor.stride ? descriptor.stride : row_bytes;
+    if (stride < row_bytes) {
+        error = "raster stride is smaller than a row";
+        return false;
+    }
+
+    raster.region = descriptor.shm.empty() ? MappedRegion::mapFile(descriptor.file, error)
+                                           : mapSharedMemory(descriptor.shm, error);
+    if (!raster.region) {
+        return false;
+    }
+
+    // The last row only needs its pixels, not the full stride
+    size_t span = stride * static_cast<size_t>(descriptor.height - 1) + row_bytes;
+    size_t available = raster.region->bytes().size();
+    if (descriptor.offset > available || span > available - descriptor.offset) {
+        error = "raster extends past the end of its mapping";
+        raster.region.reset();
+        return false;
+    }
+
+    // The mapping is read-only; nothing downstream writes to its input frame
+    auto* data = const_cast<char*>(raster.region->bytes().data() + descriptor.offset);
+    raster.image = cv::Mat(descriptor.height, descriptor.width, CV_8UC(descriptor.channels), data, stride);
+    return true;
+}
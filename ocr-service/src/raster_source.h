@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <opencv2/opencv.hpp>
+
+// A read-only memory mapping, unmapped when the last reference goes
+class MappedRegion {
+public:
+    // Maps a whole file. Callers must not truncate it while it is mapped;
+    // reads past the new end would fault.
+    static std::shared_ptr<const MappedRegion> mapFile(const std::string& path, std::string& error);
+
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+    ~MappedRegion();
+
+    std::string_view bytes() const { return {static_cast<const char*>(data_), size_}; }
+
+private:
+    friend class RasterSource;
+
+    MappedRegion(void* data, size_t size) : data_(data), size_(size) {}
+    static std::shared_ptr<const MappedRegion> mapDescriptor(int fd, size_t size, std::string& error);
+
+    void* data_;
+    size_t size_;
+};
+
+// Where a caller left an already-decoded 8-bit raster, either in a POSIX
+// shared-memory object (typically one slot of a ring the caller writes
+// round-robin) or in a file. The bytes must stay untouched until the
+// response, or the job's completion, arrives.
+struct RasterDescriptor {
+    std::string shm;   // shm_open name, e.g. "/ocr-ml-ring"
+    std::string file;  // or a file path
+    size_t offset = 0;
+    int width = 0;
+    int height = 0;
+    size_t stride = 0;  // bytes per row, 0 = width * channels
+    int channels = 1;   // 1 gray, 3 BGR, 4 BGRA
+};
+
+struct RasterHandle {
+    std::shared_ptr<const MappedRegion> region;  // keeps image's memory mapped
+    cv::Mat image;                               // header over region, no copy
+    
+    // The bytes image spans, for hashing
+    std::string_view bytes() const;
+};
+
+// Resolves raster descriptors to Mat headers over the caller's memory, so
+// co-located callers skip both the file read and the decode. Shared-memory
+// segments are mapped once and reused while the object is unchanged; a ring
+// costs one mmap for its lifetime rather than one per request. At most
+// max_segments names stay mapped, least recently used dropped first, so a
+// caller naming one object per request does not pin each one's memory.
+// Thread-safe.
+class RasterSource {
+public:
+    // Only shared-memory names starting with shm_prefix are opened
+    explicit RasterSource(std::string shm_prefix, size_t max_segments = 16);
+
+    bool open(const RasterDescriptor& descriptor, RasterHandle& raster, std::string& error);
+
+    size_t mappedSegments() const;
+
+private:
+    struct Segment {
+        std::shared_ptr<const MappedRegion> region;
+        unsigned long inode = 0;
+        size_t size = 0;
+        uint64_t last_used = 0;  // in open ticks
+    };
+
+    std::shared_ptr<const MappedRegion> mapSharedMemory(const std::string& name, std::string& error);
+
+    std::string shm_prefix_;
+    size_t max_segments_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Segment> segments_;
+    uint64_t tick_ = 0;
+};
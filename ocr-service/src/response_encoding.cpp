@@ -0,0 +1,143 @@
+#include "response_encoding.h"
+#include <cctype>
+#include <cstdlib>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+std::string lowercase(std::string_view value) {
+    std::string lowered(value);
+    for (char& c : lowered) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return lowered;
+}
+
+// Calls visit(token, q) for each comma-separated element of an Accept-style
+// header, with q defaulting to 1
+template <typename Visitor>
+void forEachQualified(std::string_view header, Visitor visit) {
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        std::string_view element = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+
+        size_t semicolon = element.find(';');
+        std::string token = lowercase(trim(element.substr(0, semicolon)));
+        double q = 1.0;
+        while (semicolon != std::string_view::npos) {
+            element = element.substr(semicolon + 1);
+            semicolon = element.find(';');
+            std::string_view parameter = trim(element.substr(0, semicolon));
+            if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=') {
+                q = std::atof(std::string(parameter.substr(2)).c_str());
+            }
+        }
+        if (!token.empty()) {
+            visit(token, q);
+        }
+    }
+}
+
+}
+
+ResponseEncoding negotiateEncoding(const crow::request& req) {
+    ResponseEncoding encoding;
+
+    // Ties keep the earlier entry, so "application/msgpack, application/json"
+    // selects MessagePack
+    double best_q = 0.0;
+    forEachQualified(req.get_header_value("Accept"), [&](const std::string& type, double q) {
+        ResponseFormat format;
+        if (type == "application/msgpack" || type == "application/x-msgpack" ||
+            type == "application/vnd.msgpack") {
+            format = ResponseFormat::MessagePack;
+        } else if (type == "application/cbor") {
+            format = ResponseFormat::Cbor;
+        } else if (type == "application/json" || type == "application/*" || type == "*/*") {
+            format = ResponseFormat::Json;
+        } else {
+            return;
+        }
+        if (q > best_q) {
+            best_q = q;
+            encoding.format = format;
+        }
+    });
+
+    forEachQualified(req.get_header_value("Accept-Encoding"), [&](const std::string& coding, double q) {
+        if (coding == "gzip" || coding == "x-gzip") {
+            encoding.gzip = q > 0.0;
+        }
+    });
+    return encoding;
+}
+
+const char* contentType(ResponseFormat format) {
+    switch (format) {
+        case ResponseFormat::MessagePack: return "application/msgpack";
+        case ResponseFormat::Cbor: return "application/cbor";
+        case ResponseFormat::Json: break;
+    }
+    return "application/json";
+}
+
+crow::response encodeResponse(int status_code, const nlohmann::json& body, const ResponseEncoding& encoding) {
+    std::string serialized;
+    if (encoding.format == ResponseFormat::Json) {
+        serialized = body.dump();
+    } else {
+        std::vector<std::uint8_t> packed = encoding.format == ResponseFormat::MessagePack
+            ? nlohmann::json::to_msgpack(body)
+            : nlohmann::json::to_cbor(body);
+        serialized.assign(packed.begin(), packed.end());
+    }
+
+    std::string compressed;
+    bool gzipped = encoding.gzip && serialized.size() >= kGzipMinBytes && gzipCompress(serialized, compressed);
+
+    crow::response res(status_code, gzipped ? std::move(compressed) : std::move(serialized));
+    res.set_header("Content-Type", contentType(encoding.format));
+    if (gzipped) {
+        res.set_header("Content-Encoding", "gzip");
+    }
+    // Caches in front of the service must keep the variants apart
+    res.set_header("Vary", "Accept, Accept-Encoding");
+    return res;
+}
+
+bool gzipCompress(std::string_view input, std::string& output) {
+    z_stream stream{};
+    // windowBits 15 + 16 writes a gzip header and trailer instead of zlib's.
+    // Fastest level: callers are on the same cluster, so CPU is the scarcer
+    // resource, and JSON still shrinks several-fold.
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 32);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int status = deflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return false;
+    }
+    output.resize(written);
+    return true;
+}
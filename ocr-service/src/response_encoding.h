@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <crow.h>
+#include <nlohmann/json.hpp>
+
+// Wire formats for response bodies, picked from the request's Accept header.
+// The document structure is the same in all of them; the binary formats skip
+// number-to-text conversion and escaping and are noticeably smaller for
+// word-level results.
+enum class ResponseFormat {
+    Json,
+    MessagePack,  // application/msgpack (also x-msgpack, vnd.msgpack)
+    Cbor          // application/cbor
+};
+
+struct ResponseEncoding {
+    ResponseFormat format = ResponseFormat::Json;
+    bool gzip = false;  // Accept-Encoding allows gzip
+};
+
+// Highest-q supported media type in Accept (JSON when absent, or when
+// nothing better is listed), and whether gzip may be used
+ResponseEncoding negotiateEncoding(const crow::request& req);
+
+const char* contentType(ResponseFormat format);
+
+// Serializes body in the negotiated format. Bodies of at least
+// kGzipMinBytes are gzipped when the client accepts it; below that the
+// header overhead and the CPU are not worth it.
+crow::response encodeResponse(int status_code, const nlohmann::json& body, const ResponseEncoding& encoding);
+
+// gzip stream of input at the fastest level; false if zlib fails
+bool gzipCompress(std::string_view input, std::string& output);
+
+constexpr size_t kGzipMinBytes = 1024;
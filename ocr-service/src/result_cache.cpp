@@ -0,0 +1,139 @@
+#include "result_cache.h"
+#include "content_hash.h"
+
+ResultCache::ResultCache(size_t max_entries, size_t max_bytes)
+    : max_entries_(max_entries), max_bytes_(max_bytes), bytes_(0),
+      hits_(0), misses_(0), insertions_(0), evictions_(0) {
+}
+
+ResultCache::Key ResultCache::makeKey(std::string_view content, std::string_view config) {
+    return Key{xxhash64(content), xxhash64(config)};
+}
+
+std::shared_ptr<const OCRResult> ResultCache::findText(const Key& key) {
+    Entry entry;
+    return find(EntryKey{key, Kind::Text}, entry) ? entry.text : nullptr;
+}
+
+std::shared_ptr<const DocumentInfo> ResultCache::findDocument(const Key& key) {
+    Entry entry;
+    return find(EntryKey{key, Kind::Document}, entry) ? entry.document : nullptr;
+}
+
+void ResultCache::insert(const Key& key, std::shared_ptr<const OCRResult> result) {
+    if (!enabled() || !result) {
+        return;
+    }
+
+    size_t bytes = estimateBytes(*result);
+    insertEntry(Entry{EntryKey{key, Kind::Text}, std::move(result), nullptr, bytes});
+}
+
+void ResultCache::insert(const Key& key, std::shared_ptr<const DocumentInfo> info) {
+    if (!enabled() || !info) {
+        return;
+    }
+
+    size_t bytes = estimateBytes(*info);
+    insertEntry(Entry{EntryKey{key, Kind::Document}, nullptr, std::move(info), bytes});
+}
+
+bool ResultCache::find(const EntryKey& key, Entry& entry) {
+    if (!enabled()) {
+        return false;
+    }
+
+    // Only the shared_ptrs are copied under the lock; the result objects
+    // themselves are immutable and outlive eviction while a caller holds them
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_++;
+        return false;
+    }
+
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    entry = *it->second;
+    return true;
+}
+
+void ResultCache::insertEntry(Entry entry) {
+    // A single result larger than the whole budget would only flush the cache
+    if (max_bytes_ > 0 && entry.bytes > max_bytes_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto existing = index_.find(entry.key);
+    if (existing != index_.end()) {
+        bytes_ -= existing->second->bytes;
+        lru_.erase(existing->second);
+        index_.erase(existing);
+    }
+
+    bytes_ += entry.bytes;
+    lru_.push_front(std::move(entry));
+    index_[lru_.front().key] = lru_.begin();
+    insertions_++;
+
+    evictLocked();
+}
+
+void ResultCache::evictLocked() {
+    while (!lru_.empty() &&
+           (lru_.size() > max_entries_ || (max_bytes_ > 0 && bytes_ > max_bytes_))) {
+        const Entry& victim = lru_.back();
+        bytes_ -= victim.bytes;
+        index_.erase(victim.key);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
+
+size_t ResultCache::estimateBytes(const OCRResult& result) {
+    size_t bytes = sizeof(OCRResult) + result.text.capacity();
+    bytes += result.word_spans.capacity() * sizeof(TextSpan);
+    bytes += result.word_confidences.capacity() * sizeof(float);
+    bytes += result.bounding_boxes.capacity() * sizeof(cv::Rect);
+    bytes += (result.word_line_ids.capacity() + result.line_block_ids.capacity() +
+              result.line_paragraph_ids.capacity()) * sizeof(int32_t);
+    bytes += result.line_boxes.capacity() * sizeof(cv::Rect);
+    return bytes;
+}
+
+size_t ResultCache::estimateBytes(const DocumentInfo& info) {
+    size_t bytes = sizeof(DocumentInfo) + info.document_type.capacity();
+    for (const auto& field : info.detected_fields) {
+        bytes += sizeof(std::string) + field.capacity();
+    }
+    for (const auto& [field, value] : info.extracted_data) {
+        // key + value + rb-tree node overhead
+        bytes += 2 * sizeof(std::string) + field.capacity() + value.capacity() + 32;
+    }
+    for (const auto& table : info.tables) {
+        bytes += sizeof(ExtractedTable) + table.cells.capacity() * sizeof(TableCell);
+        for (const auto& cell : table.cells) {
+            bytes += cell.text.capacity() + cell.currency.capacity();
+        }
+    }
+    return bytes;
+}
+
+ResultCacheStats ResultCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ResultCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.insertions = insertions_;
+    stats.evictions = evictions_;
+    stats.entries = lru_.size();
+    stats.bytes = bytes_;
+    stats.max_entries = max_entries_;
+    stats.max_bytes = max_bytes_;
+    uint64_t lookups = hits_ + misses_;
+    stats.hit_rate = lookups > 0 ? static_cast<double>(hits_) / lookups : 0.0;
+    return stats;
+}
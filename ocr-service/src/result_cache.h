@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include "ocr_engine.h"
+
+struct ResultCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t max_entries;
+    size_t max_bytes;
+    double hit_rate;
+};
+
+// Bounded LRU of OCR and analysis results keyed by the image bytes plus the
+// engine/request configuration that produced them, so orchestrator retries and
+// workflow re-runs of the same page skip Tesseract entirely. Results are held
+// as shared immutable objects so a hit never copies under the lock.
+class ResultCache {
+public:
+    struct Key {
+        uint64_t content_hash;
+        uint64_t config_hash;
+
+        bool operator==(const Key& other) const {
+            return content_hash == other.content_hash && config_hash == other.config_hash;
+        }
+    };
+
+    // max_entries == 0 disables the cache; max_bytes == 0 leaves it unbounded in size
+    ResultCache(size_t max_entries, size_t max_bytes);
+
+    bool enabled() const { return max_entries_ > 0; }
+
+    static Key makeKey(std::string_view content, std::string_view config);
+
+    std::shared_ptr<const OCRResult> findText(const Key& key);
+    std::shared_ptr<const DocumentInfo> findDocument(const Key& key);
+
+    void insert(const Key& key, std::shared_ptr<const OCRResult> result);
+    void insert(const Key& key, std::shared_ptr<const DocumentInfo> info);
+
+    ResultCacheStats getStats() const;
+
+private:
+    enum class Kind : uint8_t {
+        Text,
+        Document
+    };
+
+    struct EntryKey {
+        Key key;
+        Kind kind;
+
+        bool operator==(const EntryKey& other) const {
+            return key == other.key && kind == other.kind;
+        }
+    };
+
+    struct EntryKeyHash {
+        size_t operator()(const EntryKey& k) const {
+            return static_cast<size_t>(k.key.content_hash ^ (k.key.config_hash * 31) ^ static_cast<uint64_t>(k.kind));
+        }
+    };
+
+    struct Entry {
+        EntryKey key{};
+        std::shared_ptr<const OCRResult> text;
+        std::shared_ptr<const DocumentInfo> document;
+        size_t bytes = 0;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    bool find(const EntryKey& key, Entry& entry);
+    void insertEntry(Entry entry);
+    void evictLocked();
+
+    static size_t estimateBytes(const OCRResult& result);
+    static size_t estimateBytes(const DocumentInfo& info);
+
+    size_t max_entries_;
+    size_t max_bytes_;
+
+    mutable std::mutex mutex_;
+    EntryList lru_;
+    std::unordered_map<EntryKey, EntryList::iterator, EntryKeyHash> index_;
+    size_t bytes_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t insertions_;
+    uint64_t evictions_;
+};
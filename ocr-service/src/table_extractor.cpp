@@ -0,0 +1,440 @@
+#include "table_extractor.h"
+#include "ocr_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+// Stable order of 0..keys.size()-1 by key, keys in [0, max_key]
+std::vector<uint32_t> countingOrder(const std::vector<int>& keys, int max_key) {
+    std::vector<uint32_t> start(static_cast<size_t>(max_key) + 2, 0);
+    for (int key : keys) {
+        start[static_cast<size_t>(key) + 1]++;
+    }
+    for (size_t i = 1; i < start.size(); i++) {
+        start[i] += start[i - 1];
+    }
+    std::vector<uint32_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        order[start[static_cast<size_t>(keys[i])]++] = static_cast<uint32_t>(i);
+    }
+    return order;
+}
+
+struct Row {
+    double center_sum = 0.0;
+    double height_sum = 0.0;
+    int count = 0;
+    int top = 0;
+    int bottom = 0;
+    std::vector<uint32_t> words;  // left to right
+
+    double center() const { return center_sum / count; }
+    double height() const { return height_sum / count; }
+};
+
+struct Cell {
+    std::string text;
+    cv::Rect box;
+};
+
+struct Band {
+    int left;
+    int right;  // exclusive
+};
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr std::string_view kCurrencySymbols[] = {"$", "\xE2\x82\xAC", "\xC2\xA3", "\xC2\xA5"};
+constexpr std::string_view kCurrencyCodes[] = {"USD", "EUR", "GBP", "CHF", "JPY", "CAD", "AUD"};
+
+bool takeCurrencyPrefix(std::string_view& text, std::string& currency) {
+    for (std::string_view symbol : kCurrencySymbols) {
+        if (text.substr(0, symbol.size()) == symbol) {
+            currency = std::string(symbol);
+            text.remove_prefix(symbol.size());
+            return true;
+        }
+    }
+    for (std::string_view code : kCurrencyCodes) {
+        if (text.substr(0, code.size()) == code) {
+            currency = std::string(code);
+            text.remove_prefix(code.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool takeCurrencySuffix(std::string_view& text, std::string& currency) {
+    for (std::string_view symbol : kCurrencySymbols) {
+        if (text.size() >= symbol.size() && text.substr(text.size() - symbol.size()) == symbol) {
+            currency = std::string(symbol);
+            text.remove_suffix(symbol.size());
+            return true;
+        }
+    }
+    for (std::string_view code : kCurrencyCodes) {
+        if (text.size() >= code.size() && text.substr(text.size() - code.size()) == code) {
+            currency = std::string(code);
+            text.remove_suffix(code.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+// Digits with optional grouping and decimal separators; false unless the
+// whole of text is one number
+bool parseDigits(std::string_view text, double& value) {
+    if (text.empty() || !(isDigit(text.front()) || (text.front() == '.' && text.size() > 1))) {
+        return false;
+    }
+    size_t last_dot = text.rfind('.');
+    size_t last_comma = text.rfind(',');
+    size_t dots = static_cast<size_t>(std::count(text.begin(), text.end(), '.'));
+    size_t commas = static_cast<size_t>(std::count(text.begin(), text.end(), ','));
+
+    // Which separator, if any, is the decimal point: the later one when both
+    // occur; a lone comma unless it is followed by exactly three digits; a
+    // lone dot, as in US statements; and never one that occurs twice
+    char decimal = 0;
+    if (dots > 0 && commas > 0) {
+        decimal = last_dot > last_comma ? '.' : ',';
+    } else if (dots == 1) {
+        decimal = '.';
+    } else if (commas == 1) {
+        decimal = text.size() - last_comma - 1 == 3 ? 0 : ',';
+    }
+    char grouping = decimal == '.' ? ',' : (decimal == ',' ? '.' : (commas > 0 ? ',' : '.'));
+    size_t decimal_at = decimal ? text.rfind(decimal) : std::string_view::npos;
+    if (decimal && std::count(text.begin(), text.end(), decimal) > 1) {
+        return false;
+    }
+
+    std::string digits;
+    digits.reserve(text.size());
+    std::string_view integer = text.substr(0, decimal_at);
+    size_t group = 0;
+    bool grouped = false;
+    for (size_t i = 0; i < integer.size(); i++) {
+        char c = integer[i];
+        if (isDigit(c)) {
+            digits += c;
+            group++;
+        } else if (c == grouping) {
+            // 1-3 digits before the first separator, exactly 3 after each
+            if (group == 0 || group > 3 || (grouped && group != 3)) {
+                return false;
+            }
+            grouped = true;
+            group = 0;
+        } else {
+            return false;
+        }
+    }
+    if (grouped && group != 3) {
+        return false;
+    }
+    if (decimal_at != std::string_view::npos) {
+        std::string_view fraction = text.substr(decimal_at + 1);
+        if (fraction.empty()) {
+            return false;
+        }
+        digits += '.';
+        for (char c : fraction) {
+            if (!isDigit(c)) {
+                return false;
+            }
+            digits += c;
+        }
+    }
+    value = std::strtod(digits.c_str(), nullptr);
+    return true;
+}
+
+bool hasMajorityNumbers(const std::vector<TableCell>& cells, const std::vector<int>& grid, int rows, int columns,
+                        int column) {
+    int filled = 0;
+    int numeric = 0;
+    for (int row = 0; row < rows; row++) {
+        int cell = grid[static_cast<size_t>(row) * columns + column];
+        if (cell < 0) {
+            continue;
+        }
+        filled++;
+        if (cells[static_cast<size_t>(cell)].type != CellType::Text) {
+            numeric++;
+        }
+    }
+    return numeric >= 2 && numeric * 2 > filled;
+}
+
+// Rows [begin, end) as one table; false when they do not form one
+bool buildTable(const std::vector<std::vector<Cell>>& row_cells, size_t begin, size_t end, int page,
+                ExtractedTable& table) {
+    int left = INT32_MAX;
+    int right = 0;
+    size_t tabular = 0;
+    for (size_t r = begin; r < end; r++) {
+        for (const Cell& cell : row_cells[r]) {
+            left = std::min(left, cell.box.x);
+            right = std::max(right, cell.box.x + cell.box.width);
+        }
+        tabular += row_cells[r].size() >= 2 ? 1 : 0;
+    }
+    if (tabular < 2 || right <= left) {
+        return false;
+    }
+
+    // Columns are where cells cover x, tolerating a tenth of the rows
+    // spilling across a gap (a long description, a header over two columns)
+    std::vector<int> coverage(static_cast<size_t>(right - left) + 1, 0);
+    for (size_t r = begin; r < end; r++) {
+        for (const Cell& cell : row_cells[r]) {
+            coverage[static_cast<size_t>(cell.box.x - left)]++;
+            coverage[static_cast<size_t>(cell.box.x + cell.box.width - left)]--;
+        }
+    }
+    const int tolerance = static_cast<int>((end - begin) / 10);
+    std::vector<Band> bands;
+    int covered = 0;
+    for (int x = 0; x < right - left; x++) {
+        covered += coverage[static_cast<size_t>(x)];
+        if (covered > tolerance) {
+            if (bands.empty() || bands.back().right != left + x) {
+                bands.push_back({left + x, left + x + 1});
+            } else {
+                bands.back().right++;
+            }
+        }
+    }
+    if (bands.size() < 2) {
+        return false;
+    }
+
+    table = ExtractedTable{};
+    table.page = page;
+    table.rows = static_cast<int>(end - begin);
+    table.columns = static_cast<int>(bands.size());
+    std::vector<int> grid(static_cast<size_t>(table.rows) * table.columns, -1);
+    std::vector<TableCell> cells;
+    for (size_t r = begin; r < end; r++) {
+        // Cells and bands are both left to right, so one pointer per row
+        size_t band = 0;
+        for (const Cell& cell : row_cells[r]) {
+            int center = cell.box.x + cell.box.width / 2;
+            while (band + 1 < bands.size() && bands[band + 1].left <= center) {
+                band++;
+            }
+            if (center >= bands[band].right && band + 1 < bands.size() &&
+                bands[band + 1].left - center < center - bands[band].right) {
+                band++;
+            }
+
+            int& slot = grid[(r - begin) * bands.size() + band];
+            if (slot >= 0) {
+                // Two cells landed in one column: a gap inside the column
+                TableCell& merged = cells[static_cast<size_t>(slot)];
+                merged.text += ' ';
+                merged.text += cell.text;
+                merged.box |= cell.box;
+                continue;
+            }
+            slot = static_cast<int>(cells.size());
+            TableCell out;
+            out.row = static_cast<int>(r - begin);
+            out.column = static_cast<int>(band);
+            out.text = cell.text;
+            out.box = cell.box;
+            cells.push_back(std::move(out));
+        }
+    }
+
+    for (TableCell& cell : cells) {
+        parseCellValue(cell);
+    }
+    bool numeric_column = false;
+    for (int column = 0; column < table.columns && !numeric_column; column++) {
+        numeric_column = hasMajorityNumbers(cells, grid, table.rows, table.columns, column);
+    }
+    if (!numeric_column) {
+        return false;
+    }
+
+    table.cells.reserve(cells.size());
+    for (int slot : grid) {
+        if (slot >= 0) {
+            TableCell& cell = cells[static_cast<size_t>(slot)];
+            table.box = table.cells.empty() ? cell.box : (table.box | cell.box);
+            table.cells.push_back(std::move(cell));
+        }
+    }
+    return true;
+}
+
+}
+
+const char* cellTypeName(CellType type) {
+    switch (type) {
+        case CellType::Text:
+            return "text";
+        case CellType::Number:
+            return "number";
+        case CellType::Currency:
+            return "currency";
+        case CellType::Percent:
+            return "percent";
+    }
+    return "text";
+}
+
+void parseCellValue(TableCell& cell) {
+    std::string_view text = trim(cell.text);
+    bool negative = false;
+    bool percent = false;
+    std::string currency;
+
+    // Markers peel off from both ends in any order: "($1,200.00)",
+    // "-EUR 5", "1.234,56 €-", "12.5%"
+    for (bool changed = true; changed && !text.empty();) {
+        changed = false;
+        if (text.size() >= 2 && text.front() == '(' && text.back() == ')' && !negative) {
+            negative = true;
+            text = text.substr(1, text.size() - 2);
+            changed = true;
+        } else if ((text.front() == '-' || text.back() == '-') && !negative) {
+            negative = true;
+            text = text.front() == '-' ? text.substr(1) : text.substr(0, text.size() - 1);
+            changed = true;
+        } else if (text.substr(0, 3) == "\xE2\x88\x92" && !negative) {
+            negative = true;
+            text.remove_prefix(3);
+            changed = true;
+        } else if (text.front() == '+') {
+            text.remove_prefix(1);
+            changed = true;
+        } else if (text.back() == '%' && !percent) {
+            percent = true;
+            text.remove_suffix(1);
+            changed = true;
+        } else if (currency.empty() && (takeCurrencyPrefix(text, currency) || takeCurrencySuffix(text, currency))) {
+            changed = true;
+        }
+        text = trim(text);
+    }
+
+    double value = 0.0;
+    if (!parseDigits(text, value) || (percent && !currency.empty())) {
+        return;
+    }
+    cell.value = negative ? -value : value;
+    cell.currency = std::move(currency);
+    cell.type = percent ? CellType::Percent : (cell.currency.empty() ? CellType::Number : CellType::Currency);
+}
+
+std::vector<ExtractedTable> extractTables(const OCRResult& result, int page) {
+    std::vector<ExtractedTable> tables;
+    const size_t count = std::min(result.storedWords(), result.bounding_boxes.size());
+    if (count == 0) {
+        return tables;
+    }
+
+    // Both sweeps read the words in coordinate order
+    std::vector<int> keys(count);
+    int max_key = 0;
+    for (size_t i = 0; i < count; i++) {
+        const cv::Rect& box = result.bounding_boxes[i];
+        keys[i] = std::max(0, box.y + box.height / 2);
+        max_key = std::max(max_key, keys[i]);
+    }
+    std::vector<uint32_t> by_center = countingOrder(keys, max_key);
+    max_key = 0;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = std::max(0, result.bounding_boxes[i].x);
+        max_key = std::max(max_key, keys[i]);
+    }
+    std::vector<uint32_t> by_left = countingOrder(keys, max_key);
+
+    // A word joins the row above it when their centers are within half a
+    // text height; lines of a paragraph are a full line pitch apart
+    std::vector<Row> rows;
+    std::vector<uint32_t> row_of(count);
+    for (uint32_t word : by_center) {
+        const cv::Rect& box = result.bounding_boxes[word];
+        double center = box.y + box.height / 2.0;
+        if (rows.empty() || std::abs(center - rows.back().center()) > 0.5 * std::max<double>(rows.back().height(), box.height)) {
+            rows.emplace_back();
+            rows.back().top = box.y;
+        }
+        Row& row = rows.back();
+        row.center_sum += center;
+        row.height_sum += box.height;
+        row.count++;
+        row.top = std::min(row.top, box.y);
+        row.bottom = std::max(row.bottom, box.y + box.height);
+        row_of[word] = static_cast<uint32_t>(rows.size() - 1);
+    }
+    for (uint32_t word : by_left) {
+        rows[row_of[word]].words.push_back(word);
+    }
+
+    // Within a row, a gap wider than the text height starts a new cell
+    std::vector<std::vector<Cell>> row_cells(rows.size());
+    for (size_t r = 0; r < rows.size(); r++) {
+        const double gap_limit = std::max(1.0, rows[r].height());
+        for (uint32_t word : rows[r].words) {
+            const cv::Rect& box = result.bounding_boxes[word];
+            std::vector<Cell>& cells = row_cells[r];
+            if (cells.empty() || box.x - (cells.back().box.x + cells.back().box.width) > gap_limit) {
+                cells.push_back({std::string(result.word(word)), box});
+            } else {
+                cells.back().text += ' ';
+                cells.back().text += result.word(word);
+                cells.back().box |= box;
+            }
+        }
+    }
+
+    // Candidates are runs of rows with two or more cells; one single-cell row
+    // (a wrapped description, a subtotal label) may sit between two of them,
+    // and a vertical gap of more than two rows ends the run
+    size_t r = 0;
+    while (r < rows.size()) {
+        if (row_cells[r].size() < 2) {
+            r++;
+            continue;
+        }
+        size_t last = r;
+        for (size_t next = r + 1; next < rows.size(); next++) {
+            if (rows[next].top - rows[next - 1].bottom > 2.0 * rows[next - 1].height()) {
+                break;
+            }
+            if (row_cells[next].size() >= 2) {
+                last = next;
+            } else if (next != last + 1) {
+                break;
+            }
+        }
+        ExtractedTable table;
+        if (buildTable(row_cells, r, last + 1, page, table)) {
+            tables.push_back(std::move(table));
+        }
+        r = last + 1;
+    }
+    return tables;
+}
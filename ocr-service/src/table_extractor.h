@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+struct OCRResult;
+
+enum class CellType {
+    Text,
+    Number,    // plain number, "1,234.50" or "(12)"
+    Currency,  // number with a currency symbol or ISO code, "$1,234.50" or "1.234,50 EUR"
+    Percent    // number with a trailing '%'
+};
+
+const char* cellTypeName(CellType type);
+
+struct TableCell {
+    int row = 0;
+    int column = 0;
+    std::string text;
+    cv::Rect box;
+    CellType type = CellType::Text;
+    double value = 0.0;    // non-Text cells; negative for "-", "(...)" and trailing "-"
+    std::string currency;  // Currency cells: "$", "€", "£", "¥" or the ISO code as written
+};
+
+struct ExtractedTable {
+    int page = 0;
+    cv::Rect box;
+    int rows = 0;
+    int columns = 0;
+    std::vector<TableCell> cells;  // row-major; empty grid positions have no cell
+};
+
+// Rebuilds tables from word boxes (WordBoxes detail or up), without relying
+// on Tesseract's line and block segmentation, which tends to split a
+// statement row into one text line per column:
+//   1. words are swept top to bottom and grouped into rows by vertical overlap
+//   2. each row is swept left to right and split into cells at gaps wider
+//      than its text height
+//   3. runs of rows with two or more cells form table candidates, and
+//      columns are the x ranges that most of the candidate's cells cover
+// Both sweeps order words with a counting sort over page coordinates, so the
+// whole pass is linear in the word count plus the page size. A candidate is
+// kept only when it has at least two rows, two columns, and one column of
+// mostly numbers, which is what separates a statement table from a page of
+// two-column prose.
+std::vector<ExtractedTable> extractTables(const OCRResult& result, int page = 0);
+
+// Types and parses one cell's text in place: currency symbols or codes on
+// either side, a leading or trailing minus or enclosing parentheses for
+// negatives, and thousands separators in either convention ("1,234.56" and
+// "1.234,56"). Leaves the cell as Text when the whole text is not a number.
+void parseCellValue(TableCell& cell);
@@ -0,0 +1,222 @@
+#include "template_registry.h"
+#include "ocr_engine.h"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+bool isNumericValue(std::string_view value) {
+    bool digit = false;
+    for (char c : value) {
+        if (c >= '0' && c <= '9') {
+            digit = true;
+        } else if (c != ' ' && std::string_view(TemplateRegistry::numericWhitelist()).find(c) == std::string_view::npos) {
+            return false;
+        }
+    }
+    return digit;
+}
+
+}
+
+int LayoutFingerprint::distance(const LayoutFingerprint& other) const {
+    int bits_set = 0;
+    for (size_t i = 0; i < kWords; i++) {
+        bits_set += __builtin_popcountll(bits[i] ^ other.bits[i]);
+    }
+    return bits_set;
+}
+
+LayoutFingerprint LayoutFingerprint::compute(const cv::Mat& image) {
+    LayoutFingerprint fingerprint;
+    if (image.empty()) {
+        return fingerprint;
+    }
+
+    cv::Mat gray;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = image;
+    }
+    double scale = std::min(1.0, kSampleSide / static_cast<double>(std::max(gray.cols, gray.rows)));
+    cv::Mat sample = gray;
+    if (scale < 1.0) {
+        cv::resize(gray, sample, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+
+    cv::Mat ink;
+    cv::threshold(sample, ink, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    std::vector<cv::Point> points;
+    cv::findNonZero(ink, points);
+    if (points.empty()) {
+        return fingerprint;
+    }
+    cv::Rect box = cv::boundingRect(points);
+
+    cv::Mat grid;
+    cv::resize(ink(box), grid, cv::Size(kSide, kSide), 0, 0, cv::INTER_AREA);
+    double mean = cv::mean(grid)[0];
+    for (int y = 0; y < kSide; y++) {
+        const uchar* row = grid.ptr<uchar>(y);
+        for (int x = 0; x < kSide; x++) {
+            if (row[x] > mean) {
+                size_t bit = static_cast<size_t>(y) * kSide + x;
+                fingerprint.bits[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+
+    fingerprint.content = cv::Rect(static_cast<int>(box.x / scale), static_cast<int>(box.y / scale),
+                                   std::max(1, static_cast<int>(box.width / scale)),
+                                   std::max(1, static_cast<int>(box.height / scale)));
+    return fingerprint;
+}
+
+cv::Rect DocumentTemplate::locate(const TemplateField& field, const cv::Rect& content) {
+    int x = content.x + static_cast<int>(field.region.x * content.width);
+    int y = content.y + static_cast<int>(field.region.y * content.height);
+    int width = std::max(1, static_cast<int>(field.region.width * content.width));
+    int height = std::max(1, static_cast<int>(field.region.height * content.height));
+    int pad_x = height;
+    int pad_y = height / 4;
+    // Another page's amount may have a digit or two more than the learned one
+    return cv::Rect(x - pad_x, y - pad_y, width + width / 2 + 2 * pad_x, height + 2 * pad_y);
+}
+
+TemplateRegistry::TemplateRegistry(size_t max_templates, int max_distance)
+    : max_templates_(max_templates), max_distance_(max_distance) {
+}
+
+std::shared_ptr<const DocumentTemplate> TemplateRegistry::match(const LayoutFingerprint& fingerprint,
+                                                                const std::string& language) {
+    if (!enabled() || !fingerprint.valid()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t best = templates_.size();
+    int best_distance = INT_MAX;
+    for (size_t i = 0; i < templates_.size(); i++) {
+        if (templates_[i]->language != language) {
+            continue;
+        }
+        int distance = templates_[i]->fingerprint.distance(fingerprint);
+        if (distance <= max_distance_ && distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    if (best == templates_.size()) {
+        misses_++;
+        return nullptr;
+    }
+    matches_++;
+    last_used_[best] = ++tick_;
+    return templates_[best];
+}
+
+void TemplateRegistry::learn(const LayoutFingerprint& fingerprint, const std::string& language,
+                             const OCRResult& page, const DocumentInfo& info,
+                             const std::vector<FieldLocation>& locations) {
+    if (!enabled() || !fingerprint.valid() || info.document_type.empty() || info.document_type == "unknown" ||
+        page.bounding_boxes.size() < page.storedWords()) {
+        return;
+    }
+
+    auto learned = std::make_shared<DocumentTemplate>();
+    learned->language = language;
+    learned->fingerprint = fingerprint;
+    learned->document_type = info.document_type;
+    const cv::Rect& content = fingerprint.content;
+    for (const auto& location : locations) {
+        // Words are in text order, so the value's words are one run of them
+        cv::Rect box;
+        bool found = false;
+        for (size_t i = 0; i < page.storedWords(); i++) {
+            const TextSpan& span = page.word_spans[i];
+            if (span.offset >= location.offset + location.length) {
+                break;
+            }
+            if (span.offset + span.length <= location.offset) {
+                continue;
+            }
+            box = found ? (box | page.bounding_boxes[i]) : page.bounding_boxes[i];
+            found = true;
+        }
+        if (!found || box.area() == 0) {
+            continue;
+        }
+
+        TemplateField field;
+        field.name = location.name;
+        field.region = cv::Rect2f(static_cast<float>(box.x - content.x) / content.width,
+                                  static_cast<float>(box.y - content.y) / content.height,
+                                  static_cast<float>(box.width) / content.width,
+                                  static_cast<float>(box.height) / content.height);
+        auto value = info.extracted_data.find(location.name);
+        field.numeric = value != info.extracted_data.end() && isNumericValue(value->second);
+        field.length = value != info.extracted_data.end() ? value->second.size() : location.length;
+        learned->fields.push_back(std::move(field));
+    }
+    if (learned->fields.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    learned->id = next_id_++;
+    learned_++;
+    for (size_t i = 0; i < templates_.size(); i++) {
+        if (templates_[i]->language == language && templates_[i]->fingerprint.distance(fingerprint) <= max_distance_) {
+            templates_[i] = std::move(learned);
+            last_used_[i] = ++tick_;
+            return;
+        }
+    }
+    if (templates_.size() >= max_templates_) {
+        size_t oldest = static_cast<size_t>(std::min_element(last_used_.begin(), last_used_.end()) -
+                                            last_used_.begin());
+        templates_.erase(templates_.begin() + oldest);
+        last_used_.erase(last_used_.begin() + oldest);
+    }
+    templates_.push_back(std::move(learned));
+    last_used_.push_back(++tick_);
+}
+
+void TemplateRegistry::fallback(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fallbacks_++;
+    for (size_t i = 0; i < templates_.size(); i++) {
+        if (templates_[i]->id == id) {
+            templates_.erase(templates_.begin() + i);
+            last_used_.erase(last_used_.begin() + i);
+            return;
+        }
+    }
+}
+
+TemplateRegistryStats TemplateRegistry::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TemplateRegistryStats stats;
+    stats.templates = templates_.size();
+    stats.matches = matches_;
+    stats.misses = misses_;
+    stats.fallbacks = fallbacks_;
+    stats.learned = learned_;
+    return stats;
+}
+
+const char* TemplateRegistry::numericWhitelist() {
+    return "0123456789.,-/()$%";
+}
+
+bool TemplateRegistry::plausible(const TemplateField& field, std::string_view value) {
+    if (!field.numeric) {
+        return true;
+    }
+    // locate() leaves room for a digit or two more than the learned value
+    return isNumericValue(value) && value.size() * 2 >= field.length &&
+           value.size() <= field.length + field.length / 2 + 2;
+}
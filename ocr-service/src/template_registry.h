@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "field_extractor.h"
+
+struct OCRResult;
+struct DocumentInfo;
+
+// Coarse picture of where a page has ink: the ink bounding box, split into a
+// kSide x kSide grid, one bit per cell set when the cell is darker than the
+// grid's mean. Pages of one template differ only in the few cells their
+// values fall in; cropping to the ink first makes the bits independent of
+// scan offset and scale.
+struct LayoutFingerprint {
+    static constexpr int kSide = 64;
+    static constexpr size_t kWords = kSide * kSide / 64;
+
+    cv::Rect content;  // ink bounding box in page pixels; empty for a blank page
+    std::array<uint64_t, kWords> bits{};
+
+    bool valid() const { return content.area() > 0; }
+    // Bits that differ
+    int distance(const LayoutFingerprint& other) const;
+
+    // Works on a copy downscaled to at most kSampleSide, so it costs a small
+    // fraction of the page's preprocessing
+    static LayoutFingerprint compute(const cv::Mat& image);
+
+    static constexpr int kSampleSide = 512;
+};
+
+struct TemplateField {
+    std::string name;
+    cv::Rect2f region;  // value's word boxes, as fractions of the content box
+    bool numeric;       // learned value was digits and separators only
+    size_t length;      // characters in the learned value
+};
+
+struct DocumentTemplate {
+    uint64_t id;
+    std::string language;
+    LayoutFingerprint fingerprint;
+    std::string document_type;
+    std::vector<TemplateField> fields;
+
+    // Pixel rectangle to read field from on a page with this content box,
+    // padded like the adaptive line pass and widened for longer values
+    static cv::Rect locate(const TemplateField& field, const cv::Rect& content);
+};
+
+struct TemplateRegistryStats {
+    size_t templates;
+    uint64_t matches;    // pages matched to a known layout
+    uint64_t misses;     // pages with no known layout
+    uint64_t fallbacks;  // of the matches, pages whose fields did not read cleanly
+    uint64_t learned;
+};
+
+// Layouts of documents seen before, learned from their full analysis: the
+// page's fingerprint, its document type, and where each extracted value's
+// words were. A later page within max_distance bits of a known layout (same
+// language) only has those regions recognized, as single lines and with a
+// digits-only whitelist for numeric fields, instead of the whole page. Shared
+// by every engine in the pool; lookups scan all templates, which at a few
+// hundred 512-byte fingerprints is microseconds next to one recognition.
+class TemplateRegistry {
+public:
+    // max_templates = 0 disables matching and learning
+    TemplateRegistry(size_t max_templates, int max_distance);
+
+    bool enabled() const { return max_templates_ > 0; }
+
+    // Closest known layout within the distance bound, or null (a miss)
+    std::shared_ptr<const DocumentTemplate> match(const LayoutFingerprint& fingerprint,
+                                                  const std::string& language);
+
+    // Records page as a template when it was typed and at least one field
+    // value was located among its word boxes (WordBoxes detail). Replaces a
+    // known layout within the distance bound rather than adding a near copy.
+    void learn(const LayoutFingerprint& fingerprint, const std::string& language, const OCRResult& page,
+               const DocumentInfo& info, const std::vector<FieldLocation>& locations);
+
+    // Drops a template whose fields failed to read, so the full analysis of
+    // the page can re-learn it
+    void fallback(uint64_t id);
+
+    TemplateRegistryStats getStats() const;
+
+    // Characters a numeric field is read with
+    static const char* numericWhitelist();
+
+    // Whether a value read from field's region still looks like the learned
+    // one: a numeric field must read as a number of about the same length,
+    // so a crop that caught a currency code or the next column falls back
+    // to the full page instead of being extracted
+    static bool plausible(const TemplateField& field, std::string_view value);
+
+private:
+    size_t max_templates_;
+    int max_distance_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<const DocumentTemplate>> templates_;
+    std::vector<uint64_t> last_used_;  // per template, in match ticks, for eviction
+    uint64_t tick_ = 0;
+    uint64_t next_id_ = 1;
+    uint64_t matches_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t fallbacks_ = 0;
+    uint64_t learned_ = 0;
+};
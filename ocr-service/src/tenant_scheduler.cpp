@@ -0,0 +1,181 @@
+#include "tenant_scheduler.h"
+#include "content_hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+thread_local TenantScope* t_tenant_scope = nullptr;
+
+// Virtual time advances in megapixels per unit of weight
+constexpr double kPixelsPerUnit = 1e6;
+constexpr size_t kMaxTenantIdLength = 64;
+
+size_t classIndex(RequestClass request_class) {
+    return static_cast<size_t>(request_class);
+}
+
+}
+
+const char* requestClassName(RequestClass request_class) {
+    switch (request_class) {
+        case RequestClass::Interactive:
+            return "interactive";
+        case RequestClass::Bulk:
+            return "bulk";
+    }
+    return "interactive";
+}
+
+TenantContext TenantContext::identify(std::string_view tenant_id, std::string_view api_key,
+                                      std::string_view requested_class, RequestClass default_class) {
+    const TenantContext& outer = TenantScope::current();
+    TenantContext context;
+    if (!tenant_id.empty()) {
+        context.tenant = std::string(tenant_id.substr(0, kMaxTenantIdLength));
+    } else if (!api_key.empty()) {
+        char digest[24];
+        std::snprintf(digest, sizeof(digest), "key-%016llx",
+                      static_cast<unsigned long long>(xxhash64(api_key)));
+        context.tenant = digest;
+    } else {
+        context.tenant = outer.tenant;
+    }
+    bool bulk = default_class == RequestClass::Bulk || requested_class == "bulk" ||
+                outer.request_class == RequestClass::Bulk;
+    context.request_class = bulk ? RequestClass::Bulk : RequestClass::Interactive;
+    return context;
+}
+
+TenantScope::TenantScope(TenantContext context) : context_(std::move(context)), outer_(t_tenant_scope) {
+    t_tenant_scope = this;
+}
+
+TenantScope::~TenantScope() {
+    t_tenant_scope = outer_;
+}
+
+const TenantContext& TenantScope::current() {
+    static const TenantContext anonymous;
+    return t_tenant_scope ? t_tenant_scope->context_ : anonymous;
+}
+
+std::unordered_map<std::string, double> TenantSchedulerConfig::parseWeights(const std::string& spec) {
+    std::unordered_map<std::string, double> weights;
+    std::stringstream stream(spec);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), ::isspace), entry.end());
+        size_t colon = entry.find(':');
+        if (entry.empty() || colon == std::string::npos || colon == 0) {
+            continue;
+        }
+        try {
+            double weight = std::stod(entry.substr(colon + 1));
+            if (weight > 0.0) {
+                weights[entry.substr(0, colon)] = weight;
+                continue;
+            }
+        } catch (const std::exception&) {
+        }
+        std::cerr << "Ignoring invalid tenant weight " << entry << std::endl;
+    }
+    return weights;
+}
+
+TenantScheduler::TenantScheduler(TenantSchedulerConfig config) : config_(std::move(config)) {
+    config_.interactive_burst = std::max(1u, config_.interactive_burst);
+}
+
+bool TenantScheduler::admit(const TenantContext& context, uint64_t pixels, Ticket& ticket) {
+    uint64_t cost = pixels > 0 ? pixels : kDefaultPagePixels;
+    auto [it, inserted] = tenants_.try_emplace(context.tenant);
+    Tenant& tenant = it->second;
+    if (inserted) {
+        tenant.name = context.tenant;
+        auto weight = config_.weights.find(context.tenant);
+        tenant.weight = weight != config_.weights.end() ? weight->second : 1.0;
+    }
+    if (config_.max_pixels_per_tenant > 0 && tenant.pixels > 0 &&
+        tenant.pixels + cost > config_.max_pixels_per_tenant) {
+        over_budget_++;
+        return false;
+    }
+
+    size_t c = classIndex(context.request_class);
+    ticket.tenant = &tenant;
+    ticket.request_class = context.request_class;
+    ticket.cost = cost;
+    ticket.start_tag = std::max(virtual_time_[c], tenant.finish_tag[c]);
+    ticket.sequence = next_sequence_++;
+    tenant.finish_tag[c] = ticket.start_tag + cost / kPixelsPerUnit / tenant.weight;
+    tenant.queued++;
+    tenant.pixels += cost;
+    return true;
+}
+
+bool TenantScheduler::eligible(const Ticket& ticket) const {
+    return config_.max_pages_per_tenant == 0 || ticket.tenant->running < config_.max_pages_per_tenant;
+}
+
+size_t TenantScheduler::pick(const std::vector<Ticket*>& waiting) const {
+    std::array<size_t, 2> best{npos, npos};
+    for (size_t i = 0; i < waiting.size(); i++) {
+        const Ticket& ticket = *waiting[i];
+        if (!eligible(ticket)) {
+            continue;
+        }
+        size_t& current = best[classIndex(ticket.request_class)];
+        if (current == npos || ticket.start_tag < waiting[current]->start_tag ||
+            (ticket.start_tag == waiting[current]->start_tag && ticket.sequence < waiting[current]->sequence)) {
+            current = i;
+        }
+    }
+
+    size_t interactive = best[classIndex(RequestClass::Interactive)];
+    size_t bulk = best[classIndex(RequestClass::Bulk)];
+    if (bulk != npos && (interactive == npos || interactive_streak_ >= config_.interactive_burst)) {
+        return bulk;
+    }
+    return interactive;
+}
+
+void TenantScheduler::start(const Ticket& ticket) {
+    size_t c = classIndex(ticket.request_class);
+    ticket.tenant->queued--;
+    ticket.tenant->running++;
+    virtual_time_[c] = std::max(virtual_time_[c], ticket.start_tag);
+    granted_[c]++;
+    interactive_streak_ = ticket.request_class == RequestClass::Interactive ? interactive_streak_ + 1 : 0;
+}
+
+void TenantScheduler::cancel(const Ticket& ticket) {
+    ticket.tenant->queued--;
+    ticket.tenant->pixels -= ticket.cost;
+    releaseIfIdle(*ticket.tenant);
+}
+
+void TenantScheduler::finish(const Ticket& ticket) {
+    ticket.tenant->running--;
+    ticket.tenant->pixels -= ticket.cost;
+    releaseIfIdle(*ticket.tenant);
+}
+
+void TenantScheduler::releaseIfIdle(Tenant& tenant) {
+    // As in WFQ, a tenant that comes back after going idle starts again from
+    // the current virtual time, so nothing about it needs to be kept
+    if (tenant.queued == 0 && tenant.running == 0) {
+        std::string name = tenant.name;
+        tenants_.erase(name);
+    }
+}
+
+TenantSchedulerStats TenantScheduler::getStats() const {
+    TenantSchedulerStats stats;
+    stats.tenants = tenants_.size();
+    stats.granted = granted_;
+    stats.over_budget = over_budget_;
+    return stats;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class RequestClass {
+    Interactive,  // a person is waiting: /extract, /text, /analyze, gRPC
+    Bulk          // /batch, async jobs, and anything asking for X-Request-Class: bulk
+};
+
+const char* requestClassName(RequestClass request_class);
+
+// Who a unit of work is charged to
+struct TenantContext {
+    std::string tenant = "anonymous";
+    RequestClass request_class = RequestClass::Interactive;
+
+    // Tenant from an explicit tenant id, else from a digest of the API key
+    // (never the key itself, which would end up in logs and job bodies), else
+    // the tenant of the enclosing scope. Bulk when default_class or the
+    // requested class is bulk, or when the enclosing scope already is: a job
+    // replaying a request through its handler stays bulk.
+    static TenantContext identify(std::string_view tenant_id, std::string_view api_key,
+                                  std::string_view requested_class, RequestClass default_class);
+};
+
+// Pins the tenant of the work running on this thread, for EnginePool::acquire
+// to charge. Scopes nest; work handed to other threads (batch items, page
+// tiles, document pages) copies current() and opens its own scope there.
+class TenantScope {
+public:
+    explicit TenantScope(TenantContext context);
+    ~TenantScope();
+
+    TenantScope(const TenantScope&) = delete;
+    TenantScope& operator=(const TenantScope&) = delete;
+
+    // The innermost scope's context; anonymous and interactive outside any
+    static const TenantContext& current();
+
+private:
+    TenantContext context_;
+    TenantScope* outer_;
+};
+
+struct TenantSchedulerConfig {
+    size_t max_pages_per_tenant = 0;     // engines one tenant may hold at once, 0 = no cap
+    uint64_t max_pixels_per_tenant = 0;  // pixels one tenant may have queued and running, 0 = no cap
+    unsigned interactive_burst = 8;      // interactive grants in a row before a waiting bulk checkout
+    std::unordered_map<std::string, double> weights;  // share per tenant, default 1
+
+    // Parses "frontend:4,etl:0.5" into tenant weights
+    static std::unordered_map<std::string, double> parseWeights(const std::string& spec);
+};
+
+struct TenantSchedulerStats {
+    size_t tenants;  // with work queued or running
+    std::array<uint64_t, 2> granted;  // engine checkouts, per RequestClass
+    uint64_t over_budget;             // checkouts refused by the pixel cap
+};
+
+// Decides which waiting checkout gets the next free engine. Interactive work
+// goes first, except that a waiting bulk checkout is served after
+// interactive_burst interactive ones in a row so bulk cannot starve. Within a
+// class, tenants share engines by weighted fair queuing on pixel cost: each
+// checkout is tagged with its tenant's virtual finish time, so a tenant
+// pushing 500 pages waits behind one pushing a single page instead of ahead
+// of it. A tenant at max_pages_per_tenant engines is skipped until it returns
+// one; one over max_pixels_per_tenant is refused outright, except for its
+// first checkout, so a single oversized page still runs.
+//
+// Not thread-safe: the engine pool calls it under its own lock.
+class TenantScheduler {
+    struct Tenant;
+
+public:
+    // A checkout from admission until its engine is returned
+    struct Ticket {
+        Tenant* tenant = nullptr;
+        RequestClass request_class = RequestClass::Interactive;
+        uint64_t cost = 0;  // pixels
+        double start_tag = 0.0;
+        uint64_t sequence = 0;
+    };
+
+    // Cost of a checkout whose pixel count is unknown: a letter page at 300 dpi
+    static constexpr uint64_t kDefaultPagePixels = 2550 * 3300;
+
+    explicit TenantScheduler(TenantSchedulerConfig config);
+
+    // Tags a checkout of pixels (0 for unknown) for context's tenant; false
+    // when the tenant is over its pixel budget
+    bool admit(const TenantContext& context, uint64_t pixels, Ticket& ticket);
+    bool eligible(const Ticket& ticket) const;
+    // Index into waiting of the checkout to serve next, or npos when every
+    // waiting tenant is at its engine cap
+    size_t pick(const std::vector<Ticket*>& waiting) const;
+
+    void start(const Ticket& ticket);   // the ticket got an engine
+    void cancel(const Ticket& ticket);  // gave up waiting
+    void finish(const Ticket& ticket);  // returned its engine
+
+    TenantSchedulerStats getStats() const;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+    struct Tenant {
+        std::string name;
+        double weight = 1.0;
+        size_t queued = 0;
+        size_t running = 0;
+        uint64_t pixels = 0;  // queued and running
+        std::array<double, 2> finish_tag{};
+    };
+
+    void releaseIfIdle(Tenant& tenant);
+
+    TenantSchedulerConfig config_;
+    std::map<std::string, Tenant> tenants_;  // nodes are stable, so tickets point into it
+    std::array<double, 2> virtual_time_{};
+    uint64_t next_sequence_ = 0;
+    unsigned interactive_streak_ = 0;
+    std::array<uint64_t, 2> granted_{};
+    uint64_t over_budget_ = 0;
+};
@@ -0,0 +1,265 @@
+#include "tracing.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+thread_local TraceLink t_trace_link;
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t wallNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint64_t randomId() {
+    thread_local std::mt19937_64 generator(
+        std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    uint64_t id;
+    do {
+        id = generator();
+    } while (id == 0);
+    return id;
+}
+
+bool parseHex(std::string_view hex, uint64_t& value) {
+    value = 0;
+    for (char c : hex) {
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            // The spec only allows lowercase
+            return false;
+        }
+        value = (value << 4) | static_cast<uint64_t>(digit);
+    }
+    return true;
+}
+
+std::string hexId(uint64_t value) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+    return hex;
+}
+
+nlohmann::json attributeValue(double value) {
+    // Sizes and counts go out as OTLP ints, everything else as doubles
+    if (std::floor(value) == value && std::fabs(value) < 9e15) {
+        return {{"intValue", std::to_string(static_cast<int64_t>(value))}};
+    }
+    return {{"doubleValue", value}};
+}
+
+}
+
+TraceContext TraceContext::parse(std::string_view traceparent) {
+    TraceContext context;
+    // Later versions may append fields, but keep these four in place
+    uint64_t version = 0;
+    uint64_t flags = 0;
+    bool valid = traceparent.size() >= 55 && traceparent[2] == '-' && traceparent[35] == '-' &&
+                 traceparent[52] == '-' && (traceparent.size() == 55 || traceparent[55] == '-') &&
+                 parseHex(traceparent.substr(0, 2), version) && version != 0xff &&
+                 parseHex(traceparent.substr(3, 16), context.trace_id_high) &&
+                 parseHex(traceparent.substr(19, 16), context.trace_id_low) &&
+                 parseHex(traceparent.substr(36, 16), context.parent_span_id) &&
+                 parseHex(traceparent.substr(53, 2), flags) &&
+                 (context.trace_id_high | context.trace_id_low) != 0 && context.parent_span_id != 0;
+    if (valid) {
+        context.sampled = (flags & 0x01) != 0;
+        return context;
+    }
+    context = TraceContext{};
+    context.trace_id_high = randomId();
+    context.trace_id_low = randomId();
+    return context;
+}
+
+Tracer& Tracer::global() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::configure(TraceConfig config, std::function<void(std::string body)> exporter) {
+    config_ = std::move(config);
+    exporter_ = std::move(exporter);
+    enabled_.store(config_.slow_threshold.count() > 0 && exporter_ != nullptr, std::memory_order_relaxed);
+}
+
+TracerStats Tracer::getStats() const {
+    TracerStats stats;
+    stats.traces = traces_.load(std::memory_order_relaxed);
+    stats.kept = kept_.load(std::memory_order_relaxed);
+    stats.dropped_spans = dropped_spans_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Tracer::finish(const RequestTrace& trace, int64_t duration_ns) {
+    traces_.fetch_add(1, std::memory_order_relaxed);
+    uint32_t spans = trace.span_count_.load(std::memory_order_relaxed);
+    if (spans > RequestTrace::kMaxSpans) {
+        dropped_spans_.fetch_add(spans - RequestTrace::kMaxSpans, std::memory_order_relaxed);
+    }
+
+    // The ratio test reads the low half of the trace id, which W3C expects
+    // to be random, so a trace is kept or dropped the same way everywhere
+    bool slow = duration_ns >= std::chrono::duration_cast<std::chrono::nanoseconds>(config_.slow_threshold).count();
+    bool baseline = config_.sample_ratio > 0.0 &&
+                    static_cast<double>(trace.context_.trace_id_low >> 11) * 0x1.0p-53 < config_.sample_ratio;
+    if (!trace.context_.sampled && !slow && !baseline) {
+        return;
+    }
+    kept_.fetch_add(1, std::memory_order_relaxed);
+    exporter_(trace.serialize(config_));
+}
+
+RequestTrace::RequestTrace(const char* name, std::string_view traceparent)
+    : active_(Tracer::global().enabled() && !t_trace_link.trace), outer_(t_trace_link) {
+    // A request replayed inside another (a job running through its
+    // handler) records into the outer trace
+    if (!active_) {
+        return;
+    }
+    context_ = TraceContext::parse(traceparent);
+    int64_t start = steadyNanos();
+    wall_offset_ns_ = wallNanos() - start;
+    spans_[0] = Span{name, -1, start, 0};
+    span_count_.store(1, std::memory_order_relaxed);
+    t_trace_link = TraceLink{this, 0};
+}
+
+RequestTrace::~RequestTrace() {
+    if (!active_) {
+        return;
+    }
+    t_trace_link = outer_;
+    spans_[0].end_ns = steadyNanos();
+    Tracer::global().finish(*this, spans_[0].end_ns - spans_[0].start_ns);
+}
+
+void RequestTrace::annotate(const char* key, double value) {
+    if (active_) {
+        annotate(0, key, value);
+    }
+}
+
+int32_t RequestTrace::open(const char* name, int32_t parent) {
+    uint32_t index = span_count_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= kMaxSpans) {
+        return -1;
+    }
+    spans_[index] = Span{name, parent, steadyNanos(), 0};
+    return static_cast<int32_t>(index);
+}
+
+void RequestTrace::close(int32_t index) {
+    spans_[index].end_ns = steadyNanos();
+}
+
+void RequestTrace::annotate(int32_t span, const char* key, double value) {
+    uint32_t index = attribute_count_.fetch_add(1, std::memory_order_relaxed);
+    if (index < kMaxAttributes) {
+        attributes_[index] = Attribute{span, key, value};
+    }
+}
+
+std::string RequestTrace::serialize(const TraceConfig& config) const {
+    size_t span_count = std::min<size_t>(span_count_.load(std::memory_order_relaxed), kMaxSpans);
+    size_t attribute_count = std::min<size_t>(attribute_count_.load(std::memory_order_relaxed), kMaxAttributes);
+    std::string trace_id = hexId(context_.trace_id_high) + hexId(context_.trace_id_low);
+
+    // Span ids are only needed once a trace is kept
+    std::vector<uint64_t> span_ids(span_count);
+    for (auto& id : span_ids) {
+        id = randomId();
+    }
+
+    nlohmann::json spans = nlohmann::json::array();
+    for (size_t i = 0; i < span_count; i++) {
+        const Span& span = spans_[i];
+        // Every span closes before its request returns; clamp in case one did not
+        int64_t end = span.end_ns != 0 ? span.end_ns : spans_[0].end_ns;
+        nlohmann::json item = {
+            {"traceId", trace_id},
+            {"spanId", hexId(span_ids[i])},
+            {"name", span.name},
+            {"kind", i == 0 ? 2 : 1},  // SERVER for the request, INTERNAL for its stages
+            {"startTimeUnixNano", std::to_string(span.start_ns + wall_offset_ns_)},
+            {"endTimeUnixNano", std::to_string(end + wall_offset_ns_)},
+            {"attributes", nlohmann::json::array()}
+        };
+        if (span.parent >= 0) {
+            item["parentSpanId"] = hexId(span_ids[span.parent]);
+        } else if (context_.parent_span_id != 0) {
+            item["parentSpanId"] = hexId(context_.parent_span_id);
+        }
+        spans.push_back(std::move(item));
+    }
+    for (size_t i = 0; i < attribute_count; i++) {
+        const Attribute& attribute = attributes_[i];
+        spans[attribute.span]["attributes"].push_back({{"key", attribute.key},
+                                                       {"value", attributeValue(attribute.value)}});
+    }
+
+    nlohmann::json body = {
+        {"resourceSpans", nlohmann::json::array({{
+            {"resource", {{"attributes", nlohmann::json::array({{
+                {"key", "service.name"}, {"value", {{"stringValue", config.service_name}}}
+            }})}}},
+            {"scopeSpans", nlohmann::json::array({{
+                {"scope", {{"name", "ocr-service"}}},
+                {"spans", std::move(spans)}
+            }})}
+        }})}
+    };
+    return body.dump();
+}
+
+TraceSpan::TraceSpan(const char* name) : trace_(name ? t_trace_link.trace : nullptr) {
+    if (trace_) {
+        index_ = trace_->open(name, t_trace_link.parent);
+        if (index_ < 0) {
+            trace_ = nullptr;
+            return;
+        }
+        outer_ = t_trace_link.parent;
+        t_trace_link.parent = index_;
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (trace_) {
+        trace_->close(index_);
+        t_trace_link.parent = outer_;
+    }
+}
+
+void TraceSpan::annotate(const char* key, double value) {
+    if (trace_) {
+        trace_->annotate(index_, key, value);
+    }
+}
+
+TraceScope::TraceScope(TraceLink link) : outer_(t_trace_link) {
+    t_trace_link = link;
+}
+
+TraceScope::~TraceScope() {
+    t_trace_link = outer_;
+}
+
+TraceLink TraceScope::current() {
+    return t_trace_link;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// W3C trace context, as carried by a traceparent header:
+// 00-<32 hex trace id>-<16 hex parent span id>-<2 hex flags>
+struct TraceContext {
+    uint64_t trace_id_high = 0;
+    uint64_t trace_id_low = 0;
+    uint64_t parent_span_id = 0;  // 0 when this service starts the trace
+    bool sampled = false;         // the caller is recording this trace
+
+    // The caller's context, or a fresh trace id when the header is missing
+    // or malformed
+    static TraceContext parse(std::string_view traceparent);
+};
+
+struct TraceConfig {
+    std::chrono::milliseconds slow_threshold{0};  // requests at least this slow are kept; 0 turns tracing off
+    double sample_ratio = 0.0;                    // fraction of the other requests kept, as a baseline
+    std::string service_name = "ocr-service";
+};
+
+struct TracerStats {
+    uint64_t traces;         // requests traced
+    uint64_t kept;           // of those, exported
+    uint64_t dropped_spans;  // spans past a trace's kMaxSpans
+};
+
+class RequestTrace;
+
+// Process-wide tracing switch and exporter. Every request is traced into a
+// fixed buffer on its own stack; when it finishes, the trace is kept if the
+// caller sampled it, if it ran past slow_threshold, or for sample_ratio of
+// the rest (decided from the trace id, so every service agrees). Only kept
+// traces are serialized, as an OTLP/JSON ExportTraceServiceRequest body.
+class Tracer {
+public:
+    static Tracer& global();
+
+    // Call once at startup, before serving
+    void configure(TraceConfig config, std::function<void(std::string body)> exporter);
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    TracerStats getStats() const;
+
+private:
+    friend class RequestTrace;
+
+    Tracer() = default;
+
+    void finish(const RequestTrace& trace, int64_t duration_ns);
+
+    TraceConfig config_;
+    std::function<void(std::string)> exporter_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> traces_{0};
+    std::atomic<uint64_t> kept_{0};
+    std::atomic<uint64_t> dropped_spans_{0};
+};
+
+// Where spans opened on a thread attach: a trace and its innermost open span
+struct TraceLink {
+    RequestTrace* trace = nullptr;
+    int32_t parent = -1;
+};
+
+// The root span of one request. While it lives, spans opened on this thread
+// (and on threads that adopt its link through a TraceScope) are recorded
+// into it. With tracing off it does nothing and spans see no trace.
+class RequestTrace {
+public:
+    static constexpr size_t kMaxSpans = 256;
+    static constexpr size_t kMaxAttributes = 64;
+
+    // name must outlive the trace; a string literal
+    RequestTrace(const char* name, std::string_view traceparent);
+    ~RequestTrace();
+
+    RequestTrace(const RequestTrace&) = delete;
+    RequestTrace& operator=(const RequestTrace&) = delete;
+
+    // Adds to the root span
+    void annotate(const char* key, double value);
+
+private:
+    friend class Tracer;
+    friend class TraceSpan;
+
+    // Trivially constructible, so an unused buffer costs nothing to set up
+    struct Span {
+        const char* name;
+        int32_t parent;
+        int64_t start_ns;  // steady clock
+        int64_t end_ns;    // 0 while open
+    };
+
+    struct Attribute {
+        int32_t span;
+        const char* key;
+        double value;
+    };
+
+    // Index of the new span, or -1 when the buffer is full
+    int32_t open(const char* name, int32_t parent);
+    void close(int32_t index);
+    void annotate(int32_t span, const char* key, double value);
+
+    std::string serialize(const TraceConfig& config) const;
+
+    bool active_;
+    TraceContext context_;
+    int64_t wall_offset_ns_ = 0;  // system clock minus steady clock at the start
+    TraceLink outer_;
+    std::array<Span, kMaxSpans> spans_;
+    std::atomic<uint32_t> span_count_{0};
+    std::array<Attribute, kMaxAttributes> attributes_;
+    std::atomic<uint32_t> attribute_count_{0};
+};
+
+// Times its lifetime as a child of the innermost open span on this thread.
+// Without a trace the constructor is one branch and records nothing.
+class TraceSpan {
+public:
+    // name must outlive the trace; a string literal, or null for no span
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void annotate(const char* key, double value);
+
+private:
+    RequestTrace* trace_;
+    int32_t index_ = -1;
+    int32_t outer_ = -1;
+};
+
+// Adopts a link on another thread, so work handed off (batch items, page
+// tiles, document pages) nests under the span that handed it off. Copy
+// current() before the handoff, like TenantScope.
+class TraceScope {
+public:
+    explicit TraceScope(TraceLink link);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    static TraceLink current();
+
+private:
+    TraceLink outer_;
+};
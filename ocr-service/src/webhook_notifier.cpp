@@ -0,0 +1,237 @@
+#include "webhook_notifier.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <curl/curl.h>
+
+namespace {
+
+size_t discardBody(char*, size_t size, size_t count, void*) {
+    return size * count;
+}
+
+bool isPublicV4(uint32_t address) {
+    uint8_t a = address >> 24;
+    uint8_t b = (address >> 16) & 0xff;
+    return a != 0 && a != 10 && a != 127 &&
+           !(a == 100 && (b & 0xc0) == 64) &&   // 100.64/10 carrier-grade NAT
+           !(a == 169 && b == 254) &&           // link-local, cloud metadata
+           !(a == 172 && (b & 0xf0) == 16) &&
+           !(a == 192 && b == 168) &&
+           a < 224;                             // multicast and reserved
+}
+
+bool isPublicAddress(const struct sockaddr* address) {
+    if (address->sa_family == AF_INET) {
+        const auto* v4 = reinterpret_cast<const struct sockaddr_in*>(address);
+        return isPublicV4(ntohl(v4->sin_addr.s_addr));
+    }
+    if (address->sa_family != AF_INET6) {
+        return false;
+    }
+    const uint8_t* bytes = reinterpret_cast<const struct sockaddr_in6*>(address)->sin6_addr.s6_addr;
+    static const uint8_t v4_mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    if (std::memcmp(bytes, v4_mapped, sizeof(v4_mapped)) == 0) {
+        return isPublicV4(static_cast<uint32_t>(bytes[12]) << 24 | static_cast<uint32_t>(bytes[13]) << 16 |
+                          static_cast<uint32_t>(bytes[14]) << 8 | bytes[15]);
+    }
+    static const uint8_t zero[15] = {};
+    // ::, ::1, unique-local fc00::/7, link-local fe80::/10, multicast ff00::/8
+    return std::memcmp(bytes, zero, sizeof(zero)) != 0 &&
+           (bytes[0] & 0xfe) != 0xfc &&
+           !(bytes[0] == 0xfe && (bytes[1] & 0xc0) == 0x80) &&
+           bytes[0] != 0xff;
+}
+
+// Runs on the address curl resolved, right before connecting, so a public
+// name that resolves (or is rebound) to an internal address is still refused
+curl_socket_t openPublicSocket(void*, curlsocktype, struct curl_sockaddr* address) {
+    if (!isPublicAddress(&address->addr)) {
+        return CURL_SOCKET_BAD;
+    }
+    return socket(address->family, address->socktype, address->protocol);
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+// Host part of a URL, lowercased, without brackets around an IPv6 literal;
+// empty when the URL does not parse
+std::string urlHost(const std::string& url) {
+    std::string host;
+    CURLU* parsed = curl_url();
+    char* part = nullptr;
+    if (parsed && curl_url_set(parsed, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK &&
+        curl_url_get(parsed, CURLUPART_HOST, &part, 0) == CURLUE_OK) {
+        host = part;
+        curl_free(part);
+    }
+    curl_url_cleanup(parsed);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return lowercase(host);
+}
+
+}
+
+std::vector<std::string> DeliveryPolicy::parseHosts(const std::string& spec) {
+    std::vector<std::string> hosts;
+    std::istringstream stream(spec);
+    std::string host;
+    while (std::getline(stream, host, ',')) {
+        host.erase(0, host.find_first_not_of(" \t"));
+        host.erase(host.find_last_not_of(" \t") + 1);
+        if (!host.empty()) {
+            hosts.push_back(lowercase(host));
+        }
+    }
+    return hosts;
+}
+
+WebhookNotifier::WebhookNotifier(std::chrono::milliseconds timeout, size_t max_attempts, size_t max_pending,
+                                 DeliveryPolicy policy)
+    : timeout_(timeout), max_attempts_(max_attempts > 0 ? max_attempts : 1), max_pending_(max_pending),
+      policy_(std::move(policy)), stopping_(false), delivered_(0), failed_(0) {
+    thread_ = std::thread(&WebhookNotifier::deliveryLoop, this);
+}
+
+WebhookNotifier::~WebhookNotifier() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void WebhookNotifier::globalInit() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+void WebhookNotifier::globalCleanup() {
+    curl_global_cleanup();
+}
+
+bool WebhookNotifier::isValidUrl(const std::string& url) {
+    return url.rfind("http://", 0) == 0 || url.rfind("https://", 0) == 0;
+}
+
+bool WebhookNotifier::accepts(const std::string& url) const {
+    if (!isValidUrl(url)) {
+        return false;
+    }
+    std::string host = urlHost(url);
+    if (host.empty()) {
+        return false;
+    }
+    return policy_.allowed_hosts.empty() ||
+           std::find(policy_.allowed_hosts.begin(), policy_.allowed_hosts.end(), host) !=
+               policy_.allowed_hosts.end();
+}
+
+bool WebhookNotifier::enqueue(std::string url, std::string body) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || pending_.size() >= max_pending_) {
+            failed_++;
+            return false;
+        }
+        pending_.push_back({std::move(url), std::move(body)});
+    }
+    pending_cv_.notify_one();
+    return true;
+}
+
+uint64_t WebhookNotifier::delivered() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return delivered_;
+}
+
+uint64_t WebhookNotifier::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+void WebhookNotifier::deliveryLoop() {
+    while (true) {
+        Delivery delivery;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pending_cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+            // Callbacks still queued at shutdown are flushed before exiting
+            if (pending_.empty()) {
+                return;
+            }
+            delivery = std::move(pending_.front());
+            pending_.pop_front();
+        }
+
+        bool ok = false;
+        for (size_t attempt = 0; attempt < max_attempts_ && !ok; attempt++) {
+            if (attempt > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500) * (1 << (attempt - 1)));
+            }
+            ok = post(delivery);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ok) {
+            delivered_++;
+        } else {
+            failed_++;
+            std::cerr << "Giving up on POST to " << delivery.url << std::endl;
+        }
+    }
+}
+
+bool WebhookNotifier::post(const Delivery& delivery) const {
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        return false;
+    }
+
+    struct curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    curl_easy_setopt(curl, CURLOPT_URL, delivery.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, delivery.body.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(delivery.body.size()));
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout_.count()));
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardBody);
+    // Never follow redirects or leave http(s), so a callback URL can't be
+    // bounced to file:// or another scheme
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+#if LIBCURL_VERSION_NUM >= 0x075500
+    curl_easy_setopt(curl, CURLOPT_PROTOCOLS_STR, "http,https");
+#else
+    curl_easy_setopt(curl, CURLOPT_PROTOCOLS, static_cast<long>(CURLPROTO_HTTP | CURLPROTO_HTTPS));
+#endif
+    if (policy_.public_only) {
+        // Connect directly, or the check would only ever see the proxy
+        curl_easy_setopt(curl, CURLOPT_NOPROXY, "*");
+        curl_easy_setopt(curl, CURLOPT_OPENSOCKETFUNCTION, openPublicSocket);
+    }
+
+    CURLcode code = curl_easy_perform(curl);
+    long status = 0;
+    if (code == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    } else {
+        std::cerr << "POST to " << delivery.url << " failed: " << curl_easy_strerror(code) << std::endl;
+    }
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    return code == CURLE_OK && status >= 200 && status < 300;
+}
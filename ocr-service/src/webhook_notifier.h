@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where a notifier may deliver. Callback URLs come from API callers, so the
+// job notifier either only talks to allowed_hosts or, without a list, refuses
+// to connect to loopback, private, link-local and other non-public addresses
+// (checked on the resolved address at connect time, so DNS can't route
+// around it). The trace exporter's collector is configured by the operator
+// and left unrestricted.
+struct DeliveryPolicy {
+    std::vector<std::string> allowed_hosts;  // exact host names or literal IPs; empty = any host
+    bool public_only = false;                // refuse non-public destination addresses
+
+    // Parses "hooks.example.com,10.0.0.7" into a host list
+    static std::vector<std::string> parseHosts(const std::string& spec);
+};
+
+// Delivers job completion callbacks (and exported traces) from a single
+// background thread, so a slow or unreachable receiver never holds up a job
+// worker. Each delivery is an HTTP(S) POST of a JSON body, retried with a
+// short backoff.
+class WebhookNotifier {
+public:
+    WebhookNotifier(std::chrono::milliseconds timeout, size_t max_attempts, size_t max_pending,
+                    DeliveryPolicy policy = {});
+    ~WebhookNotifier();
+
+    WebhookNotifier(const WebhookNotifier&) = delete;
+    WebhookNotifier& operator=(const WebhookNotifier&) = delete;
+
+    // Returns false when the delivery backlog is full and the callback was dropped
+    bool enqueue(std::string url, std::string body);
+
+    uint64_t delivered() const;
+    uint64_t failed() const;
+
+    // Only http:// and https:// targets are accepted
+    static bool isValidUrl(const std::string& url);
+    // A valid URL whose host the policy allows
+    bool accepts(const std::string& url) const;
+
+    // One global libcurl init/cleanup per process, before any thread uses it
+    static void globalInit();
+    static void globalCleanup();
+
+private:
+    struct Delivery {
+        std::string url;
+        std::string body;
+    };
+
+    void deliveryLoop();
+    bool post(const Delivery& delivery) const;
+
+    std::chrono::milliseconds timeout_;
+    size_t max_attempts_;
+    size_t max_pending_;
+    DeliveryPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::deque<Delivery> pending_;
+    bool stopping_;
+    uint64_t delivered_;
+    uint64_t failed_;
+    std::thread thread_;
+};
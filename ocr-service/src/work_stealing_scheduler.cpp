@@ -0,0 +1,172 @@
+#include "work_stealing_scheduler.h"
+#include <exception>
+#include <iterator>
+
+namespace {
+// Identifies the scheduler worker running on the current thread, if any
+thread_local const WorkStealingScheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+}
+
+struct WorkStealingScheduler::TaskGroup {
+    explicit TaskGroup(size_t count) : remaining(count) {}
+
+    void finish(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error && !first_error) {
+            first_error = error;
+        }
+        if (--remaining == 0) {
+            done_cv.notify_all();
+        }
+    }
+
+    bool done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return remaining == 0;
+    }
+
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t remaining;
+    std::exception_ptr first_error;
+};
+
+WorkStealingScheduler::WorkStealingScheduler(size_t num_workers)
+    : pending_(0), next_queue_(0), stopping_(false) {
+    if (num_workers == 0) {
+        num_workers = 1;
+    }
+
+    queues_.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; i++) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    workers_.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; i++) {
+        workers_.emplace_back(&WorkStealingScheduler::workerLoop, this, i);
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void WorkStealingScheduler::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+
+    auto group = std::make_shared<TaskGroup>(count);
+
+    // Deal the items round-robin starting at the caller's own queue (or the
+    // next queue in turn for external threads); stealing evens out the rest
+    size_t home = current_scheduler == this
+        ? current_worker
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+    // Counted before any item is visible, so a worker that takes one can
+    // never drive the count below zero
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        pending_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        WorkerQueue& queue = *queues_[(home + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({group.get(), [group, &task, i]() {
+            std::exception_ptr error;
+            try {
+                task(i);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            group->finish(error);
+        }});
+    }
+
+    wake_cv_.notify_all();
+
+    // Help out with this group's items until all of them have run. Once none
+    // is left queued, the rest are already executing on other threads.
+    while (!group->done()) {
+        if (!runOne(home, group.get())) {
+            std::unique_lock<std::mutex> lock(group->mutex);
+            group->done_cv.wait(lock, [&group]() { return group->remaining == 0; });
+        }
+    }
+
+    if (group->first_error) {
+        std::rethrow_exception(group->first_error);
+    }
+}
+
+void WorkStealingScheduler::workerLoop(size_t index) {
+    current_scheduler = this;
+    current_worker = index;
+
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this]() {
+            return stopping_ || pending_.load(std::memory_order_relaxed) > 0;
+        });
+        if (stopping_ && pending_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingScheduler::runOne(size_t home, const TaskGroup* group) {
+    Task task;
+    if (!popLocal(home, group, task) && !steal(home, group, task)) {
+        return false;
+    }
+
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+bool WorkStealingScheduler::popLocal(size_t index, const TaskGroup* group, Task& task) {
+    WorkerQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (auto it = queue.tasks.rbegin(); it != queue.tasks.rend(); ++it) {
+        if (!group || it->group == group) {
+            task = std::move(it->run);
+            queue.tasks.erase(std::next(it).base());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingScheduler::steal(size_t thief, const TaskGroup* group, Task& task) {
+    for (size_t offset = 1; offset < queues_.size(); offset++) {
+        WorkerQueue& victim = *queues_[(thief + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        for (auto it = victim.tasks.begin(); it != victim.tasks.end(); ++it) {
+            if (!group || it->group == group) {
+                task = std::move(it->run);
+                victim.tasks.erase(it);
+                return true;
+            }
+        }
+    }
+    return false;
+}
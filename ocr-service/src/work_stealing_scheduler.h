@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker pops
+// from the back of its own deque and, when that runs dry, steals from the
+// front of the others, so uneven batches (a 600-DPI statement page next to a
+// small receipt) don't leave idle workers behind a static split.
+class WorkStealingScheduler {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingScheduler(size_t num_workers);
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    // Runs task(i) for every i in [0, count) and returns once all of them have
+    // finished. The calling thread helps run this call's own items while it
+    // waits, so a task may itself call parallelFor without deadlocking the
+    // workers; it never picks up another caller's items, so an interactive
+    // request's tiles don't leave it running a bulk batch item. The first
+    // exception thrown by a task is rethrown here.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    size_t workerCount() const { return workers_.size(); }
+    size_t pendingTasks() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    struct TaskGroup;
+
+    struct Entry {
+        const TaskGroup* group;  // the parallelFor call it belongs to
+        Task run;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Entry> tasks;
+    };
+
+    void workerLoop(size_t index);
+    // Runs one queued task, only one of group's when group is set
+    bool runOne(size_t home, const TaskGroup* group = nullptr);
+    bool popLocal(size_t index, const TaskGroup* group, Task& task);
+    bool steal(size_t thief, const TaskGroup* group, Task& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+    bool stopping_;
+};